@@ -0,0 +1,159 @@
+// Compares the downstream JSON frames (Deribit's own notifications, forwarded
+// as-is) with the binary_protocol.h encoding of the same events: bytes per
+// message, server-side encode time, and client-side decode time through
+// nlohmann::json versus BinaryReader.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <nlohmann/json.hpp>
+#include "binary_encoder.h"
+#include "notification_decoder.h"
+
+using json = nlohmann::json;
+
+namespace {
+
+struct Result {
+    double ns_per_message;
+    size_t checksum;
+};
+
+template <typename F>
+Result run(int iterations, F&& body) {
+    size_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        checksum += body(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return Result{ std::chrono::duration<double, std::nano>(elapsed).count() / iterations, checksum };
+}
+
+void report(const char* name, const Result& result) {
+    std::printf("%-28s %9.1f ns/message (checksum %zu)\n", name, result.ns_per_message, result.checksum);
+}
+
+void report_size(const char* name, size_t json_bytes, size_t binary_bytes) {
+    std::printf("%-28s %6zu bytes json %6zu bytes binary (%.1fx)\n",
+        name, json_bytes, binary_bytes, static_cast<double>(json_bytes) / binary_bytes);
+}
+
+size_t decode_json(const std::string& frame) {
+    json message = json::parse(frame);
+    const json& data = message["params"]["data"];
+    size_t checksum = 0;
+    if (data.is_array()) {
+        for (const auto& trade : data) {
+            checksum += static_cast<size_t>(trade["price"].get<double>()) + trade["trade_seq"].get<size_t>();
+        }
+        return checksum;
+    }
+    if (data.contains("bids")) {
+        for (const char* side : { "bids", "asks" }) {
+            for (const auto& level : data[side]) {
+                checksum += static_cast<size_t>(level[1].get<double>() + level[2].get<double>());
+            }
+        }
+        return checksum + data["change_id"].get<size_t>();
+    }
+    return static_cast<size_t>(data["best_bid_price"].get<double>() + data["best_ask_price"].get<double>()
+        + data["mark_price"].get<double>());
+}
+
+size_t decode_binary(const std::string& frame) {
+    BinaryReader reader(frame.data(), frame.size());
+    BinaryHeader header;
+    size_t checksum = 0;
+    while (reader.next(header)) {
+        switch (header.type) {
+        case BinaryMessageType::BookSnapshot:
+        case BinaryMessageType::BookDelta: {
+            BinaryBook book;
+            if (reader.read(book)) {
+                for (uint32_t i = 0; i < book.bid_count + book.ask_count; ++i) {
+                    checksum += static_cast<size_t>(book.price(i) + book.amount(i));
+                }
+                checksum += static_cast<size_t>(book.change_id);
+            }
+            break;
+        }
+        case BinaryMessageType::TopOfBook: {
+            BinaryTopOfBook top;
+            if (reader.read(top)) {
+                checksum += static_cast<size_t>(top.bid_price + top.ask_price + top.mark_price);
+            }
+            break;
+        }
+        case BinaryMessageType::Trade: {
+            BinaryTrade trade;
+            if (reader.read(trade)) {
+                checksum += static_cast<size_t>(trade.price) + static_cast<size_t>(trade.trade_seq);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    return checksum;
+}
+
+template <typename Update, typename Decode, typename Encode>
+void compare(const char* name, int iterations, const std::string& frame, Decode&& decode, Encode&& encode) {
+    NotificationEnvelope envelope;
+    Update update;
+    if (!decode_envelope(frame, envelope) || !decode(envelope.data, update)) {
+        std::fprintf(stderr, "%s: sample frame does not decode\n", name);
+        std::exit(1);
+    }
+    std::string binary;
+    encode(binary, update);
+    if (decode_json(frame) != decode_binary(binary)) {
+        std::fprintf(stderr, "%s: binary encoding does not match the json frame\n", name);
+        std::exit(1);
+    }
+
+    std::printf("\n");
+    report_size(name, frame.size(), binary.size());
+    std::string out;
+    report("  binary encode", run(iterations, [&](int) {
+        out.clear();
+        encode(out, update);
+        return out.size();
+    }));
+    report("  json decode (nlohmann)", run(iterations, [&](int) { return decode_json(frame); }));
+    report("  binary decode", run(iterations, [&](int) { return decode_binary(binary); }));
+}
+
+}
+
+int main(int argc, char** argv) {
+    const int iterations = argc > 1 ? std::atoi(argv[1]) : 200000;
+    const InstrumentId instrument = 7;
+
+    const std::string book_delta = R"({"jsonrpc":"2.0","method":"subscription","params":{"channel":"book.BTC-PERPETUAL.raw",)"
+        R"("data":{"type":"change","timestamp":1700000000123,"prev_change_id":68492301,"instrument_name":"BTC-PERPETUAL",)"
+        R"("change_id":68492302,"bids":[["change",37012.5,12340.0],["delete",37011.0,0.0]],)"
+        R"("asks":[["new",37013.0,5000.0]]}}})";
+    const std::string ticker = R"({"jsonrpc":"2.0","method":"subscription","params":{"channel":"ticker.BTC-PERPETUAL.100ms",)"
+        R"("data":{"timestamp":1700000000123,"stats":{"volume_usd":512345670.0,"volume":13844.2,"price_change":1.21,)"
+        R"("low":36480.0,"high":37120.5},"state":"open","settlement_price":36950.12,"open_interest":612345670,)"
+        R"("min_price":36457.2,"max_price":37567.8,"mark_price":37012.77,"last_price":37013.0,)"
+        R"("interest_value":0.0,"instrument_name":"BTC-PERPETUAL","index_price":37005.31,"funding_8h":0.00003,)"
+        R"("estimated_delivery_price":37005.31,"current_funding":0.0,"best_bid_price":37012.5,)"
+        R"("best_bid_amount":12340.0,"best_ask_price":37013.0,"best_ask_amount":5000.0}}})";
+    const std::string trades = R"({"jsonrpc":"2.0","method":"subscription","params":{"channel":"trades.BTC-PERPETUAL.raw",)"
+        R"("data":[{"trade_seq":91234567,"trade_id":"291234567","timestamp":1700000000123,"tick_direction":0,)"
+        R"("price":37013.0,"mark_price":37012.77,"instrument_name":"BTC-PERPETUAL","index_price":37005.31,)"
+        R"("direction":"buy","amount":1200.0}]}})";
+
+    compare<BookUpdate>("book delta (3 levels)", iterations, book_delta, decode_book_data,
+        [&](std::string& out, const BookUpdate& update) { encode_binary_book(out, instrument, update); });
+    compare<TickerUpdate>("ticker -> top of book", iterations, ticker, decode_ticker_data,
+        [&](std::string& out, const TickerUpdate& update) { encode_binary_top_of_book(out, instrument, update); });
+    compare<TradesUpdate>("trade", iterations, trades, decode_trades_data,
+        [&](std::string& out, const TradesUpdate& update) { encode_binary_trades(out, instrument, update); });
+
+    return 0;
+}
@@ -0,0 +1,154 @@
+// Compares building order-entry frames through nlohmann::json (the generic
+// send_request path) with the OrderEncoder fast path: time per frame and
+// heap allocations per frame.
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <nlohmann/json.hpp>
+#include "order_encoder.h"
+
+using json = nlohmann::json;
+
+namespace {
+
+std::atomic<uint64_t> allocations{ 0 };
+
+struct Result {
+    double ns_per_frame;
+    double allocations_per_frame;
+    size_t checksum;
+};
+
+template <typename F>
+Result run(int iterations, F&& encode) {
+    size_t checksum = 0;
+    uint64_t allocations_before = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        checksum += encode(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    uint64_t allocated = allocations.load() - allocations_before;
+    return Result{
+        std::chrono::duration<double, std::nano>(elapsed).count() / iterations,
+        static_cast<double>(allocated) / iterations,
+        checksum
+    };
+}
+
+void report(const char* name, const Result& result) {
+    std::printf("%-28s %9.1f ns/frame %6.2f allocs/frame (checksum %zu)\n",
+        name, result.ns_per_frame, result.allocations_per_frame, result.checksum);
+}
+
+}
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+int main(int argc, char** argv) {
+    const int iterations = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const std::string instrument = "BTC-PERPETUAL";
+    const std::string type = "limit";
+    const std::string side = "buy";
+    const std::string order_id = "ETH-1234567890";
+
+    // The fast path must produce a frame equivalent to the json one
+    OrderEncoder encoder;
+    encoder.encode_order(side, instrument, 10, 50000.5, type);
+    encoder.set_id(42);
+    json decoded = json::parse(encoder.frame());
+    json expected = {
+        {"jsonrpc", "2.0"},
+        {"id", 42},
+        {"method", "private/buy"},
+        {"params", {{"instrument_name", instrument}, {"amount", 10}, {"type", type}, {"side", side}, {"price", 50000.5}}}
+    };
+    if (decoded != expected) {
+        std::fprintf(stderr, "encoder mismatch: %s\n", std::string(encoder.frame()).c_str());
+        return 1;
+    }
+
+    int64_t request_id = 0;
+
+    report("place_order json", run(iterations, [&](int i) {
+        json params = {
+            {"instrument_name", instrument},
+            {"amount", 10 + i % 7},
+            {"type", type},
+            {"side", side}
+        };
+        params["price"] = 50000.5 + i % 100;
+        json request = {
+            {"jsonrpc", "2.0"},
+            {"id", ++request_id},
+            {"method", "private/" + side},
+            {"params", params}
+        };
+        return request.dump().size();
+    }));
+
+    report("place_order encoder", run(iterations, [&](int i) {
+        encoder.encode_order(side, instrument, 10 + i % 7, 50000.5 + i % 100, type);
+        encoder.set_id(++request_id);
+        return encoder.frame().size();
+    }));
+
+    report("cancel_order json", run(iterations, [&](int) {
+        json params = {
+            {"order_id", order_id}
+        };
+        json request = {
+            {"jsonrpc", "2.0"},
+            {"id", ++request_id},
+            {"method", "private/cancel"},
+            {"params", params}
+        };
+        return request.dump().size();
+    }));
+
+    report("cancel_order encoder", run(iterations, [&](int) {
+        encoder.encode_cancel(order_id);
+        encoder.set_id(++request_id);
+        return encoder.frame().size();
+    }));
+
+    report("modify_order json", run(iterations, [&](int i) {
+        json params = {
+            {"order_id", order_id},
+            {"amount", 10 + i % 7},
+            {"price", 50000.5 + i % 100}
+        };
+        json request = {
+            {"jsonrpc", "2.0"},
+            {"id", ++request_id},
+            {"method", "private/edit"},
+            {"params", params}
+        };
+        return request.dump().size();
+    }));
+
+    report("modify_order encoder", run(iterations, [&](int i) {
+        encoder.encode_edit(order_id, 10 + i % 7, 50000.5 + i % 100);
+        encoder.set_id(++request_id);
+        return encoder.frame().size();
+    }));
+
+    return 0;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include "binary_protocol.h"
+#include "channel_messages.h"
+#include "instrument_registry.h"
+#include "market_data.h"
+
+// Appends the binary_protocol.h messages for decoded Deribit notifications
+void encode_binary_book(std::string& out, InstrumentId instrument, const BookUpdate& update);
+void encode_binary_top_of_book(std::string& out, InstrumentId instrument, const TickerUpdate& update);
+void encode_binary_trades(std::string& out, InstrumentId instrument, const TradesUpdate& update);
+void encode_binary_analytics(std::string& out, InstrumentId instrument, int64_t timestamp,
+    const BookAnalytics& analytics);
+// Each order is preceded by its instrument's Instrument message, since
+// the client need not have subscribed to that instrument
+void encode_binary_orders(std::string& out, const InstrumentRegistry& instruments, const OrdersUpdate& update);
+void encode_binary_instrument(std::string& out, InstrumentId instrument, const InstrumentInfo& info);
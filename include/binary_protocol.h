@@ -0,0 +1,339 @@
+#pragma once
+
+// Compact binary encoding of the downstream feed. Self-contained so that
+// consumers can copy this header as their decoder.
+//
+// Clients opt in per connection by requesting the WebSocket subprotocol
+// kBinarySubprotocol; market data then arrives as binary frames, each
+// holding one or more messages back to back. Requests and their responses
+// stay JSON text. All integers are little-endian, prices and amounts are
+// integers scaled by kBinaryScale, and instruments are integer IDs
+// announced by an Instrument message before their first update.
+//
+// Every message starts with a 24-byte header:
+//    0  u32  length of the whole message in bytes
+//    4  u8   BinaryMessageType
+//    5  u8   version (kBinaryVersion)
+//    6  u16  reserved
+//    8  u32  instrument ID
+//   12  u32  reserved
+//   16  i64  exchange timestamp, ms
+//
+// Bodies, by type:
+//   BookSnapshot, BookDelta (book.<instrument>.raw)
+//     24  i64  change_id
+//     32  i64  prev_change_id (0 in snapshots)
+//     40  u32  bid count
+//     44  u32  ask count
+//     48  bid levels then ask levels, 16 bytes each: i64 price, i64 amount;
+//         in deltas an amount of 0 removes the level
+//   TopOfBook (ticker.<instrument>.*), 80 bytes
+//     24  i64  bid price      32  i64  bid amount
+//     40  i64  ask price      48  i64  ask amount
+//     56  i64  last price     64  i64  mark price
+//     72  i64  index price
+//   Trade (trades.<instrument>.*), 56 bytes
+//     24  i64  price          32  i64  amount
+//     40  i64  trade_seq      48  u8   BinarySide, 7 bytes reserved
+//   Order (our own orders), 104 bytes
+//     24  i64  price          32  i64  amount
+//     40  i64  filled amount  48  i64  average price
+//     56  u8   BinarySide     57  u8   BinaryOrderState
+//     58  u8   BinaryOrderType
+//     59  u8   order ID length, then 4 bytes reserved
+//     64  char order ID[40], zero padded
+//   Analytics (book.<instrument>.analytics), 88 bytes
+//     24  i64  mid            32  i64  spread
+//     40  i64  microprice     48  i64  imbalance
+//     56  i64  bid VWAP       64  i64  ask VWAP (0 if the levels run out)
+//     72  i64  VWAP size      80  u32  imbalance levels, 4 bytes reserved
+//   Instrument, 96 bytes
+//     24  i64  tick size      32  i64  contract size
+//     40  i64  strike (0 unless an option)
+//     48  i64  expiration timestamp, ms (0 if none)
+//     56  u8   BinaryInstrumentKind
+//     57  u8   flags: bit 0 call option, bit 1 inverse
+//     58  u8   name length, then 5 bytes reserved
+//     64  char name[32], zero padded
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+constexpr const char* kBinarySubprotocol = "dts.binary.v1";
+constexpr uint8_t kBinaryVersion = 1;
+constexpr double kBinaryScale = 1e8;
+
+constexpr size_t kBinaryHeaderSize = 24;
+constexpr size_t kBinaryBookLevelsOffset = 48;
+constexpr size_t kBinaryBookLevelSize = 16;
+constexpr size_t kBinaryTopOfBookSize = 80;
+constexpr size_t kBinaryTradeSize = 56;
+constexpr size_t kBinaryOrderSize = 104;
+constexpr size_t kBinaryOrderIdCapacity = 40;
+constexpr size_t kBinaryAnalyticsSize = 88;
+constexpr size_t kBinaryInstrumentSize = 96;
+constexpr size_t kBinaryNameCapacity = 32;
+
+enum class BinaryMessageType : uint8_t {
+    BookSnapshot = 1,
+    BookDelta = 2,
+    TopOfBook = 3,
+    Trade = 4,
+    Order = 5,
+    Instrument = 6,
+    Analytics = 7
+};
+
+enum class BinarySide : uint8_t { Unknown = 0, Buy = 1, Sell = 2 };
+enum class BinaryOrderState : uint8_t { Unknown = 0, Open = 1, Filled = 2, Rejected = 3, Cancelled = 4, Untriggered = 5 };
+enum class BinaryOrderType : uint8_t {
+    Unknown = 0, Limit = 1, Market = 2, StopLimit = 3, StopMarket = 4, TakeLimit = 5, TakeMarket = 6,
+    MarketLimit = 7, TrailingStop = 8
+};
+enum class BinaryInstrumentKind : uint8_t { Unknown = 0, Future = 1, Option = 2, Spot = 3, FutureCombo = 4, OptionCombo = 5 };
+
+inline int64_t to_scaled(double value) { return std::llround(value * kBinaryScale); }
+inline double from_scaled(int64_t value) { return static_cast<double>(value) / kBinaryScale; }
+
+// Byte-wise, so the wire stays little-endian on any host
+template <typename T>
+inline void store_le(uint8_t* out, T value) {
+    uint64_t bits = static_cast<uint64_t>(value);
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        out[i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+}
+
+template <typename T>
+inline T load_le(const uint8_t* in) {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        bits |= static_cast<uint64_t>(in[i]) << (8 * i);
+    }
+    return static_cast<T>(bits);
+}
+
+// ---- Decoding ----
+
+struct BinaryHeader {
+    uint32_t length = 0;
+    BinaryMessageType type = BinaryMessageType::BookSnapshot;
+    uint8_t version = 0;
+    uint32_t instrument_id = 0;
+    int64_t timestamp = 0;
+};
+
+struct BinaryBook {
+    int64_t change_id = 0;
+    int64_t prev_change_id = 0;
+    uint32_t bid_count = 0;
+    uint32_t ask_count = 0;
+    const uint8_t* levels = nullptr;   // bids, then asks; read with price() and amount()
+
+    double price(size_t level) const { return from_scaled(load_le<int64_t>(levels + level * kBinaryBookLevelSize)); }
+    double amount(size_t level) const { return from_scaled(load_le<int64_t>(levels + level * kBinaryBookLevelSize + 8)); }
+};
+
+struct BinaryTopOfBook {
+    double bid_price = 0;
+    double bid_amount = 0;
+    double ask_price = 0;
+    double ask_amount = 0;
+    double last_price = 0;
+    double mark_price = 0;
+    double index_price = 0;
+};
+
+struct BinaryTrade {
+    double price = 0;
+    double amount = 0;
+    int64_t trade_seq = 0;
+    BinarySide side = BinarySide::Unknown;
+};
+
+struct BinaryOrder {
+    double price = 0;
+    double amount = 0;
+    double filled_amount = 0;
+    double average_price = 0;
+    BinarySide side = BinarySide::Unknown;
+    BinaryOrderState state = BinaryOrderState::Unknown;
+    BinaryOrderType type = BinaryOrderType::Unknown;
+    std::string_view order_id;   // into the frame
+};
+
+struct BinaryAnalytics {
+    double mid = 0;
+    double spread = 0;
+    double microprice = 0;
+    double imbalance = 0;
+    double bid_vwap = 0;
+    double ask_vwap = 0;
+    double vwap_size = 0;
+    uint32_t imbalance_levels = 0;
+};
+
+struct BinaryInstrument {
+    double tick_size = 0;
+    double contract_size = 0;
+    double strike = 0;
+    int64_t expiration_timestamp = 0;
+    BinaryInstrumentKind kind = BinaryInstrumentKind::Unknown;
+    bool is_call = false;
+    bool inverse = false;
+    std::string_view name;       // into the frame
+};
+
+// Walks the messages of one binary frame:
+//   BinaryReader reader(data, size);
+//   BinaryHeader header;
+//   while (reader.next(header)) { switch (header.type) { ... reader.read(book) ... } }
+// next() returns false at the end of the frame or on a malformed message.
+class BinaryReader {
+public:
+    BinaryReader(const void* data, size_t size) : data_(static_cast<const uint8_t*>(data)), size_(size) {}
+
+    bool next(BinaryHeader& header) {
+        offset_ += current_;
+        current_ = 0;
+        if (size_ - offset_ < kBinaryHeaderSize) {
+            return false;
+        }
+        const uint8_t* message = data_ + offset_;
+        header.length = load_le<uint32_t>(message);
+        header.type = static_cast<BinaryMessageType>(message[4]);
+        header.version = message[5];
+        header.instrument_id = load_le<uint32_t>(message + 8);
+        header.timestamp = load_le<int64_t>(message + 16);
+        if (header.length < kBinaryHeaderSize || header.length > size_ - offset_) {
+            return false;
+        }
+        current_ = header.length;
+        return true;
+    }
+
+    // Each read checks the current message has the size its type needs
+    bool read(BinaryBook& book) const {
+        const uint8_t* message = data_ + offset_;
+        if (current_ < kBinaryBookLevelsOffset) {
+            return false;
+        }
+        book.change_id = load_le<int64_t>(message + 24);
+        book.prev_change_id = load_le<int64_t>(message + 32);
+        book.bid_count = load_le<uint32_t>(message + 40);
+        book.ask_count = load_le<uint32_t>(message + 44);
+        book.levels = message + kBinaryBookLevelsOffset;
+        return current_ >= kBinaryBookLevelsOffset +
+            (static_cast<size_t>(book.bid_count) + book.ask_count) * kBinaryBookLevelSize;
+    }
+
+    bool read(BinaryTopOfBook& top) const {
+        const uint8_t* message = data_ + offset_;
+        if (current_ < kBinaryTopOfBookSize) {
+            return false;
+        }
+        top.bid_price = from_scaled(load_le<int64_t>(message + 24));
+        top.bid_amount = from_scaled(load_le<int64_t>(message + 32));
+        top.ask_price = from_scaled(load_le<int64_t>(message + 40));
+        top.ask_amount = from_scaled(load_le<int64_t>(message + 48));
+        top.last_price = from_scaled(load_le<int64_t>(message + 56));
+        top.mark_price = from_scaled(load_le<int64_t>(message + 64));
+        top.index_price = from_scaled(load_le<int64_t>(message + 72));
+        return true;
+    }
+
+    bool read(BinaryTrade& trade) const {
+        const uint8_t* message = data_ + offset_;
+        if (current_ < kBinaryTradeSize) {
+            return false;
+        }
+        trade.price = from_scaled(load_le<int64_t>(message + 24));
+        trade.amount = from_scaled(load_le<int64_t>(message + 32));
+        trade.trade_seq = load_le<int64_t>(message + 40);
+        trade.side = static_cast<BinarySide>(message[48]);
+        return true;
+    }
+
+    bool read(BinaryOrder& order) const {
+        const uint8_t* message = data_ + offset_;
+        if (current_ < kBinaryOrderSize) {
+            return false;
+        }
+        order.price = from_scaled(load_le<int64_t>(message + 24));
+        order.amount = from_scaled(load_le<int64_t>(message + 32));
+        order.filled_amount = from_scaled(load_le<int64_t>(message + 40));
+        order.average_price = from_scaled(load_le<int64_t>(message + 48));
+        order.side = static_cast<BinarySide>(message[56]);
+        order.state = static_cast<BinaryOrderState>(message[57]);
+        order.type = static_cast<BinaryOrderType>(message[58]);
+        size_t length = message[59] < kBinaryOrderIdCapacity ? message[59] : kBinaryOrderIdCapacity;
+        order.order_id = std::string_view(reinterpret_cast<const char*>(message + 64), length);
+        return true;
+    }
+
+    bool read(BinaryAnalytics& analytics) const {
+        const uint8_t* message = data_ + offset_;
+        if (current_ < kBinaryAnalyticsSize) {
+            return false;
+        }
+        analytics.mid = from_scaled(load_le<int64_t>(message + 24));
+        analytics.spread = from_scaled(load_le<int64_t>(message + 32));
+        analytics.microprice = from_scaled(load_le<int64_t>(message + 40));
+        analytics.imbalance = from_scaled(load_le<int64_t>(message + 48));
+        analytics.bid_vwap = from_scaled(load_le<int64_t>(message + 56));
+        analytics.ask_vwap = from_scaled(load_le<int64_t>(message + 64));
+        analytics.vwap_size = from_scaled(load_le<int64_t>(message + 72));
+        analytics.imbalance_levels = load_le<uint32_t>(message + 80);
+        return true;
+    }
+
+    bool read(BinaryInstrument& instrument) const {
+        const uint8_t* message = data_ + offset_;
+        if (current_ < kBinaryInstrumentSize) {
+            return false;
+        }
+        instrument.tick_size = from_scaled(load_le<int64_t>(message + 24));
+        instrument.contract_size = from_scaled(load_le<int64_t>(message + 32));
+        instrument.strike = from_scaled(load_le<int64_t>(message + 40));
+        instrument.expiration_timestamp = load_le<int64_t>(message + 48);
+        instrument.kind = static_cast<BinaryInstrumentKind>(message[56]);
+        instrument.is_call = (message[57] & 1) != 0;
+        instrument.inverse = (message[57] & 2) != 0;
+        size_t length = message[58] < kBinaryNameCapacity ? message[58] : kBinaryNameCapacity;
+        instrument.name = std::string_view(reinterpret_cast<const char*>(message + 64), length);
+        return true;
+    }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t offset_ = 0;
+    size_t current_ = 0;
+};
+
+// ---- Encoding ----
+
+// Appends one message to out and returns a pointer to its body (offset
+// kBinaryHeaderSize), zero-filled up to length
+inline uint8_t* append_binary_message(std::string& out, BinaryMessageType type, uint32_t instrument_id,
+    int64_t timestamp, size_t length) {
+    size_t start = out.size();
+    out.resize(start + length, '\0');
+    uint8_t* message = reinterpret_cast<uint8_t*>(&out[start]);
+    store_le<uint32_t>(message, static_cast<uint32_t>(length));
+    message[4] = static_cast<uint8_t>(type);
+    message[5] = kBinaryVersion;
+    store_le<uint32_t>(message + 8, instrument_id);
+    store_le<int64_t>(message + 16, timestamp);
+    return message + kBinaryHeaderSize;
+}
+
+inline void store_text(uint8_t* length_field, uint8_t* out, std::string_view text, size_t capacity) {
+    size_t length = text.size() < capacity ? text.size() : capacity;
+    *length_field = static_cast<uint8_t>(length);
+    std::memcpy(out, text.data(), length);
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// Kernels over one side of a BookSnapshot, laid out as separate price and
+// amount arrays. AVX2 when the build enables it (DERIBIT_ENABLE_AVX2),
+// SSE2 on any other x86-64 build, scalar elsewhere; all give the same
+// results up to rounding.
+
+// depth[i] = amounts[0] + ... + amounts[i]
+// notional[i] = prices[0] * amounts[0] + ... + prices[i] * amounts[i]
+inline void cumulate_levels(const double* prices, const double* amounts, size_t count,
+    double* depth, double* notional) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    // In-register inclusive scan: add the vector shifted up one lane, then two
+    const __m256d zero = _mm256_setzero_pd();
+    __m256d depth_carry = zero;
+    __m256d notional_carry = zero;
+    auto scan = [zero](__m256d x) {
+        x = _mm256_add_pd(x, _mm256_blend_pd(_mm256_permute4x64_pd(x, _MM_SHUFFLE(2, 1, 0, 0)), zero, 0x1));
+        return _mm256_add_pd(x, _mm256_blend_pd(_mm256_permute4x64_pd(x, _MM_SHUFFLE(1, 0, 0, 0)), zero, 0x3));
+        };
+    for (; i + 4 <= count; i += 4) {
+        __m256d amount = _mm256_loadu_pd(amounts + i);
+        __m256d value = _mm256_mul_pd(_mm256_loadu_pd(prices + i), amount);
+        __m256d d = _mm256_add_pd(scan(amount), depth_carry);
+        __m256d n = _mm256_add_pd(scan(value), notional_carry);
+        _mm256_storeu_pd(depth + i, d);
+        _mm256_storeu_pd(notional + i, n);
+        depth_carry = _mm256_permute4x64_pd(d, _MM_SHUFFLE(3, 3, 3, 3));
+        notional_carry = _mm256_permute4x64_pd(n, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+    double running_depth = i > 0 ? depth[i - 1] : 0.0;
+    double running_notional = i > 0 ? notional[i - 1] : 0.0;
+#elif defined(__SSE2__) || defined(_M_X64)
+    const __m128d zero = _mm_setzero_pd();
+    __m128d depth_carry = zero;
+    __m128d notional_carry = zero;
+    for (; i + 2 <= count; i += 2) {
+        __m128d amount = _mm_loadu_pd(amounts + i);
+        __m128d value = _mm_mul_pd(_mm_loadu_pd(prices + i), amount);
+        // [a, b] + [0, a] = [a, a + b]
+        __m128d d = _mm_add_pd(_mm_add_pd(amount, _mm_unpacklo_pd(zero, amount)), depth_carry);
+        __m128d n = _mm_add_pd(_mm_add_pd(value, _mm_unpacklo_pd(zero, value)), notional_carry);
+        _mm_storeu_pd(depth + i, d);
+        _mm_storeu_pd(notional + i, n);
+        depth_carry = _mm_unpackhi_pd(d, d);
+        notional_carry = _mm_unpackhi_pd(n, n);
+    }
+    double running_depth = i > 0 ? depth[i - 1] : 0.0;
+    double running_notional = i > 0 ? notional[i - 1] : 0.0;
+#else
+    double running_depth = 0.0;
+    double running_notional = 0.0;
+#endif
+    for (; i < count; ++i) {
+        running_depth += amounts[i];
+        running_notional += prices[i] * amounts[i];
+        depth[i] = running_depth;
+        notional[i] = running_notional;
+    }
+}
+
+// Index of the first value >= target in an ascending array, or count
+inline size_t first_at_least(const double* values, size_t count, double target) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256d threshold = _mm256_set1_pd(target);
+    for (; i + 4 <= count; i += 4) {
+        int mask = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(values + i), threshold, _CMP_GE_OQ));
+        if (mask != 0) {
+            size_t lane = 0;
+            while (!(mask & (1 << lane))) {
+                ++lane;
+            }
+            return i + lane;
+        }
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    const __m128d threshold = _mm_set1_pd(target);
+    for (; i + 2 <= count; i += 2) {
+        int mask = _mm_movemask_pd(_mm_cmpge_pd(_mm_loadu_pd(values + i), threshold));
+        if (mask != 0) {
+            return i + ((mask & 1) ? 0 : 1);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        if (values[i] >= target) {
+            return i;
+        }
+    }
+    return count;
+}
+
+// Average price of taking size from one side, from the cumulate_levels
+// output; 0 when the levels do not hold that much
+inline double vwap_for_size(const double* prices, const double* depth, const double* notional, size_t count,
+    double size) {
+    if (!(size > 0)) {
+        return 0.0;
+    }
+    size_t level = first_at_least(depth, count, size);
+    if (level == count) {
+        return 0.0;
+    }
+    double filled = level > 0 ? depth[level - 1] : 0.0;
+    double cost = level > 0 ? notional[level - 1] : 0.0;
+    return (cost + (size - filled) * prices[level]) / size;
+}
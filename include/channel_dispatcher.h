@@ -0,0 +1,113 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include "channel_messages.h"
+#include "notification_decoder.h"
+
+struct ChannelContext {
+    const ChannelRoute& route;
+    const std::string& frame;
+    int64_t receive_ns;   // monotonic time the frame left the socket
+};
+
+// Compile-time decoder for each channel family
+template <ChannelFamily F>
+struct ChannelDecoder;
+
+template <>
+struct ChannelDecoder<ChannelFamily::Book> {
+    using message_type = BookUpdate;
+    static bool decode(std::string_view data, BookUpdate& out) { return decode_book_data(data, out); }
+};
+
+template <>
+struct ChannelDecoder<ChannelFamily::Ticker> {
+    using message_type = TickerUpdate;
+    static bool decode(std::string_view data, TickerUpdate& out) { return decode_ticker_data(data, out); }
+};
+
+template <>
+struct ChannelDecoder<ChannelFamily::Trades> {
+    using message_type = TradesUpdate;
+    static bool decode(std::string_view data, TradesUpdate& out) { return decode_trades_data(data, out); }
+};
+
+template <>
+struct ChannelDecoder<ChannelFamily::UserOrders> {
+    using message_type = OrdersUpdate;
+    static bool decode(std::string_view data, OrdersUpdate& out) { return decode_user_orders_data(data, out); }
+};
+
+template <>
+struct ChannelDecoder<ChannelFamily::UserTrades> {
+    using message_type = UserTradesUpdate;
+    static bool decode(std::string_view data, UserTradesUpdate& out) { return decode_user_trades_data(data, out); }
+};
+
+// One virtual call per frame; everything behind it is resolved at compile time
+class ChannelDispatcher {
+public:
+    virtual ~ChannelDispatcher() = default;
+
+    // Returns false when the sink has no handler for the route's family or
+    // the payload does not decode, so the caller can fall back to the DOM
+    virtual bool dispatch(const ChannelContext& context, std::string_view data) = 0;
+};
+
+template <typename Sink, typename Message, typename = void>
+struct sink_accepts : std::false_type {};
+
+template <typename Sink, typename Message>
+struct sink_accepts<Sink, Message, std::void_t<decltype(std::declval<Sink&>().on_channel(
+    std::declval<const ChannelContext&>(), std::declval<const Message&>()))>> : std::true_type {};
+
+// Binds a sink exposing on_channel(const ChannelContext&, const X&)
+// overloads for the families it wants. Families without an overload are
+// never decoded.
+template <typename Sink>
+class TypedChannelDispatcher : public ChannelDispatcher {
+public:
+    explicit TypedChannelDispatcher(Sink& sink) : sink_(sink) {}
+
+    bool dispatch(const ChannelContext& context, std::string_view data) override {
+        switch (context.route.family) {
+        case ChannelFamily::Book:
+            return deliver<ChannelFamily::Book>(context, data, book_);
+        case ChannelFamily::Ticker:
+            return deliver<ChannelFamily::Ticker>(context, data, ticker_);
+        case ChannelFamily::Trades:
+            return deliver<ChannelFamily::Trades>(context, data, trades_);
+        case ChannelFamily::UserOrders:
+            return deliver<ChannelFamily::UserOrders>(context, data, orders_);
+        case ChannelFamily::UserTrades:
+            return deliver<ChannelFamily::UserTrades>(context, data, user_trades_);
+        default:
+            return false;
+        }
+    }
+
+private:
+    Sink& sink_;
+    BookUpdate book_;
+    TickerUpdate ticker_;
+    TradesUpdate trades_;
+    OrdersUpdate orders_;
+    UserTradesUpdate user_trades_;
+
+    template <ChannelFamily F, typename Message>
+    bool deliver(const ChannelContext& context, std::string_view data, Message& message) {
+        if constexpr (sink_accepts<Sink, Message>::value) {
+            if (!ChannelDecoder<F>::decode(data, message)) {
+                return false;
+            }
+            sink_.on_channel(context, message);
+            return true;
+        }
+        else {
+            return false;
+        }
+    }
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "market_data.h"
+
+enum class ChannelFamily {
+    Book,
+    Ticker,
+    Trades,
+    UserOrders,
+    UserTrades,
+    Unknown
+};
+
+// A subscription channel split into its parts once, at subscribe time.
+// `instrument` is empty for kind/currency channels such as
+// trades.future.BTC.100ms.
+struct ChannelRoute {
+    ChannelFamily family = ChannelFamily::Unknown;
+    uint32_t channel_id = 0;
+    std::string channel;
+    std::string instrument;
+    InstrumentId instrument_id = kInvalidInstrument;
+    std::string interval;
+};
+
+bool parse_channel(std::string_view channel, ChannelRoute& route);
+
+// Decoded channel payloads. String fields are views into the received
+// frame and are only valid for the duration of the handler call; vectors
+// are reused between frames.
+
+struct TickerUpdate {
+    std::string_view instrument_name;
+    int64_t timestamp = 0;
+    double best_bid_price = 0;
+    double best_bid_amount = 0;
+    double best_ask_price = 0;
+    double best_ask_amount = 0;
+    double last_price = 0;
+    double mark_price = 0;
+    double index_price = 0;
+    double underlying_price = 0;
+    double mark_iv = 0;
+    double bid_iv = 0;
+    double ask_iv = 0;
+    double open_interest = 0;
+};
+
+struct TradeEvent {
+    std::string_view trade_id;
+    std::string_view instrument_name;
+    std::string_view direction;
+    double price = 0;
+    double amount = 0;
+    int64_t trade_seq = 0;
+    int64_t timestamp = 0;
+};
+
+struct TradesUpdate {
+    std::vector<TradeEvent> trades;
+};
+
+struct OrderEvent {
+    std::string_view order_id;
+    std::string_view label;
+    std::string_view instrument_name;
+    std::string_view order_state;
+    std::string_view direction;
+    std::string_view order_type;
+    double price = 0;
+    double amount = 0;
+    double filled_amount = 0;
+    double average_price = 0;
+    int64_t creation_timestamp = 0;
+    int64_t last_update_timestamp = 0;
+};
+
+struct OrdersUpdate {
+    std::vector<OrderEvent> orders;
+};
+
+struct UserTradeEvent {
+    std::string_view trade_id;
+    std::string_view order_id;
+    std::string_view label;
+    std::string_view instrument_name;
+    std::string_view direction;
+    double price = 0;
+    double amount = 0;
+    double fee = 0;
+    int64_t timestamp = 0;
+};
+
+struct UserTradesUpdate {
+    std::vector<UserTradeEvent> trades;
+};
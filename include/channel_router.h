@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "channel_messages.h"
+
+using json = nlohmann::json;
+
+struct ChannelEntry {
+    ChannelRoute route;
+    std::function<void(const json&)> handler;
+};
+
+// Immutable open-addressing table from channel name to dense channel ID.
+// Lookups take a string_view into the received frame and never allocate.
+class ChannelTable {
+public:
+    static constexpr uint32_t kNoChannel = UINT32_MAX;
+
+    ChannelTable(std::vector<ChannelEntry> entries, uint64_t version);
+
+    uint32_t find(std::string_view channel) const;
+    const ChannelEntry& entry(uint32_t id) const { return entries_[id]; }
+    uint64_t version() const { return version_; }
+
+    static uint64_t hash(std::string_view channel);
+
+private:
+    struct Slot {
+        uint64_t hash = 0;
+        uint32_t id = kNoChannel;
+    };
+
+    std::vector<ChannelEntry> entries_;
+    std::vector<Slot> slots_;
+    uint64_t mask_ = 0;
+    uint64_t version_;
+};
+
+// Owns the channel set. Writers (subscribe/unsubscribe, handler
+// registration) rebuild the table under a mutex and publish it with a
+// single pointer store; the one thread that delivers frames reads it
+// without locking. Old tables are freed once that reader has moved past them.
+class ChannelRouter {
+public:
+    ChannelRouter();
+
+    // Adds or replaces the typed route for route.channel; returns its ID
+    uint32_t set_route(const ChannelRoute& route);
+    // Same for many channels at once, with a single table rebuild
+    void set_routes(const std::vector<ChannelRoute>& routes);
+    uint32_t set_handler(const std::string& channel, std::function<void(const json&)> handler);
+    void remove_route(const std::string& channel);
+
+    // Reader side: only valid on the delivering thread, until the next acquire()
+    const ChannelTable& acquire();
+
+private:
+    std::mutex writer_mutex_;
+    std::vector<ChannelEntry> entries_;
+    std::vector<uint32_t> free_ids_;
+    uint64_t version_ = 0;
+    std::vector<std::shared_ptr<const ChannelTable>> retired_;
+
+    std::shared_ptr<const ChannelTable> current_;
+    std::atomic<const ChannelTable*> published_;
+    std::atomic<uint64_t> reader_version_{ 0 };
+
+    uint32_t find_or_allocate(const std::string& channel);
+    void publish();
+};
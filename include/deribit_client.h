@@ -1,63 +1,239 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <functional>
-#include <map>
 #include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <websocketpp/config/asio_client.hpp>
 #include <websocketpp/client.hpp>
 #include <nlohmann/json.hpp>
 #include <boost/asio.hpp>
 #include <boost/asio/ssl/context.hpp>
+#include "channel_dispatcher.h"
+#include "channel_router.h"
+#include "instrument_registry.h"
+#include "order_encoder.h"
+#include "outbound_queue.h"
+#include "rate_limiter.h"
+#include "risk_gate.h"
+#include "pending_requests.h"
+#include "spsc_ring.h"
 
 
 using json = nlohmann::json;
 using WebsocketClient = websocketpp::client<websocketpp::config::asio_tls_client>;
 
+// What the I/O thread does when the inbound ring is full
+enum class OverflowPolicy {
+    Block,  // yield until the processing thread frees a slot (back-pressure on the socket)
+    Spin,   // busy-wait for a slot
+    Drop    // discard the frame; book gaps are then recovered through resync
+};
+
+struct PipelineConfig {
+    size_t ring_capacity = 16384;
+    OverflowPolicy overflow_policy = OverflowPolicy::Block;
+};
+
+enum class EventLoopMode {
+    Blocking,  // websocketpp run_one(): sleeps in epoll between events
+    BusyPoll   // poll() in a tight loop on a dedicated core
+};
+
+struct ThreadTuning {
+    int cpu = -1;           // pin to this CPU; -1 leaves affinity alone
+    bool realtime = false;  // SCHED_FIFO (needs CAP_SYS_NICE on Linux)
+    int priority = 50;
+};
+
+struct EventLoopConfig {
+    EventLoopMode mode = EventLoopMode::Blocking;
+    ThreadTuning io_thread;
+    ThreadTuning processing_thread;
+};
+
+struct PipelineStats {
+    uint64_t received = 0;
+    uint64_t processed = 0;
+    uint64_t dropped = 0;
+    size_t depth = 0;
+    size_t high_water = 0;
+};
+
+// One instrument's two-sided quote for private/mass_quote; a side with
+// zero amount is left out
+struct MassQuoteEntry {
+    std::string instrument;
+    double bid_price = 0;
+    double bid_amount = 0;
+    double ask_price = 0;
+    double ask_amount = 0;
+};
+
 class DeribitClient {
 public:
     using MessageHandler = std::function<void(const json&)>;
 
-    DeribitClient(const std::string& client_id, const std::string& client_secret);
+    DeribitClient(const std::string& client_id, const std::string& client_secret, InstrumentRegistry& instruments);
     ~DeribitClient();
 
+    // Must be called before connect()
+    void set_pipeline_config(const PipelineConfig& config);
+    void set_event_loop_config(const EventLoopConfig& config);
+    void set_rate_limit_config(const RateLimitConfig& config);
+    // Checked before every place_order/modify_order; nullptr disables
+    void set_risk_gate(RiskGate* gate) { risk_gate_ = gate; }
+    PipelineStats pipeline_stats() const;
+    PendingRequestStats request_stats() const;
+    // Send-to-receive round trip of requests with a response handler
+    LatencyHistogram::Summary request_latency() const;
+    OutboundStats outbound_stats() const;
+    // Queue-to-wire: enqueue until the frame is handed to the websocket writer
+    LatencyHistogram::Summary outbound_latency() const;
+    RateLimitStats rate_limit_stats() const;
+
+    // Switches the I/O and processing threads between busy-polling and
+    // blocking at runtime, e.g. spin during trading hours only
+    void set_event_loop_mode(EventLoopMode mode);
+    EventLoopMode event_loop_mode() const;
+
     bool connect();
     void disconnect();
     bool is_connected() const;
 
     void authenticate();
     void subscribe(const std::string& channel);
+    // One request for many public or many private channels
+    void subscribe(const std::vector<std::string>& channels);
     void unsubscribe(const std::string& channel);
 
-    void place_order(const std::string& instrument, double amount, double price,
-        const std::string& type, const std::string& side);
+    // Runs task on the processing thread between frames, in order with the
+    // channel handlers, so it sees books exactly as they left them. Tasks
+    // posted while the client is stopped run once it is started.
+    void post(std::function<void()> task);
+    // post() after delay_ms, timed on the I/O thread
+    void post_after(long delay_ms, std::function<void()> task);
+
+    // The label lets user.orders events be matched to this order before its
+    // exchange ID is known. Orders refused by the risk gate are not sent and
+    // their handler is not called; the reason is returned instead. Otherwise
+    // on_accepted runs before the order is queued, so it can be tracked
+    // before any response, and the handler is called exactly once. The
+    // instrument is resolved by the caller, so the order path takes no lock.
+    RiskReject place_order(InstrumentId instrument, double amount, double price,
+        const std::string& type, const std::string& side, const std::string& label = "",
+        std::function<void(const json&)> handler = nullptr, const std::function<void()>& on_accepted = nullptr);
     void cancel_order(const std::string& order_id);
-    void modify_order(const std::string& order_id, double amount, double price);
+    RiskReject modify_order(const std::string& order_id, double amount, double price);
+
+    // Bulk order actions: one request, one round trip. Cancels ask for
+    // detailed results so the handler can reconcile every affected order.
+    void cancel_all(std::function<void(const json&)> handler);
+    void cancel_all_by_instrument(const std::string& instrument, std::function<void(const json&)> handler);
+    void cancel_by_label(const std::string& label, std::function<void(const json&)> handler);
+    void mass_quote(const std::string& quote_id, const std::vector<MassQuoteEntry>& quotes,
+        std::function<void(const json&)> handler, const std::string& mmp_group = "");
     void get_orderbook(const std::string& instrument, int depth = 10);
+    void get_orderbook(const std::string& instrument, int depth, std::function<void(const json&)> handler);
     void get_positions(const std::string& currency = "", const std::string& kind = "");
+    void get_positions(const std::string& currency, const std::string& kind, std::function<void(const json&)> handler);
+    void get_instruments(const std::string& currency, const std::string& kind, std::function<void(const json&)> handler);
 
     void register_message_handler(const std::string& channel, MessageHandler handler);
 
+    // Routes notifications of subscribed book/ticker/trades/user channels to
+    // the sink's on_channel overloads, decoded into typed structs
+    template <typename Sink>
+    void set_channel_sink(Sink& sink) {
+        dispatcher_ = std::make_unique<TypedChannelDispatcher<Sink>>(sink);
+    }
+
 private:
     std::string client_id_;
     std::string client_secret_;
     std::string access_token_;
+    InstrumentRegistry& instruments_;
 
     std::unique_ptr<WebsocketClient> client_;
     websocketpp::connection_hdl connection_;
 
-    std::map<std::string, MessageHandler> message_handlers_;
-    std::map<int, std::function<void(const json&)>> response_handlers_;
-    int request_id_ = 0;
+    std::unique_ptr<ChannelDispatcher> dispatcher_;
+    // Channel name -> dense ID, route and json handler; rebuilt on subscription changes
+    ChannelRouter router_;
+    // The ASIO thread only timestamps frames and pushes them here; parsing,
+    // routing and handlers run on processing_thread_
+    struct InboundFrame {
+        WebsocketClient::message_ptr message;
+        int64_t receive_ns = 0;
+        // Locally generated responses (e.g. requests shed by the rate limiter)
+        std::string synthetic_payload;
+    };
+    PipelineConfig pipeline_config_;
+    EventLoopConfig event_loop_config_;
+    std::atomic<EventLoopMode> event_loop_mode_{ EventLoopMode::Blocking };
+    std::thread io_thread_;
+    std::atomic<bool> io_running_{ false };
+    std::unique_ptr<SpscRing<InboundFrame>> inbound_;
+    std::thread processing_thread_;
+    std::atomic<bool> processing_running_{ false };
+    std::atomic<bool> processor_sleeping_{ false };
+    std::mutex processor_mutex_;
+    std::condition_variable processor_cv_;
+    std::atomic<uint64_t> frames_received_{ 0 };
+    std::atomic<uint64_t> frames_processed_{ 0 };
+    std::atomic<uint64_t> frames_dropped_{ 0 };
+    std::atomic<size_t> ring_high_water_{ 0 };
+    // Tasks from post(), drained by processing_thread_
+    std::mutex posted_mutex_;
+    std::vector<std::function<void()>> posted_;
+    std::atomic<bool> has_posted_{ false };
+
+    // Response handlers keyed by JSON-RPC id; filled from any thread,
+    // completed and timed out on processing_thread_
+    PendingRequestTable pending_;
+    // Every outbound frame goes through here and is written by the I/O
+    // thread, cancels first, then orders, then everything else
+    OutboundQueue outbound_;
+    std::atomic<bool> drain_scheduled_{ false };
+    // Applied while draining outbound_; I/O thread only
+    RateLimiter rate_limiter_;
+    bool retry_timer_armed_ = false;
+    RiskGate* risk_gate_ = nullptr;
     using TlsInitHandler = websocketpp::lib::function<std::shared_ptr<boost::asio::ssl::context>(websocketpp::connection_hdl)>;
 
     void on_open(websocketpp::connection_hdl hdl);
     void on_message(websocketpp::connection_hdl hdl, WebsocketClient::message_ptr msg);
+    void push_inbound(InboundFrame&& frame);
+    void io_loop();
+    void stop_io();
+    void start_processing();
+    void stop_processing();
+    void run_posted();
+    void processing_loop();
+    void process_frame(const InboundFrame& frame);
+    bool dispatch_fast(const std::string& payload, int64_t receive_ns);
     void on_close(websocketpp::connection_hdl hdl);
     void on_fail(websocketpp::connection_hdl hdl);
 
     void send_request(const std::string& method, const json& params,
-        std::function<void(const json&)> handler = nullptr);
+        std::function<void(const json&)> handler = nullptr,
+        int64_t timeout_ns = PendingRequestTable::kDefaultTimeoutNs);
+    // Sends a frame prepared by an OrderEncoder, patching in the request ID
+    void send_encoded(OrderEncoder& encoder, std::function<void(const json&)> handler,
+        int64_t timeout_ns = PendingRequestTable::kDefaultTimeoutNs, std::string_view merge_key = std::string_view());
+    void schedule_drain();
+    void drain_outbound();
+    // I/O thread: completes a request that will never reach Deribit
+    void fail_request(int64_t request_id, const char* reason);
+    // Any thread: completes a request that could not be queued with a
+    // PendingRequestTable::kRequestNotSent error. request_id is 0 when it
+    // never got a slot; handler is used then.
+    void reject_unsent(int64_t request_id, std::function<void(const json&)> handler, const char* method,
+        const char* reason);
 
     std::string generate_nonce() const;
 };
\ No newline at end of file
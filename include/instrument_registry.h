@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+using InstrumentId = uint32_t;
+constexpr InstrumentId kInvalidInstrument = UINT32_MAX;
+
+enum class InstrumentKind {
+    Future,
+    Option,
+    Spot,
+    FutureCombo,
+    OptionCombo,
+    Unknown
+};
+
+struct InstrumentInfo {
+    std::string name;
+    InstrumentKind kind = InstrumentKind::Unknown;
+    std::string base_currency;
+    std::string settlement_currency;
+    double tick_size = 0;
+    double contract_size = 0;
+    double min_trade_amount = 0;
+    bool inverse = false;   // instrument_type "reversed": sized in USD, settled in coin
+    // Options only
+    double strike = 0;
+    int64_t expiration_timestamp = 0;
+    bool is_call = false;
+};
+
+// Assigns every instrument a dense ID so per-instrument state can live in
+// arrays. Readers index entries by ID without locking, and only the name
+// lookup takes the mutex. A published entry is never modified: new
+// metadata for a known instrument is published as a fresh entry, and the
+// old one stays valid for readers still holding it until the registry is
+// destroyed. Metadata is expected to be loaded from public/get_instruments
+// before the feed starts.
+class InstrumentRegistry {
+public:
+    static constexpr size_t kMaxInstruments = 16384;
+
+    InstrumentRegistry();
+
+    // Returns the existing ID or registers the name without metadata
+    InstrumentId intern(const std::string& name);
+    // Registers or refreshes metadata for info.name
+    InstrumentId add(const InstrumentInfo& info);
+    InstrumentId find(std::string_view name) const;
+
+    const InstrumentInfo& info(InstrumentId id) const { return *entries_[id].load(std::memory_order_acquire); }
+    const std::string& name(InstrumentId id) const { return info(id).name; }
+    size_t size() const { return count_.load(std::memory_order_acquire); }
+
+    // Loads the result array of public/get_instruments; returns the number of instruments
+    size_t load_instruments(const json& result);
+
+private:
+    // Unregistered IDs point at an empty entry
+    static const InstrumentInfo kNoInstrument;
+
+    std::unique_ptr<std::atomic<const InstrumentInfo*>[]> entries_;
+    std::atomic<size_t> count_{ 0 };
+
+    mutable std::mutex names_mutex_;
+    // Every entry ever published, current or replaced
+    std::vector<std::unique_ptr<const InstrumentInfo>> storage_;
+    // Keys view the names of the first entries, which are never freed
+    std::unordered_map<std::string_view, InstrumentId> ids_by_name_;
+
+    InstrumentId insert(const InstrumentInfo& info);
+};
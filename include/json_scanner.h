@@ -0,0 +1,193 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// Forward-only JSON reader over a frame that is already in memory.
+// Strings come back as views into the frame (escape sequences are not
+// decoded) and numbers are read with std::from_chars, so scanning never
+// allocates. Every method returns false on malformed input.
+class JsonScanner {
+public:
+    explicit JsonScanner(std::string_view text)
+        : pos_(text.data()), end_(text.data() + text.size()) {}
+
+    bool at_end() {
+        skip_ws();
+        return pos_ == end_;
+    }
+
+    char peek() {
+        skip_ws();
+        return pos_ < end_ ? *pos_ : '\0';
+    }
+
+    bool consume(char c) {
+        skip_ws();
+        if (pos_ < end_ && *pos_ == c) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    bool read_string(std::string_view& out) {
+        if (!consume('"')) {
+            return false;
+        }
+        const char* start = pos_;
+        while (pos_ < end_ && *pos_ != '"') {
+            if (*pos_ == '\\' && ++pos_ == end_) {
+                return false;
+            }
+            ++pos_;
+        }
+        if (pos_ == end_) {
+            return false;
+        }
+        out = std::string_view(start, static_cast<size_t>(pos_ - start));
+        ++pos_;
+        return true;
+    }
+
+    template <typename T>
+    bool read_number(T& out) {
+        skip_ws();
+        auto result = std::from_chars(pos_, end_, out);
+        if (result.ec != std::errc()) {
+            return false;
+        }
+        pos_ = result.ptr;
+        return true;
+    }
+
+    bool read_bool(bool& out) {
+        skip_ws();
+        if (match_literal("true")) {
+            out = true;
+            return true;
+        }
+        if (match_literal("false")) {
+            out = false;
+            return true;
+        }
+        return false;
+    }
+
+    // Skips one value and returns its raw text
+    bool read_raw(std::string_view& out) {
+        skip_ws();
+        const char* start = pos_;
+        if (!skip_value()) {
+            return false;
+        }
+        out = std::string_view(start, static_cast<size_t>(pos_ - start));
+        return true;
+    }
+
+    bool skip_value() {
+        skip_ws();
+        if (pos_ == end_) {
+            return false;
+        }
+        switch (*pos_) {
+        case '"': {
+            std::string_view ignored;
+            return read_string(ignored);
+        }
+        case '{':
+        case '[': {
+            int nesting = 0;
+            while (pos_ < end_) {
+                char c = *pos_;
+                if (c == '"') {
+                    std::string_view ignored;
+                    if (!read_string(ignored)) {
+                        return false;
+                    }
+                    continue;
+                }
+                ++pos_;
+                if (c == '{' || c == '[') {
+                    ++nesting;
+                }
+                else if ((c == '}' || c == ']') && --nesting == 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        case 't':
+            return match_literal("true");
+        case 'f':
+            return match_literal("false");
+        case 'n':
+            return match_literal("null");
+        default: {
+            double ignored;
+            return read_number(ignored);
+        }
+        }
+    }
+
+    bool is_null() {
+        skip_ws();
+        return match_literal("null");
+    }
+
+    // Calls f(key, scanner) for every member; f must consume the value.
+    template <typename F>
+    bool for_each_member(F&& f) {
+        if (!consume('{')) {
+            return false;
+        }
+        if (consume('}')) {
+            return true;
+        }
+        do {
+            std::string_view key;
+            if (!read_string(key) || !consume(':') || !f(key, *this)) {
+                return false;
+            }
+        } while (consume(','));
+        return consume('}');
+    }
+
+    // Calls f(scanner) for every element; f must consume the element.
+    template <typename F>
+    bool for_each_element(F&& f) {
+        if (!consume('[')) {
+            return false;
+        }
+        if (consume(']')) {
+            return true;
+        }
+        do {
+            if (!f(*this)) {
+                return false;
+            }
+        } while (consume(','));
+        return consume(']');
+    }
+
+private:
+    const char* pos_;
+    const char* end_;
+
+    void skip_ws() {
+        while (pos_ < end_ && (*pos_ == ' ' || *pos_ == '\n' || *pos_ == '\r' || *pos_ == '\t')) {
+            ++pos_;
+        }
+    }
+
+    bool match_literal(const char* literal) {
+        size_t length = std::strlen(literal);
+        if (static_cast<size_t>(end_ - pos_) < length || std::memcmp(pos_, literal, length) != 0) {
+            return false;
+        }
+        pos_ += length;
+        return true;
+    }
+};
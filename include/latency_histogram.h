@@ -0,0 +1,100 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Log-linear latency histogram: each power of two is split into four
+// sub-buckets (about 25% resolution). record() is a couple of relaxed
+// atomic increments, so any thread can record without locking.
+class LatencyHistogram {
+public:
+    static constexpr size_t kSubBuckets = 4;
+    static constexpr size_t kBuckets = 64 * kSubBuckets;
+
+    struct Summary {
+        uint64_t count = 0;
+        int64_t p50_ns = 0;
+        int64_t p99_ns = 0;
+        int64_t p999_ns = 0;
+        int64_t max_ns = 0;
+    };
+
+    void record(int64_t ns) {
+        if (ns < 0) {
+            ns = 0;
+        }
+        buckets_[bucket_for(static_cast<uint64_t>(ns))].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        int64_t max = max_ns_.load(std::memory_order_relaxed);
+        while (ns > max && !max_ns_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+    // Upper bound of the bucket holding the given quantile (0..1)
+    int64_t percentile(double quantile) const {
+        uint64_t total = count();
+        if (total == 0) {
+            return 0;
+        }
+        uint64_t target = static_cast<uint64_t>(quantile * static_cast<double>(total));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBuckets; ++i) {
+            seen += buckets_[i].load(std::memory_order_relaxed);
+            if (seen > target) {
+                return std::min(bucket_upper_bound(i), max_ns_.load(std::memory_order_relaxed));
+            }
+        }
+        return max_ns_.load(std::memory_order_relaxed);
+    }
+
+    Summary summary() const {
+        Summary result;
+        result.count = count();
+        result.p50_ns = percentile(0.50);
+        result.p99_ns = percentile(0.99);
+        result.p999_ns = percentile(0.999);
+        result.max_ns = max_ns_.load(std::memory_order_relaxed);
+        return result;
+    }
+
+    void reset() {
+        for (auto& bucket : buckets_) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        count_.store(0, std::memory_order_relaxed);
+        max_ns_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> buckets_[kBuckets] = {};
+    std::atomic<uint64_t> count_{ 0 };
+    std::atomic<int64_t> max_ns_{ 0 };
+
+    static size_t bucket_for(uint64_t ns) {
+        if (ns < kSubBuckets) {
+            return static_cast<size_t>(ns);
+        }
+        size_t msb = 63;
+        while (!(ns >> msb)) {
+            --msb;
+        }
+        size_t sub = static_cast<size_t>((ns >> (msb - 2)) & (kSubBuckets - 1));
+        return std::min((msb - 1) * kSubBuckets + sub, kBuckets - 1);
+    }
+
+    static int64_t bucket_upper_bound(size_t bucket) {
+        if (bucket < kSubBuckets) {
+            return static_cast<int64_t>(bucket);
+        }
+        size_t msb = bucket / kSubBuckets + 1;
+        uint64_t sub = bucket % kSubBuckets;
+        if (msb >= 62) {
+            return INT64_MAX;
+        }
+        return static_cast<int64_t>(((kSubBuckets + sub + 1) << (msb - 2)) - 1);
+    }
+};
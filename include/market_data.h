@@ -1,10 +1,14 @@
 #pragma once
 
 #include <string>
-#include <map>
+#include <memory>
 #include <vector>
 #include <mutex>
+#include <atomic>
 #include <nlohmann/json.hpp>
+#include "instrument_registry.h"
+#include "price_ladder.h"
+#include "seqlock.h"
 
 using json = nlohmann::json;
 
@@ -16,24 +20,171 @@ struct OrderBookEntry {
 struct OrderBook {
     std::vector<OrderBookEntry> bids;
     std::vector<OrderBookEntry> asks;
+    int64_t timestamp = 0;
+    int64_t change_id = 0;
+    bool valid = false;   // set by get_orderbook: false until synced and while resyncing
+};
+
+enum class BookAction {
+    New,
+    Change,
+    Delete
+};
+
+struct BookLevelUpdate {
+    BookAction action;
+    double price;
+    double amount;
+};
+
+// One notification of the book.<instrument>.raw channel, or a
+// public/get_order_book snapshot (is_snapshot = true, all levels New).
+struct BookUpdate {
+    bool is_snapshot = false;
+    int64_t change_id = 0;
+    int64_t prev_change_id = 0;
+    int64_t timestamp = 0;
+    std::vector<BookLevelUpdate> bids;
+    std::vector<BookLevelUpdate> asks;
+};
+
+enum class BookUpdateResult {
+    Applied,
+    Buffered,     // resync in progress, delta kept for replay
+    GapDetected,  // caller must fetch a snapshot and pass it to apply_book_snapshot
+    Stale
+};
+
+struct TopOfBook {
+    double bid_price = 0;
+    double bid_amount = 0;
+    double ask_price = 0;
+    double ask_amount = 0;
+    int64_t timestamp = 0;
+    int64_t change_id = 0;
+};
+
+// Which derived metrics MarketData keeps for a book
+struct AnalyticsConfig {
+    uint32_t imbalance_levels = 5;
+    double vwap_size = 0;   // 0 leaves bid_vwap/ask_vwap at 0
+};
+
+// Metrics derived from the published levels on every update; 0 where a
+// side is empty
+struct BookAnalytics {
+    double mid;
+    double spread;
+    double microprice;   // top-level prices weighted by the opposite side's amount
+    double imbalance;    // (bid - ask) / (bid + ask) amount over the top imbalance_levels
+    double bid_vwap;     // average price of selling vwap_size into the bids; 0 if the levels run out
+    double ask_vwap;     // average price of buying vwap_size from the asks
+    double vwap_size;
+    uint32_t imbalance_levels;
+};
+
+// Top levels of one book as published to readers, structure-of-arrays
+struct BookSnapshot {
+    static constexpr size_t kMaxDepth = 32;
+
     int64_t timestamp;
+    int64_t change_id;
+    uint32_t bid_count;
+    uint32_t ask_count;
+    bool valid;   // false until synced and while resyncing
+    double bid_prices[kMaxDepth];
+    double bid_amounts[kMaxDepth];
+    double ask_prices[kMaxDepth];
+    double ask_amounts[kMaxDepth];
+    // Cumulative amount and price * amount from the top through each level
+    double bid_depth[kMaxDepth];
+    double bid_notional[kMaxDepth];
+    double ask_depth[kMaxDepth];
+    double ask_notional[kMaxDepth];
+    BookAnalytics analytics;
 };
 
+// Books are mutated by a single feed thread (apply_*, update_orderbook,
+// set_tick_size). After every change the top BookSnapshot::kMaxDepth
+// levels are published through a per-instrument seqlock, together with
+// cumulative depth and the BookAnalytics computed from them, so readers on
+// any thread never take a lock and never block the feed.
 class MarketData {
 public:
-    MarketData();
+    explicit MarketData(const InstrumentRegistry& registry);
+    ~MarketData();
+
+    void update_orderbook(InstrumentId instrument, const OrderBook& orderbook);
 
-    void update_orderbook(const std::string& instrument, const OrderBook& orderbook);
-    OrderBook get_orderbook(const std::string& instrument) const;
+    // Wait-free readers; return at most BookSnapshot::kMaxDepth levels
+    OrderBook get_orderbook(InstrumentId instrument, size_t depth = BookSnapshot::kMaxDepth) const;
+    bool get_top_of_book(InstrumentId instrument, TopOfBook& top) const;
+    bool get_analytics(InstrumentId instrument, BookAnalytics& analytics) const;
+    // Average price of taking size from one side of the published levels;
+    // 0 if they do not hold that much
+    double get_vwap(InstrumentId instrument, BookSide side, double size) const;
+    bool is_resyncing(InstrumentId instrument) const;
 
-    void subscribe_instrument(const std::string& instrument);
-    void unsubscribe_instrument(const std::string& instrument);
-    std::vector<std::string> get_subscribed_instruments() const;
+    // Prices are stored as integer ticks. Books take the registry tick size
+    // when first touched; this overrides it.
+    void set_tick_size(InstrumentId instrument, double tick_size);
+    // Feed thread, like set_tick_size; takes effect from the next update
+    void set_analytics_config(InstrumentId instrument, const AnalyticsConfig& config);
+
+    // Applies a raw channel notification in place. Detects sequence gaps
+    // from prev_change_id and buffers deltas until a snapshot arrives.
+    BookUpdateResult apply_book_update(InstrumentId instrument, const BookUpdate& update);
+    // Loads a REST snapshot and replays the deltas buffered since the gap.
+    BookUpdateResult apply_book_snapshot(InstrumentId instrument, const BookUpdate& snapshot);
+
+    // Feed thread: the top depth levels of a synced book, at any depth, as
+    // a snapshot update tagged with the book's change_id. The next delta
+    // applied has prev_change_id == snapshot.change_id.
+    bool snapshot_book(InstrumentId instrument, size_t depth, BookUpdate& snapshot) const;
+    // Feed thread: forgets a book whose channel is no longer subscribed, so
+    // it is not served stale; the next snapshot syncs it again
+    void reset_book(InstrumentId instrument);
+
+    void subscribe_instrument(InstrumentId instrument);
+    void unsubscribe_instrument(InstrumentId instrument);
+    std::vector<InstrumentId> get_subscribed_instruments() const;
 
 private:
-    mutable std::mutex orderbooks_mutex_;
-    std::map<std::string, OrderBook> orderbooks_;
+    static constexpr size_t kMaxBufferedUpdates = 4096;
+    static constexpr double kDefaultTickSize = 0.0001;
+
+    struct BookState {
+        explicit BookState(double tick_size) { bids.set_tick_size(tick_size); asks.set_tick_size(tick_size); }
+
+        // Feed thread only
+        PriceLadder bids{ BookSide::Bid };
+        PriceLadder asks{ BookSide::Ask };
+        int64_t change_id = 0;
+        int64_t timestamp = 0;
+        bool synced = false;
+        bool resyncing = false;
+        std::vector<BookUpdate> pending;
+        AnalyticsConfig analytics_config;
+        BookSnapshot scratch{};
+
+        SeqLock<BookSnapshot> published;
+    };
+
+    const InstrumentRegistry& registry_;
+
+    // Indexed by InstrumentId; a slot is filled once, on the first update
+    std::unique_ptr<std::atomic<BookState*>[]> orderbooks_;
 
     mutable std::mutex subscriptions_mutex_;
-    std::vector<std::string> subscribed_instruments_;
-};
\ No newline at end of file
+    std::vector<InstrumentId> subscribed_instruments_;
+
+    const BookState* find_book(InstrumentId instrument) const;
+    BookState* book_for(InstrumentId instrument);
+
+    static void apply_levels(BookState& book, const BookUpdate& update);
+    static void load_snapshot(BookState& book, const BookUpdate& snapshot);
+    static BookUpdateResult replay_pending(BookState& book);
+    static void start_resync(BookState& book, const BookUpdate& update);
+    static void publish(BookState& book);
+    static void compute_analytics(const AnalyticsConfig& config, BookSnapshot& snapshot);
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include "market_data.h"
+#include "channel_messages.h"
+
+// Top-level fields of a Deribit frame, read without building a DOM. All
+// views point into the frame and are only valid while it is alive.
+struct NotificationEnvelope {
+    bool has_id = false;
+    int64_t id = 0;
+    std::string_view channel;  // params.channel of subscription notifications
+    std::string_view data;     // raw params.data
+};
+
+bool decode_envelope(std::string_view frame, NotificationEnvelope& envelope);
+
+// Decodes book.<instrument>.raw data into `update`, reusing its level
+// vectors so steady-state decoding does not allocate.
+bool decode_book_data(std::string_view data, BookUpdate& update);
+
+bool decode_ticker_data(std::string_view data, TickerUpdate& update);
+bool decode_trades_data(std::string_view data, TradesUpdate& update);
+bool decode_user_orders_data(std::string_view data, OrdersUpdate& update);
+bool decode_user_trades_data(std::string_view data, UserTradesUpdate& update);
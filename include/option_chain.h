@@ -0,0 +1,169 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "channel_messages.h"
+#include "instrument_registry.h"
+#include "latency_histogram.h"
+#include "position_engine.h"
+#include "seqlock.h"
+#include "spsc_ring.h"
+
+// One option's latest solve. Prices and greeks are in USD per contract;
+// vega is per vol point and theta per calendar day.
+struct OptionGreeks {
+    double price;             // mark price converted to USD
+    double underlying_price;  // the forward Deribit prices the option against
+    double iv;
+    double delta;
+    double gamma;
+    double vega;
+    double theta;
+    int64_t timestamp;        // exchange ms of the ticker behind it
+    bool valid;               // false until solved, and when the price has too little time value;
+                              // the greeks are then the zero-vol limit (delta +-1 in the money)
+};
+
+// Sum of position size * greek over our open options on one underlying
+struct PortfolioGreeks {
+    double delta;
+    double gamma;
+    double vega;
+    double theta;
+    uint32_t positions;
+    uint32_t unsolved;        // positions counted at their zero-vol limit: no valid solve yet or any more
+    int64_t timestamp;        // exchange ms of the newest ticker in the batch
+};
+
+struct OptionChainConfig {
+    int batch_interval_ms = 100;
+    size_t worker_threads = 2;       // in addition to the batching thread
+    size_t quote_capacity = 65536;   // tickers buffered between batches
+};
+
+struct OptionChainStats {
+    uint64_t batches = 0;
+    uint64_t options_solved = 0;
+    uint64_t quotes_dropped = 0;
+    LatencyHistogram::Summary batch_latency;
+};
+
+// Implied volatility and greeks for every listed option. Option tickers
+// are queued from the processing thread and conflated per option; once per
+// batch interval the options that ticked are solved in chunks spread over
+// a worker pool, using the SIMD kernels in option_kernels.h on
+// structure-of-arrays data ordered by underlying, expiry and strike.
+// Portfolio greeks for our option positions are recomputed after every
+// batch. Results are published through seqlocks and read without locks.
+class OptionChainEngine {
+public:
+    static constexpr size_t kChunkSize = 256;
+
+    OptionChainEngine(const InstrumentRegistry& registry, const PositionEngine& positions,
+        const OptionChainConfig& config = OptionChainConfig());
+    ~OptionChainEngine();
+
+    // Lays out the unexpired options in the registry; call before start().
+    // The layout is fixed from then on. Returns the number of options.
+    size_t build();
+    void start();
+    void stop();
+
+    // Processing thread
+    void on_ticker(InstrumentId instrument, const TickerUpdate& ticker);
+
+    // Lock-free readers
+    bool get_greeks(InstrumentId instrument, OptionGreeks& greeks) const;
+    size_t chain_count() const { return chains_.size(); }
+    const std::string& chain_currency(size_t chain) const { return chains_[chain].currency; }
+    bool get_portfolio_greeks(size_t chain, PortfolioGreeks& greeks) const;
+    // Options on one underlying currency, ordered by expiry and strike
+    std::vector<InstrumentId> chain_instruments(std::string_view currency) const;
+    OptionChainStats stats() const;
+
+private:
+    static constexpr uint32_t kNoSlot = UINT32_MAX;
+
+    struct OptionQuote {
+        uint32_t slot = kNoSlot;
+        double mark_price = 0;
+        double underlying_price = 0;
+        double mark_iv = 0;
+        int64_t timestamp = 0;
+    };
+
+    struct Expiry {
+        int64_t expiration_ms;
+        uint32_t first_slot;
+        uint32_t count;
+    };
+
+    struct Chain {
+        std::string currency;
+        std::vector<Expiry> expiries;
+    };
+
+    const InstrumentRegistry& registry_;
+    const PositionEngine& positions_;
+    OptionChainConfig config_;
+
+    std::vector<Chain> chains_;
+    std::unique_ptr<uint32_t[]> slot_of_;   // InstrumentId -> slot
+
+    // Per slot, in chain/expiry/strike order. Static after build():
+    std::vector<InstrumentId> instruments_;
+    std::vector<uint32_t> chain_of_;
+    std::vector<int64_t> expiration_ms_;
+    std::vector<double> strikes_;
+    std::vector<double> signs_;             // +1 call, -1 put
+    std::vector<uint8_t> coin_quoted_;      // premium quoted in the underlying coin
+    // Latest inputs and results; batching thread, and workers for their own chunk
+    std::vector<double> mark_prices_;
+    std::vector<double> underlying_prices_;
+    std::vector<int64_t> timestamps_;
+    std::vector<double> vols_;
+    std::vector<OptionGreeks> results_;
+    std::vector<uint8_t> dirty_;
+    std::vector<uint32_t> dirty_slots_;
+    std::unique_ptr<SeqLock<OptionGreeks>[]> published_;
+    std::unique_ptr<SeqLock<PortfolioGreeks>[]> portfolio_;
+
+    std::unique_ptr<SpscRing<OptionQuote>> quotes_;
+    std::atomic<uint64_t> quotes_dropped_{ 0 };
+
+    std::thread batch_thread_;
+    std::atomic<bool> running_{ false };
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_cv_;
+
+    // Worker pool: each batch bumps the generation; workers and the batching
+    // thread claim chunks until none are left
+    std::vector<std::thread> workers_;
+    std::mutex pool_mutex_;
+    std::condition_variable pool_cv_;
+    std::condition_variable done_cv_;
+    uint64_t generation_ = 0;
+    size_t workers_done_ = 0;
+    bool pool_stopping_ = false;
+    std::atomic<size_t> next_chunk_{ 0 };
+    size_t chunk_count_ = 0;
+    int64_t batch_now_ms_ = 0;
+
+    std::atomic<uint64_t> batches_{ 0 };
+    std::atomic<uint64_t> options_solved_{ 0 };
+    LatencyHistogram batch_latency_;
+
+    void batch_loop();
+    void worker_loop();
+    void run_batch();
+    void solve_chunk(size_t chunk);
+    void update_portfolio();
+};
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// Black-76 pricing, implied volatility and greeks over structure-of-arrays
+// batches. The math is written once against VecD, a thin wrapper over the
+// widest double vector the build enables (AVX2: 4 lanes, SSE2: 2, scalar
+// otherwise), with branch-free exp/log/normal CDF so every lane follows the
+// same instruction stream.
+
+#if defined(__AVX2__)
+
+struct VecD {
+    static constexpr size_t kWidth = 4;
+    __m256d v;
+};
+
+inline VecD vec_set(double x) { return { _mm256_set1_pd(x) }; }
+inline VecD vec_load(const double* p) { return { _mm256_loadu_pd(p) }; }
+inline void vec_store(double* p, VecD a) { _mm256_storeu_pd(p, a.v); }
+inline VecD operator+(VecD a, VecD b) { return { _mm256_add_pd(a.v, b.v) }; }
+inline VecD operator-(VecD a, VecD b) { return { _mm256_sub_pd(a.v, b.v) }; }
+inline VecD operator*(VecD a, VecD b) { return { _mm256_mul_pd(a.v, b.v) }; }
+inline VecD operator/(VecD a, VecD b) { return { _mm256_div_pd(a.v, b.v) }; }
+inline VecD vec_sqrt(VecD a) { return { _mm256_sqrt_pd(a.v) }; }
+inline VecD vec_min(VecD a, VecD b) { return { _mm256_min_pd(a.v, b.v) }; }
+inline VecD vec_max(VecD a, VecD b) { return { _mm256_max_pd(a.v, b.v) }; }
+// Masks are all-ones/all-zero lanes
+inline VecD vec_gt(VecD a, VecD b) { return { _mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ) }; }
+inline VecD vec_lt(VecD a, VecD b) { return { _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ) }; }
+inline VecD vec_and(VecD a, VecD b) { return { _mm256_and_pd(a.v, b.v) }; }
+inline VecD vec_select(VecD mask, VecD a, VecD b) { return { _mm256_blendv_pd(b.v, a.v, mask.v) }; }
+inline VecD vec_abs(VecD a) { return { _mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v) }; }
+// Integer add and shifts on the raw 64-bit lanes
+inline VecD vec_add_bits(VecD a, int64_t b) {
+    return { _mm256_castsi256_pd(_mm256_add_epi64(_mm256_castpd_si256(a.v), _mm256_set1_epi64x(b))) };
+}
+inline VecD vec_shl_bits(VecD a, int n) { return { _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_castpd_si256(a.v), n)) }; }
+inline VecD vec_shr_bits(VecD a, int n) { return { _mm256_castsi256_pd(_mm256_srli_epi64(_mm256_castpd_si256(a.v), n)) }; }
+inline VecD vec_and_bits(VecD a, int64_t b) {
+    return { _mm256_castsi256_pd(_mm256_and_si256(_mm256_castpd_si256(a.v), _mm256_set1_epi64x(b))) };
+}
+inline VecD vec_or_bits(VecD a, int64_t b) {
+    return { _mm256_castsi256_pd(_mm256_or_si256(_mm256_castpd_si256(a.v), _mm256_set1_epi64x(b))) };
+}
+
+#elif defined(__SSE2__) || defined(_M_X64)
+
+struct VecD {
+    static constexpr size_t kWidth = 2;
+    __m128d v;
+};
+
+inline VecD vec_set(double x) { return { _mm_set1_pd(x) }; }
+inline VecD vec_load(const double* p) { return { _mm_loadu_pd(p) }; }
+inline void vec_store(double* p, VecD a) { _mm_storeu_pd(p, a.v); }
+inline VecD operator+(VecD a, VecD b) { return { _mm_add_pd(a.v, b.v) }; }
+inline VecD operator-(VecD a, VecD b) { return { _mm_sub_pd(a.v, b.v) }; }
+inline VecD operator*(VecD a, VecD b) { return { _mm_mul_pd(a.v, b.v) }; }
+inline VecD operator/(VecD a, VecD b) { return { _mm_div_pd(a.v, b.v) }; }
+inline VecD vec_sqrt(VecD a) { return { _mm_sqrt_pd(a.v) }; }
+inline VecD vec_min(VecD a, VecD b) { return { _mm_min_pd(a.v, b.v) }; }
+inline VecD vec_max(VecD a, VecD b) { return { _mm_max_pd(a.v, b.v) }; }
+inline VecD vec_gt(VecD a, VecD b) { return { _mm_cmpgt_pd(a.v, b.v) }; }
+inline VecD vec_lt(VecD a, VecD b) { return { _mm_cmplt_pd(a.v, b.v) }; }
+inline VecD vec_and(VecD a, VecD b) { return { _mm_and_pd(a.v, b.v) }; }
+inline VecD vec_select(VecD mask, VecD a, VecD b) {
+    return { _mm_or_pd(_mm_and_pd(mask.v, a.v), _mm_andnot_pd(mask.v, b.v)) };
+}
+inline VecD vec_abs(VecD a) { return { _mm_andnot_pd(_mm_set1_pd(-0.0), a.v) }; }
+inline VecD vec_add_bits(VecD a, int64_t b) {
+    return { _mm_castsi128_pd(_mm_add_epi64(_mm_castpd_si128(a.v), _mm_set1_epi64x(b))) };
+}
+inline VecD vec_shl_bits(VecD a, int n) { return { _mm_castsi128_pd(_mm_slli_epi64(_mm_castpd_si128(a.v), n)) }; }
+inline VecD vec_shr_bits(VecD a, int n) { return { _mm_castsi128_pd(_mm_srli_epi64(_mm_castpd_si128(a.v), n)) }; }
+inline VecD vec_and_bits(VecD a, int64_t b) {
+    return { _mm_castsi128_pd(_mm_and_si128(_mm_castpd_si128(a.v), _mm_set1_epi64x(b))) };
+}
+inline VecD vec_or_bits(VecD a, int64_t b) {
+    return { _mm_castsi128_pd(_mm_or_si128(_mm_castpd_si128(a.v), _mm_set1_epi64x(b))) };
+}
+
+#else
+
+struct VecD {
+    static constexpr size_t kWidth = 1;
+    double v;
+};
+
+inline uint64_t vec_bits(double x) { uint64_t b; std::memcpy(&b, &x, sizeof(b)); return b; }
+inline double vec_from_bits(uint64_t b) { double x; std::memcpy(&x, &b, sizeof(x)); return x; }
+inline double vec_mask(bool b) { return vec_from_bits(b ? ~uint64_t(0) : 0); }
+
+inline VecD vec_set(double x) { return { x }; }
+inline VecD vec_load(const double* p) { return { *p }; }
+inline void vec_store(double* p, VecD a) { *p = a.v; }
+inline VecD operator+(VecD a, VecD b) { return { a.v + b.v }; }
+inline VecD operator-(VecD a, VecD b) { return { a.v - b.v }; }
+inline VecD operator*(VecD a, VecD b) { return { a.v * b.v }; }
+inline VecD operator/(VecD a, VecD b) { return { a.v / b.v }; }
+inline VecD vec_sqrt(VecD a) { return { std::sqrt(a.v) }; }
+inline VecD vec_min(VecD a, VecD b) { return { a.v < b.v ? a.v : b.v }; }
+inline VecD vec_max(VecD a, VecD b) { return { a.v > b.v ? a.v : b.v }; }
+inline VecD vec_gt(VecD a, VecD b) { return { vec_mask(a.v > b.v) }; }
+inline VecD vec_lt(VecD a, VecD b) { return { vec_mask(a.v < b.v) }; }
+inline VecD vec_and(VecD a, VecD b) { return { vec_from_bits(vec_bits(a.v) & vec_bits(b.v)) }; }
+inline VecD vec_select(VecD mask, VecD a, VecD b) { return vec_bits(mask.v) ? a : b; }
+inline VecD vec_abs(VecD a) { return { a.v < 0 ? -a.v : a.v }; }
+inline VecD vec_add_bits(VecD a, int64_t b) { return { vec_from_bits(vec_bits(a.v) + static_cast<uint64_t>(b)) }; }
+inline VecD vec_shl_bits(VecD a, int n) { return { vec_from_bits(vec_bits(a.v) << n) }; }
+inline VecD vec_shr_bits(VecD a, int n) { return { vec_from_bits(vec_bits(a.v) >> n) }; }
+inline VecD vec_and_bits(VecD a, int64_t b) { return { vec_from_bits(vec_bits(a.v) & static_cast<uint64_t>(b)) }; }
+inline VecD vec_or_bits(VecD a, int64_t b) { return { vec_from_bits(vec_bits(a.v) | static_cast<uint64_t>(b)) }; }
+
+#endif
+
+// e^x, relative error about 1e-15 for |x| < 708
+inline VecD vec_exp(VecD x) {
+    const double kMagic = 6755399441055744.0;   // 1.5 * 2^52: adding it rounds to an integer
+    x = vec_min(vec_max(x, vec_set(-708.0)), vec_set(708.0));
+    VecD shifted = x * vec_set(1.4426950408889634) + vec_set(kMagic);
+    VecD n = shifted - vec_set(kMagic);
+    VecD r = x - n * vec_set(0.6931471803691238) - n * vec_set(1.9082149292705877e-10);
+
+    // Taylor series of e^r for |r| <= ln(2)/2
+    VecD p = vec_set(1.0 / 39916800.0);
+    p = p * r + vec_set(1.0 / 3628800.0);
+    p = p * r + vec_set(1.0 / 362880.0);
+    p = p * r + vec_set(1.0 / 40320.0);
+    p = p * r + vec_set(1.0 / 5040.0);
+    p = p * r + vec_set(1.0 / 720.0);
+    p = p * r + vec_set(1.0 / 120.0);
+    p = p * r + vec_set(1.0 / 24.0);
+    p = p * r + vec_set(1.0 / 6.0);
+    p = p * r + vec_set(0.5);
+    p = p * r + vec_set(1.0);
+    p = p * r + vec_set(1.0);
+
+    // The low mantissa bits of shifted hold n; move n + 1023 into the exponent
+    VecD scale = vec_shl_bits(vec_add_bits(shifted, 1023), 52);
+    return p * scale;
+}
+
+// Natural log for positive normal x
+inline VecD vec_log(VecD x) {
+    const double kTwo52 = 4503599627370496.0;
+    // Exponent as a double: its bits under 2^52's exponent, minus 2^52
+    VecD exponent = vec_or_bits(vec_shr_bits(x, 52), 0x4330000000000000) - vec_set(kTwo52 + 1023.0);
+    VecD mantissa = vec_or_bits(vec_and_bits(x, 0x000FFFFFFFFFFFFF), 0x3FF0000000000000);
+
+    // Centre the mantissa on 1 so the series converges fast
+    VecD high = vec_gt(mantissa, vec_set(1.4142135623730951));
+    mantissa = vec_select(high, mantissa * vec_set(0.5), mantissa);
+    exponent = vec_select(high, exponent + vec_set(1.0), exponent);
+
+    // log(m) = 2 atanh(s), s = (m - 1) / (m + 1), |s| < 0.172
+    VecD s = (mantissa - vec_set(1.0)) / (mantissa + vec_set(1.0));
+    VecD s2 = s * s;
+    VecD p = vec_set(1.0 / 15.0);
+    p = p * s2 + vec_set(1.0 / 13.0);
+    p = p * s2 + vec_set(1.0 / 11.0);
+    p = p * s2 + vec_set(1.0 / 9.0);
+    p = p * s2 + vec_set(1.0 / 7.0);
+    p = p * s2 + vec_set(1.0 / 5.0);
+    p = p * s2 + vec_set(1.0 / 3.0);
+    p = p * s2 + vec_set(1.0);
+    return exponent * vec_set(0.6931471805599453) + vec_set(2.0) * s * p;
+}
+
+inline VecD vec_norm_pdf(VecD x) {
+    return vec_set(0.3989422804014327) * vec_exp(vec_set(-0.5) * x * x);
+}
+
+// Standard normal CDF (Abramowitz & Stegun 26.2.17, absolute error < 7.5e-8)
+inline VecD vec_norm_cdf(VecD x) {
+    VecD z = vec_abs(x);
+    VecD t = vec_set(1.0) / (vec_set(1.0) + vec_set(0.2316419) * z);
+    VecD poly = vec_set(1.330274429);
+    poly = poly * t + vec_set(-1.821255978);
+    poly = poly * t + vec_set(1.781477937);
+    poly = poly * t + vec_set(-0.356563782);
+    poly = poly * t + vec_set(0.319381530);
+    VecD upper = vec_norm_pdf(z) * poly * t;
+    return vec_select(vec_lt(x, vec_set(0.0)), upper, vec_set(1.0) - upper);
+}
+
+// One batch of options, all arrays of length count. Prices are in quote
+// currency (USD), rates are zero and forward is the option's underlying
+// price, as Deribit quotes it. sign is +1 for calls, -1 for puts.
+// vol_guess seeds Newton and receives the solved volatility.
+struct OptionBatch {
+    const double* forward;
+    const double* strike;
+    const double* years;
+    const double* price;
+    const double* sign;
+    double* vol;
+    double* delta;   // sign in the money and 0 out of it where not valid
+    double* gamma;   // 0 where not valid, as are vega and theta
+    double* vega;    // per vol point
+    double* theta;   // per calendar day
+    double* valid;   // 1 where the price carried enough time value and the solve converged
+    size_t count;
+};
+
+// count must be a multiple of VecD::kWidth; pad with any finite values
+inline void solve_option_batch(const OptionBatch& batch) {
+    const int kNewtonSteps = 8;
+    for (size_t i = 0; i < batch.count; i += VecD::kWidth) {
+        VecD forward = vec_load(batch.forward + i);
+        VecD strike = vec_load(batch.strike + i);
+        VecD years = vec_max(vec_load(batch.years + i), vec_set(1e-9));
+        VecD target = vec_load(batch.price + i);
+        VecD sign = vec_load(batch.sign + i);
+        VecD vol = vec_min(vec_max(vec_load(batch.vol + i), vec_set(0.05)), vec_set(5.0));
+
+        VecD root_years = vec_sqrt(years);
+        VecD log_moneyness = vec_log(forward / strike);
+        VecD d1 = vec_set(0.0);
+        VecD pdf = vec_set(0.0);
+        VecD model = vec_set(0.0);
+        for (int step = 0; step <= kNewtonSteps; ++step) {
+            VecD deviation = vol * root_years;
+            d1 = (log_moneyness + vec_set(0.5) * deviation * deviation) / deviation;
+            VecD d2 = d1 - deviation;
+            model = sign * (forward * vec_norm_cdf(sign * d1) - strike * vec_norm_cdf(sign * d2));
+            pdf = vec_norm_pdf(d1);
+            if (step == kNewtonSteps) {
+                break;
+            }
+            VecD vega = vec_max(forward * pdf * root_years, vec_set(1e-8));
+            vol = vec_min(vec_max(vol - (model - target) / vega, vec_set(0.01)), vec_set(5.0));
+        }
+
+        // Below the forward (calls) or strike (puts), and at least a tick
+        // (1e-4 of the underlying on Deribit) of time value: with less the
+        // price barely depends on volatility and the solve is meaningless
+        VecD intrinsic = vec_max(sign * (forward - strike), vec_set(0.0));
+        VecD ceiling = vec_select(vec_gt(sign, vec_set(0.0)), forward, strike);
+        VecD tolerance = vec_max(target * vec_set(1e-4), vec_set(1e-6) * forward);
+        VecD valid = vec_and(vec_and(vec_gt(target - intrinsic, vec_set(1e-4) * forward), vec_lt(target, ceiling)),
+            vec_and(vec_lt(vec_abs(model - target), tolerance), vec_gt(vec_load(batch.years + i), vec_set(0.0))));
+
+        // Where the solve is meaningless the option trades like its zero-vol
+        // limit: the underlying's delta in the money, nothing otherwise
+        VecD one = vec_set(1.0);
+        VecD zero = vec_set(0.0);
+        VecD limit_delta = vec_select(vec_gt(intrinsic, zero), sign, zero);
+        vec_store(batch.vol + i, vol);
+        vec_store(batch.delta + i, vec_select(valid, sign * vec_norm_cdf(sign * d1), limit_delta));
+        vec_store(batch.gamma + i, vec_select(valid, pdf / (forward * vol * root_years), zero));
+        vec_store(batch.vega + i, vec_select(valid, forward * pdf * root_years * vec_set(0.01), zero));
+        vec_store(batch.theta + i, vec_select(valid,
+            vec_set(-1.0 / 365.0) * forward * pdf * vol / (vec_set(2.0) * root_years), zero));
+        vec_store(batch.valid + i, vec_select(valid, one, zero));
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Writes order-entry JSON-RPC frames straight into a fixed buffer from
+// fixed method/field templates, without building a json DOM. The request
+// ID field is a fixed-width, space-padded slot patched in place once the ID
+// is known. Keep one encoder per thread; a frame stays valid until the next
+// encode call.
+class OrderEncoder {
+public:
+    static constexpr size_t kCapacity = 512;
+    static constexpr size_t kIdWidth = 20;
+
+    // Each returns false when a field would need JSON escaping, a number is
+    // not finite or the frame would not fit; callers then fall back to the
+    // json path
+    bool encode_order(std::string_view side, std::string_view instrument, double amount, double price,
+        std::string_view type, std::string_view label = std::string_view());
+    bool encode_cancel(std::string_view order_id);
+    bool encode_edit(std::string_view order_id, double amount, double price);
+
+    void set_id(int64_t id);
+
+    // The method of the last encoded frame, e.g. "private/buy"
+    const char* method() const { return method_; }
+    std::string_view frame() const { return std::string_view(buffer_, size_); }
+
+private:
+    char buffer_[kCapacity];
+    size_t size_ = 0;
+    size_t id_offset_ = 0;
+    bool failed_ = false;
+    const char* method_ = "";
+
+    void begin(const char* method);
+    bool finish();
+    void append(std::string_view text);
+    void append_string(std::string_view value);
+    void append_number(double value);
+};
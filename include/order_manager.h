@@ -1,38 +1,246 @@
 #pragma once
 
-#include <string>
-#include <map>
-#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
 #include <mutex>
+#include <string_view>
+#include <vector>
 #include <nlohmann/json.hpp>
+#include "channel_messages.h"
+#include "instrument_registry.h"
+#include "latency_histogram.h"
 
 using json = nlohmann::json;
 
+enum class OrderSide : uint8_t {
+    Buy,
+    Sell,
+    Unknown
+};
+
+enum class OrderType : uint8_t {
+    Limit,
+    Market,
+    StopLimit,
+    StopMarket,
+    TakeLimit,
+    TakeMarket,
+    MarketLimit,
+    TrailingStop,
+    Unknown
+};
+
+enum class OrderStatus : uint8_t {
+    Pending,      // sent, not yet acknowledged by the exchange
+    Open,
+    Untriggered,
+    Filled,
+    Cancelled,
+    Rejected,
+    Unknown
+};
+
+// Deribit's wire names (direction, order_type, order_state)
+OrderSide parse_order_side(std::string_view side);
+OrderType parse_order_type(std::string_view type);
+OrderStatus parse_order_status(std::string_view status);
+const char* to_string(OrderSide side);
+const char* to_string(OrderType type);
+const char* to_string(OrderStatus status);
+
+inline bool is_terminal(OrderStatus status) {
+    return status == OrderStatus::Filled || status == OrderStatus::Cancelled || status == OrderStatus::Rejected;
+}
+
+// Fixed-capacity string stored inline, so order records never allocate
+template <size_t N>
+struct InlineString {
+    static_assert(N < 256, "length is stored in one byte");
+
+    char data[N];
+    uint8_t length = 0;
+
+    // False (and unchanged) when the value does not fit
+    bool assign(std::string_view value) {
+        if (value.size() > N) {
+            return false;
+        }
+        std::memcpy(data, value.data(), value.size());
+        length = static_cast<uint8_t>(value.size());
+        return true;
+    }
+
+    std::string_view view() const { return std::string_view(data, length); }
+    bool empty() const { return length == 0; }
+};
+
 struct Order {
-    std::string id;
-    std::string instrument;
-    std::string side;
-    std::string type;
-    double amount;
-    double price;
-    double filled;
-    std::string status;
-    int64_t timestamp;
+    InlineString<32> id;     // exchange order ID, e.g. "ETH-349280929"
+    InlineString<64> label;  // client label; Deribit allows up to 64 characters
+    InstrumentId instrument_id = kInvalidInstrument;
+    OrderSide side = OrderSide::Unknown;
+    OrderType type = OrderType::Unknown;
+    OrderStatus status = OrderStatus::Unknown;
+    double amount = 0;
+    double price = 0;
+    double filled = 0;
+    int64_t timestamp = 0;        // exchange last_update_timestamp (ms)
+    // Local monotonic lifecycle times; 0 until reached
+    int64_t send_ns = 0;
+    int64_t ack_ns = 0;
+    int64_t first_fill_ns = 0;
+    int64_t done_ns = 0;
 };
 
+// Per-instrument latency from send to ack, first fill and done
+struct OrderLatencySummary {
+    LatencyHistogram::Summary ack;
+    LatencyHistogram::Summary first_fill;
+    LatencyHistogram::Summary done;
+};
+
+// Live orders in a fixed slab of records, preallocated at construction.
+// Records are indexed by exchange order ID and by label through chained
+// hash buckets, and linked into one intrusive list per instrument, so
+// lookups and per-instrument queries touch only the orders involved.
+// Queries hand out const references through visitors instead of copies;
+// visitors run under the manager's lock and must not call back into it.
 class OrderManager {
 public:
-    OrderManager();
+    static constexpr size_t kDefaultCapacity = 65536;
+
+    explicit OrderManager(size_t capacity = kDefaultCapacity);
+
+    // Inserts or replaces by ID; when the slab is full, finished orders are
+    // purged first. False if there is still no room.
+    bool add_order(const Order& order);
+    void update_order(std::string_view id, const json& update);
+    void remove_order(std::string_view id);
+    // Drops filled, cancelled and rejected orders; returns how many
+    size_t purge_terminal();
+
+    // Exchange-driven lifecycle. An order placed from here is tracked by its
+    // client label (status Pending, no ID) until the place response or a
+    // user.orders event carrying the same label supplies the exchange ID.
+    // Every status change is checked against the order state machine;
+    // invalid or out-of-date events are counted and ignored. Tracking may
+    // follow the send: an order already adopted under the label is kept.
+    // Only an exchange error rejects a Pending order; after a timeout or a
+    // local send failure it stays Pending for the next event to decide.
+    bool track_new_order(const Order& order);
+    void on_place_response(std::string_view label, const json& response, InstrumentRegistry& instruments,
+        int64_t receive_ns);
+    void on_order_event(const OrderEvent& event, InstrumentRegistry& instruments, int64_t receive_ns);
+    void on_user_trade(const UserTradeEvent& trade, int64_t receive_ns);
+
+    // False when no order on the instrument has been acknowledged yet
+    bool order_latency(InstrumentId instrument, OrderLatencySummary& summary) const;
+    uint64_t rejected_events() const;
+
+    // Reconciliation of bulk results, each applied under a single lock.
+    // Upserts Deribit order objects (order_id, order_state, filled_amount, ...)
+    size_t apply_order_reports(const json& orders, InstrumentRegistry& instruments, int64_t receive_ns = 0);
+    // Result of cancel_all/cancel_all_by_instrument/cancel_by_label: either a
+    // count, applied to the local orders in scope, or detailed order reports.
+    // kInvalidInstrument and an empty label match every order.
+    size_t apply_cancel_result(const json& result, InstrumentRegistry& instruments,
+        InstrumentId instrument = kInvalidInstrument, std::string_view label = std::string_view());
+
+    bool get_order(std::string_view id, Order& order) const;
+    size_t size() const;
+    // Orders on the instrument that are not filled, cancelled or rejected,
+    // including those still awaiting acknowledgement. Lock-free.
+    uint32_t open_orders(InstrumentId instrument) const {
+        return instrument < InstrumentRegistry::kMaxInstruments ?
+            open_counts_[instrument].load(std::memory_order_relaxed) : 0;
+    }
 
-    void add_order(const Order& order);
-    void update_order(const std::string& id, const json& update);
-    void remove_order(const std::string& id);
+    template <typename F>
+    void for_each_order(F&& f) const {
+        std::lock_guard<std::mutex> lock(orders_mutex_);
+        for (uint32_t i = 0; i < high_water_; ++i) {
+            if (records_[i].live) {
+                f(records_[i].order);
+            }
+        }
+    }
 
-    Order get_order(const std::string& id) const;
-    std::vector<Order> get_orders() const;
-    std::vector<Order> get_orders_for_instrument(const std::string& instrument) const;
+    template <typename F>
+    void for_each_order_for_instrument(InstrumentId instrument, F&& f) const {
+        if (instrument >= InstrumentRegistry::kMaxInstruments) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(orders_mutex_);
+        for (uint32_t i = instrument_heads_[instrument]; i != kNone; i = records_[i].instrument_next) {
+            f(records_[i].order);
+        }
+    }
+
+    template <typename F>
+    void for_each_order_with_label(std::string_view label, F&& f) const {
+        std::lock_guard<std::mutex> lock(orders_mutex_);
+        for (uint32_t i = label_buckets_[hash(label) & bucket_mask_]; i != kNone; i = records_[i].label_next) {
+            if (records_[i].order.label.view() == label) {
+                f(records_[i].order);
+            }
+        }
+    }
 
 private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    struct Record {
+        Order order;
+        uint32_t id_next = kNone;
+        uint32_t label_next = kNone;
+        uint32_t instrument_prev = kNone;
+        uint32_t instrument_next = kNone;
+        bool live = false;
+    };
+
     mutable std::mutex orders_mutex_;
-    std::map<std::string, Order> orders_;
-};
\ No newline at end of file
+    std::vector<Record> records_;
+    uint32_t free_head_ = kNone;   // free records chained through id_next
+    uint32_t high_water_ = 0;      // records_[high_water_..] were never used
+    size_t count_ = 0;
+    std::vector<uint32_t> id_buckets_;
+    std::vector<uint32_t> label_buckets_;
+    size_t bucket_mask_ = 0;
+    std::unique_ptr<uint32_t[]> instrument_heads_;
+    // Non-terminal orders per instrument list; written under the lock
+    std::unique_ptr<std::atomic<uint32_t>[]> open_counts_;
+
+    struct InstrumentLatency {
+        LatencyHistogram ack;
+        LatencyHistogram first_fill;
+        LatencyHistogram done;
+    };
+    // Allocated on an instrument's first lifecycle event
+    std::vector<std::unique_ptr<InstrumentLatency>> latency_;
+    uint64_t rejected_events_ = 0;
+
+    static uint64_t hash(std::string_view key);
+
+    uint32_t find(std::string_view id) const;
+    uint32_t find_pending(std::string_view label) const;
+    uint32_t insert(const Order& order);
+    uint32_t allocate();
+    void release(uint32_t index);
+    void link_id(uint32_t index);
+    void unlink_id(uint32_t index);
+    void link_label(uint32_t index);
+    void unlink_label(uint32_t index);
+    void link_instrument(uint32_t index);
+    void unlink_instrument(uint32_t index);
+    void set_label(uint32_t index, std::string_view label);
+    void set_instrument(uint32_t index, InstrumentId instrument);
+    void set_status(uint32_t index, OrderStatus status);
+    void count_open(InstrumentId instrument, OrderStatus status, int delta);
+    size_t purge_terminal_locked();
+    void apply_order_report(const json& report, InstrumentRegistry& instruments, int64_t receive_ns);
+    void apply_event(const OrderEvent& event, InstrumentRegistry& instruments, int64_t receive_ns);
+    void mark_first_fill(uint32_t index, int64_t receive_ns);
+    InstrumentLatency* latency_for(InstrumentId instrument);
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "latency_histogram.h"
+#include "mpsc_queue.h"
+#include "order_encoder.h"
+
+// Lanes are drained strictly in this order
+enum class SendPriority {
+    Cancel,
+    Order,
+    Other  // subscriptions, queries, auth
+};
+
+// Order-entry frames fit the inline buffer, so queueing them does not
+// allocate; anything larger is carried in heap_payload
+struct OutboundFrame {
+    static constexpr size_t kMaxMergeKey = 63;
+
+    int64_t enqueue_ns = 0;
+    int64_t request_id = 0;
+    uint32_t size = 0;
+    // Frames with equal non-empty keys may replace each other while held
+    // back by the rate limiter, e.g. edits of the same order
+    uint8_t merge_key_size = 0;
+    char merge_key[kMaxMergeKey];
+    char inline_payload[OrderEncoder::kCapacity];
+    std::string heap_payload;
+
+    std::string_view payload() const {
+        return heap_payload.empty() ? std::string_view(inline_payload, size) : std::string_view(heap_payload);
+    }
+    std::string_view merge_key_view() const { return std::string_view(merge_key, merge_key_size); }
+};
+
+struct OutboundStats {
+    uint64_t enqueued = 0;
+    uint64_t sent = 0;
+    uint64_t rejected = 0;
+    uint64_t batches = 0;
+    size_t max_batch = 0;
+    size_t depth = 0;
+};
+
+// Frames waiting for the I/O thread. Any thread may push; only the I/O
+// thread pops, always taking the highest-priority lane first.
+class OutboundQueue {
+public:
+    static constexpr size_t kLanes = 3;
+
+    explicit OutboundQueue(size_t lane_capacity = 1024);
+
+    bool push(SendPriority priority, std::string_view payload, int64_t request_id, int64_t now_ns,
+        std::string_view merge_key = std::string_view());
+    bool push(SendPriority priority, std::string&& payload, int64_t request_id, int64_t now_ns);
+
+    // I/O thread
+    bool pop(OutboundFrame& frame);
+    bool pop(SendPriority priority, OutboundFrame& frame);
+    void record_sent(const OutboundFrame& frame, int64_t now_ns);
+    void record_batch(size_t frames);
+
+    bool empty() const;
+    // Enqueue to hand-off to the websocket writer
+    const LatencyHistogram& latency() const { return latency_; }
+    OutboundStats stats() const;
+
+private:
+    MpscQueue<OutboundFrame> lanes_[kLanes];
+    LatencyHistogram latency_;
+    std::atomic<uint64_t> enqueued_{ 0 };
+    std::atomic<uint64_t> sent_{ 0 };
+    std::atomic<uint64_t> rejected_{ 0 };
+    std::atomic<uint64_t> batches_{ 0 };
+    std::atomic<size_t> max_batch_{ 0 };
+
+    bool push_frame(SendPriority priority, OutboundFrame&& frame);
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "latency_histogram.h"
+#include "mpsc_queue.h"
+
+using json = nlohmann::json;
+
+struct PendingRequestStats {
+    size_t in_flight = 0;
+    uint64_t completed = 0;
+    uint64_t timed_out = 0;
+    uint64_t rejected = 0;
+};
+
+// JSON-RPC requests awaiting a response. Slots form a fixed array indexed
+// by request ID modulo capacity; each slot's state word carries the full ID
+// of its occupant, so the ID doubles as the slot's generation counter and a
+// late response for a recycled slot is simply not recognised.
+//
+// add() is lock-free and may be called from any thread. Everything else
+// runs on the single owner thread that receives responses: it completes
+// requests and drives a hashed timer wheel that fires timeout callbacks.
+// Deadlines reach the wheel through an MPSC queue, so the wheel's intrusive
+// lists are only ever touched by the owner.
+//
+// Every handler runs exactly once: a request that times out is completed
+// with a synthetic kRequestTimeout error response after its timeout callback.
+class PendingRequestTable {
+public:
+    using ResponseHandler = std::function<void(const json&)>;
+    using TimeoutHandler = std::function<void(int64_t request_id)>;
+
+    // Codes of locally generated error responses, in JSON-RPC's
+    // implementation-defined range so they never clash with Deribit's
+    static constexpr int kRequestTimeout = -32000;
+    static constexpr int kRequestNotSent = -32001;
+
+    static constexpr int64_t kDefaultTimeoutNs = 10'000'000'000;
+    static constexpr int64_t kTickNs = 10'000'000;
+    static constexpr size_t kWheelSlots = 512;
+
+    explicit PendingRequestTable(size_t capacity = 4096);
+
+    // IDs for requests nobody waits on; shares the sequence with add()
+    int64_t next_id();
+
+    // Any thread. Returns the request ID, or 0 when no slot could be claimed
+    // because the table is saturated with requests still in flight; the
+    // handlers are only moved from on success.
+    int64_t add(ResponseHandler&& handler, TimeoutHandler&& on_timeout, int64_t timeout_ns, int64_t now_ns);
+
+    // Owner thread
+    bool is_pending(int64_t id) const;
+    bool complete(int64_t id, const json& response, int64_t receive_ns);
+    // Fires the timeout callbacks of requests whose deadline has passed,
+    // then completes them with error_response(id, kRequestTimeout, ...)
+    size_t expire(int64_t now_ns);
+
+    static json error_response(int64_t id, int code, const char* message);
+    // True for the error responses built here rather than sent by Deribit
+    static bool is_local_error(const json& response) {
+        auto error = response.find("error");
+        if (error == response.end() || !error->is_object() || !error->contains("code")) {
+            return false;
+        }
+        const json& code = (*error)["code"];
+        return code == kRequestTimeout || code == kRequestNotSent;
+    }
+
+    const LatencyHistogram& latency() const { return latency_; }
+    PendingRequestStats stats() const;
+
+private:
+    enum Status : uint64_t { Free = 0, Claimed = 1, Pending = 2 };
+    static constexpr uint32_t kNoSlot = UINT32_MAX;
+    static constexpr int kClaimAttempts = 8;
+
+    struct Slot {
+        std::atomic<uint64_t> state{ Free };
+        int64_t sent_ns = 0;
+        int64_t deadline_ns = 0;
+        ResponseHandler handler;
+        TimeoutHandler on_timeout;
+        // Owner-thread timer wheel links
+        uint32_t wheel_prev = kNoSlot;
+        uint32_t wheel_next = kNoSlot;
+        int32_t wheel_bucket = -1;
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    size_t mask_ = 0;
+    std::atomic<int64_t> next_id_{ 1 };
+    // Request IDs whose deadline still has to be linked into the wheel
+    MpscQueue<int64_t> armed_;
+
+    std::vector<uint32_t> wheel_;
+    int64_t wheel_tick_ = -1;
+
+    LatencyHistogram latency_;
+    std::atomic<size_t> in_flight_{ 0 };
+    std::atomic<uint64_t> completed_{ 0 };
+    std::atomic<uint64_t> timed_out_{ 0 };
+    std::atomic<uint64_t> rejected_{ 0 };
+
+    static uint64_t pack(int64_t id, Status status) {
+        return (static_cast<uint64_t>(id) << 2) | status;
+    }
+
+    uint32_t index_of(int64_t id) const { return static_cast<uint32_t>(id & mask_); }
+    void drain_armed();
+    void link(uint32_t index);
+    void unlink(uint32_t index);
+    void release(uint32_t index, int64_t id);
+};
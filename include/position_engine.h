@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "instrument_registry.h"
+#include "market_data.h"
+#include "order_manager.h"
+#include "seqlock.h"
+
+using json = nlohmann::json;
+
+// One instrument's position as published to readers. PnL is in the
+// settlement currency, which is the coin for inverse contracts.
+struct Position {
+    InstrumentId instrument_id;
+    uint32_t currency;          // index for PositionEngine::currency_name
+    double size;                // signed, buys positive; USD for inverse futures
+    double average_price;
+    double mark_price;          // mid of the top of book, or Deribit's mark when seeded
+    double realized_pnl;        // net of fees
+    double unrealized_pnl;
+    int64_t timestamp;          // exchange ms of the last fill or mark change
+};
+
+struct CurrencyTotals {
+    double realized_pnl;
+    double unrealized_pnl;
+    uint32_t open_positions;
+};
+
+// Positions and PnL kept in memory, seeded once from private/get_positions
+// and then moved by fills. A book tick reprices only its own instrument and
+// adjusts that currency's totals by the difference, so nothing is summed
+// across positions. All updates come from one thread (the processing
+// thread); every instrument and currency is published through its own
+// seqlock, so readers on any thread never lock.
+class PositionEngine {
+public:
+    static constexpr size_t kMaxCurrencies = 16;
+
+    explicit PositionEngine(const InstrumentRegistry& registry);
+    ~PositionEngine();
+
+    // Writer side. Fills arriving before the seed are held back; those
+    // stamped at or after requested_ms (when get_positions was sent) are
+    // replayed on top of it.
+    void seed(const json& positions, int64_t requested_ms);
+    bool seeded() const { return seeded_.load(std::memory_order_acquire); }
+    void on_fill(InstrumentId instrument, OrderSide side, double amount, double price, double fee, int64_t timestamp);
+    // Reprices the instrument from the book if a position is open on it
+    void on_book_update(InstrumentId instrument, const MarketData& market_data);
+
+    // Lock-free readers
+    bool get_position(InstrumentId instrument, Position& position) const;
+    double size(InstrumentId instrument) const;
+    bool get_totals(uint32_t currency, CurrencyTotals& totals) const;
+    size_t currency_count() const { return currency_count_.load(std::memory_order_acquire); }
+    std::string_view currency_name(uint32_t currency) const;
+
+    // Every instrument that has had a position, open or closed
+    template <typename F>
+    void for_each_position(F&& f) const {
+        size_t count = held_count_.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) {
+            Position position;
+            if (get_position(held_[i], position)) {
+                f(position);
+            }
+        }
+    }
+
+private:
+    struct PositionState {
+        // Writer only
+        Position current{};
+        bool inverse = false;
+
+        SeqLock<Position> published;
+    };
+
+    struct CurrencyState {
+        char name[16];
+        uint8_t length = 0;
+        // Writer only
+        CurrencyTotals current{};
+
+        SeqLock<CurrencyTotals> published;
+    };
+
+    struct PendingFill {
+        InstrumentId instrument;
+        OrderSide side;
+        double amount;
+        double price;
+        double fee;
+        int64_t timestamp;
+    };
+
+    const InstrumentRegistry& registry_;
+
+    std::unique_ptr<std::atomic<PositionState*>[]> positions_;
+    std::unique_ptr<InstrumentId[]> held_;
+    std::atomic<size_t> held_count_{ 0 };
+
+    std::unique_ptr<CurrencyState[]> currencies_;
+    std::atomic<size_t> currency_count_{ 0 };
+
+    std::atomic<bool> seeded_{ false };
+    std::vector<PendingFill> pending_fills_;
+
+    PositionState* state_for(InstrumentId instrument);
+    const PositionState* find_state(InstrumentId instrument) const;
+    uint32_t currency_for(InstrumentId instrument);
+    void apply_fill(PositionState& state, OrderSide side, double amount, double price, double fee, int64_t timestamp);
+    // Recomputes the unrealized PnL and moves the currency totals by the change
+    void reprice(PositionState& state, double mark_price, double realized_change, bool was_open);
+    static double pnl(const PositionState& state, double size, double from_price, double to_price);
+};
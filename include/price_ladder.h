@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <map>
+#include <vector>
+
+enum class BookSide {
+    Bid,
+    Ask
+};
+
+// One side of an order book stored as a flat array of sizes indexed by
+// integer tick. A window of `capacity` ticks around the touch lives in
+// contiguous memory with an occupancy bitmap for best-level tracking;
+// levels that fall outside the window go to a sorted overflow map.
+class PriceLadder {
+public:
+    static constexpr size_t kDefaultCapacity = 16384;
+
+    explicit PriceLadder(BookSide side, size_t capacity = kDefaultCapacity);
+
+    void set_tick_size(double tick_size);
+    double tick_size() const { return tick_size_; }
+
+    // amount <= 0 removes the level
+    void set(double price, double amount);
+    void erase(double price);
+    void clear();
+
+    bool empty() const { return levels_ == 0; }
+    size_t size() const { return levels_; }
+    double best_price() const { return static_cast<double>(best_tick_) * tick_size_; }
+    double best_amount() const;
+
+    // Visits levels from the touch outwards: f(price, amount)
+    template <typename F>
+    void for_each_level(size_t max_levels, F&& f) const;
+
+private:
+    static constexpr int64_t kNoTick = INT64_MIN;
+
+    BookSide side_;
+    size_t capacity_;
+    double tick_size_ = 1.0;
+    double inv_tick_size_ = 1.0;
+
+    int64_t base_tick_ = 0;
+    bool anchored_ = false;
+    int64_t best_tick_ = kNoTick;
+    size_t levels_ = 0;
+    size_t window_levels_ = 0;
+
+    std::vector<double> sizes_;
+    std::vector<uint64_t> occupied_;
+    std::vector<uint64_t> summary_;
+    std::map<int64_t, double> overflow_;
+
+    int64_t to_tick(double price) const { return std::llround(price * inv_tick_size_); }
+    bool in_window(int64_t tick) const {
+        return anchored_ && tick >= base_tick_ && tick < base_tick_ + static_cast<int64_t>(capacity_);
+    }
+    bool better(int64_t a, int64_t b) const {
+        return b == kNoTick || (side_ == BookSide::Bid ? a > b : a < b);
+    }
+
+    void set_tick(int64_t tick, double amount);
+    void erase_tick(int64_t tick);
+    void mark(size_t slot);
+    void unmark(size_t slot);
+    void recenter(int64_t center_tick);
+    void refresh_best();
+
+    // Bitmap searches; return capacity_ when nothing is found
+    size_t find_at_or_below(size_t slot) const;
+    size_t find_at_or_above(size_t slot) const;
+};
+
+template <typename F>
+void PriceLadder::for_each_level(size_t max_levels, F&& f) const {
+    size_t visited = 0;
+    auto visit = [&](int64_t tick, double amount) {
+        f(static_cast<double>(tick) * tick_size_, amount);
+        return ++visited < max_levels;
+    };
+    if (max_levels == 0 || levels_ == 0) {
+        return;
+    }
+
+    const int64_t window_end = base_tick_ + static_cast<int64_t>(capacity_);
+    if (side_ == BookSide::Bid) {
+        auto it = overflow_.rbegin();
+        for (; it != overflow_.rend() && (!anchored_ || it->first >= window_end); ++it) {
+            if (!visit(it->first, it->second)) return;
+        }
+        if (window_levels_ > 0) {
+            for (size_t slot = find_at_or_below(capacity_ - 1); slot != capacity_;
+                slot = slot == 0 ? capacity_ : find_at_or_below(slot - 1)) {
+                if (!visit(base_tick_ + static_cast<int64_t>(slot), sizes_[slot])) return;
+            }
+        }
+        for (; it != overflow_.rend(); ++it) {
+            if (!visit(it->first, it->second)) return;
+        }
+    }
+    else {
+        auto it = overflow_.begin();
+        for (; it != overflow_.end() && (!anchored_ || it->first < base_tick_); ++it) {
+            if (!visit(it->first, it->second)) return;
+        }
+        if (window_levels_ > 0) {
+            for (size_t slot = find_at_or_above(0); slot != capacity_;
+                slot = find_at_or_above(slot + 1)) {
+                if (!visit(base_tick_ + static_cast<int64_t>(slot), sizes_[slot])) return;
+            }
+        }
+        for (; it != overflow_.end(); ++it) {
+            if (!visit(it->first, it->second)) return;
+        }
+    }
+}
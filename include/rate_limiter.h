@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "outbound_queue.h"
+
+// Deribit meters matching-engine requests (buy/sell/edit/cancel) and
+// everything else separately
+enum class RateClass {
+    MatchingEngine,
+    NonMatching
+};
+
+// What happens to a request that finds its bucket empty
+enum class OverLimitPolicy {
+    Queue,  // hold it back until credits refill
+    Shed,   // fail it locally right away
+    Merge   // like Queue, but replaces a held-back request with the same merge key
+};
+
+struct RateBucketConfig {
+    double burst_credits;
+    double credits_per_second;
+    double cost;
+    OverLimitPolicy policy;
+};
+
+struct RateLimitConfig {
+    bool enabled = true;
+    // Deribit's defaults; raise them to match the account's tier
+    RateBucketConfig matching_engine{ 20, 5, 1, OverLimitPolicy::Merge };
+    RateBucketConfig non_matching{ 50000, 10000, 500, OverLimitPolicy::Queue };
+    // Held-back frames per lane; beyond this requests are shed
+    size_t max_backlog = 1024;
+};
+
+struct RateLimitStats {
+    uint64_t admitted = 0;
+    uint64_t held = 0;
+    uint64_t merged = 0;
+    uint64_t shed = 0;
+    size_t backlog = 0;
+};
+
+// Local credit model applied by the I/O thread to frames leaving the
+// OutboundQueue. Each class is a token bucket; frames over the limit are
+// held back per lane, in order, so cancels still overtake orders once
+// credits refill. Everything except stats() runs on the I/O thread.
+class RateLimiter {
+public:
+    // Called for requests that are shed, superseded by a merge, or
+    // overtaken by the cancel of their order
+    using DropHandler = std::function<void(int64_t request_id, const char* reason)>;
+
+    explicit RateLimiter(const RateLimitConfig& config = RateLimitConfig());
+
+    void configure(const RateLimitConfig& config);
+    void set_drop_handler(DropHandler handler) { drop_handler_ = std::move(handler); }
+
+    static RateClass class_of(SendPriority priority);
+
+    // Moves the next frame allowed on the wire into `frame`, highest
+    // priority first; false when nothing may be sent right now
+    bool next(OutboundQueue& queue, int64_t now_ns, OutboundFrame& frame);
+    // When the first held-back frame can go; 0 when nothing is held back
+    int64_t next_release_ns(int64_t now_ns) const;
+
+    RateLimitStats stats() const;
+
+private:
+    struct Bucket {
+        RateBucketConfig config;
+        double credits = 0;
+        int64_t refilled_ns = 0;
+
+        void refill(int64_t now_ns);
+        bool try_take();
+    };
+
+    // Fixed ring of held-back frames, oldest first
+    struct Backlog {
+        std::vector<OutboundFrame> frames;
+        size_t head = 0;
+        size_t count = 0;
+
+        OutboundFrame& at(size_t i) { return frames[(head + i) % frames.size()]; }
+    };
+
+    RateLimitConfig config_;
+    Bucket buckets_[2];
+    Backlog backlogs_[OutboundQueue::kLanes];
+    DropHandler drop_handler_;
+
+    std::atomic<uint64_t> admitted_{ 0 };
+    std::atomic<uint64_t> held_{ 0 };
+    std::atomic<uint64_t> merged_{ 0 };
+    std::atomic<uint64_t> shed_{ 0 };
+    std::atomic<size_t> backlog_size_{ 0 };
+
+    Bucket& bucket_for(size_t lane) { return buckets_[static_cast<size_t>(class_of(static_cast<SendPriority>(lane)))]; }
+    void hold(size_t lane, OutboundFrame&& frame, OverLimitPolicy policy);
+    // Counts an admitted frame; a cancel keyed by order ID drops held-back
+    // frames with the same key
+    void admit(SendPriority priority, const OutboundFrame& frame);
+    void drop(int64_t request_id, const char* reason);
+};
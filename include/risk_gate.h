@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include "instrument_registry.h"
+#include "latency_histogram.h"
+#include "market_data.h"
+#include "order_manager.h"
+#include "position_engine.h"
+#include "seqlock.h"
+
+// Why the risk gate refused an order; None means it may be sent
+enum class RiskReject : uint8_t {
+    None,
+    InvalidOrder,      // unknown instrument or side, non-positive or non-finite amount/price
+    UnknownOrder,      // edit of an order that is not tracked, or already finished
+    NoReferencePrice,  // priced order while the book has no two-sided quote
+    PriceBand,
+    OrderSize,
+    Position,
+    OpenOrders
+};
+
+constexpr size_t kRiskRejectReasons = 8;
+
+const char* to_string(RiskReject reason);
+
+// A limit of 0 disables that check
+struct RiskLimits {
+    double price_band = 0.05;       // furthest a limit price may be from mid, as a fraction of mid
+    double max_order_amount = 0;    // in the instrument's amount units (USD for inverse contracts)
+    double max_position = 0;        // absolute net position if the order filled completely
+    uint32_t max_open_orders = 0;   // live orders per instrument, including unacknowledged ones
+    // Reject priced orders when there is no reference mid. Books exist only
+    // for subscribed instruments, so by default such orders skip the band.
+    bool require_quote = false;
+};
+
+struct RiskStats {
+    uint64_t checked = 0;
+    uint64_t rejected = 0;
+    std::array<uint64_t, kRiskRejectReasons> by_reason{};
+    LatencyHistogram::Summary latency;
+};
+
+// Pre-trade checks run on the caller's thread right before an order or
+// edit is encoded. Reference prices and positions come from the MarketData
+// and PositionEngine seqlock snapshots and open-order counts from
+// OrderManager's atomic counters, so a check takes no lock on books,
+// positions or orders (edits look their order up once).
+class RiskGate {
+public:
+    RiskGate(const MarketData& market_data, const PositionEngine& positions, const OrderManager& orders);
+    ~RiskGate();
+
+    // Configuration; call from one thread
+    void set_default_limits(const RiskLimits& limits);
+    void set_limits(InstrumentId instrument, const RiskLimits& limits);
+    RiskLimits limits(InstrumentId instrument) const;
+
+    RiskReject check_order(InstrumentId instrument, OrderSide side, double amount, double price);
+    // The new amount replaces the order's, so only its unfilled part counts
+    RiskReject check_edit(std::string_view order_id, double amount, double price);
+
+    RiskStats stats() const;
+
+private:
+    const MarketData& market_data_;
+    const PositionEngine& positions_;
+    const OrderManager& orders_;
+
+    SeqLock<RiskLimits> default_limits_;
+    // Per-instrument overrides, allocated on first set_limits and kept
+    std::unique_ptr<std::atomic<SeqLock<RiskLimits>*>[]> instrument_limits_;
+
+    std::atomic<uint64_t> checked_{ 0 };
+    std::array<std::atomic<uint64_t>, kRiskRejectReasons> rejected_{};
+    LatencyHistogram latency_;
+
+    RiskReject evaluate(InstrumentId instrument, OrderSide side, double amount, double price,
+        bool counts_as_new) const;
+    RiskReject record(RiskReject result, int64_t start_ns);
+};
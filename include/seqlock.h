@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+    _mm_pause();
+#endif
+}
+
+// Single-writer sequence lock. The writer never waits; readers retry
+// while a write is in progress, so reads are lock-free and never stall
+// the writer. T must be trivially copyable.
+template <typename T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock requires a trivially copyable type");
+
+public:
+    SeqLock() : value_() {}
+
+    void store(const T& value) {
+        uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&value_, &value, sizeof(T));
+        sequence_.store(sequence + 2, std::memory_order_release);
+    }
+
+    T load() const {
+        T result;
+        read([&](const T& value) { std::memcpy(&result, &value, sizeof(T)); });
+        return result;
+    }
+
+    // f may only copy out of the value: it can observe a torn write and is
+    // re-run until it completes without one
+    template <typename F>
+    void read(F&& f) const {
+        uint64_t before;
+        uint64_t after;
+        do {
+            before = sequence_.load(std::memory_order_acquire);
+            while (before & 1) {
+                cpu_relax();
+                before = sequence_.load(std::memory_order_acquire);
+            }
+            f(value_);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence_.load(std::memory_order_relaxed);
+        } while (before != after);
+    }
+
+private:
+    alignas(64) std::atomic<uint64_t> sequence_{ 0 };
+    T value_;
+};
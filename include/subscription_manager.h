@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "channel_messages.h"
+#include "deribit_client.h"
+#include "instrument_registry.h"
+#include "latency_histogram.h"
+#include "market_data.h"
+#include "websocket_server.h"
+
+using json = nlohmann::json;
+
+// Reference-counted upstream subscriptions shared by the console and
+// downstream clients. Deribit is subscribed when the first holder asks for
+// a channel and unsubscribed when the last one lets go.
+//
+// Downstream clients speak a subset of Deribit's own protocol:
+//   {"id": 1, "method": "public/subscribe", "params": {"channels": ["book.BTC-PERPETUAL.raw"]}}
+// ("subscribe"/"unsubscribe" are accepted too) and get back the accepted
+// channels as the result. Instrument book, ticker and trades channels are
+// served; there is one local book per instrument, so book channels are raw.
+// book.<instrument>.analytics is local: the BookAnalytics of the raw book,
+// sent after every update, which holds book.<instrument>.raw upstream.
+//
+// A client subscribing to a book channel, or subscribing again to one it
+// holds, is sent the local book as a Deribit-style "snapshot" notification
+// (to an optional params.depth) without going back to Deribit. Snapshot and
+// subscription are taken on the feed thread between two updates, so the
+// first delta that follows has prev_change_id equal to its change_id. A
+// client that falls so far behind that one of its book messages is dropped
+// is resent the local book the same way before it gets more deltas.
+class SubscriptionManager {
+public:
+    SubscriptionManager(DeribitClient& deribit_client, WebSocketServer& websocket_server, MarketData& market_data,
+        InstrumentRegistry& instruments);
+
+    // The console's own holds, at most one per channel. acquire returns the
+    // channels that can be served; the others are ignored.
+    std::vector<std::string> acquire(const std::vector<std::string>& channels);
+    void release(const std::vector<std::string>& channels);
+
+    // Wired to WebSocketServer's message and close handlers
+    void on_client_message(const std::string& payload, websocketpp::connection_hdl hdl);
+    void on_client_close(websocketpp::connection_hdl hdl);
+    // Wired to WebSocketServer's gap handler
+    void on_client_gap(websocketpp::connection_hdl hdl, InstrumentId instrument);
+
+    // Subscriber-index stream bit of a channel, for WebSocketServer::publish
+    static uint32_t stream_bit(const ChannelRoute& route);
+    static constexpr uint32_t kAnalyticsStream = 1u << 12;
+    // Conflation key of a full-state channel (ticker): one per instrument
+    // and stream, apart from the per-instrument position keys
+    static uint64_t conflation_key(const ChannelRoute& route);
+
+    // Feed thread: sends the local book to every subscriber of a book
+    // channel, e.g. once it has been resynced after a gap
+    void publish_book_snapshot(const ChannelRoute& route);
+    // Feed thread: sends the book's analytics to the subscribers of its
+    // analytics channel, after each update that changed the book
+    void publish_analytics(InstrumentId instrument, int64_t timestamp);
+
+    // Channel -> holder count, for reporting
+    std::vector<std::pair<std::string, size_t>> upstream_channels() const;
+    // Subscribe request to snapshot queued, per late-join snapshot served
+    LatencyHistogram::Summary snapshot_latency() const { return snapshot_latency_.summary(); }
+
+private:
+    struct Held {
+        size_t holders = 0;
+        InstrumentId instrument = kInvalidInstrument;
+        uint32_t stream = 0;
+        bool book = false;        // needs the local book
+        bool analytics = false;   // served from the local book, no snapshot
+        std::string upstream;     // the Deribit channel it holds
+    };
+
+    DeribitClient& deribit_client_;
+    WebSocketServer& websocket_server_;
+    MarketData& market_data_;
+    InstrumentRegistry& instruments_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Held> held_;   // by upstream channel
+    std::map<websocketpp::connection_hdl, std::set<std::string>, std::owner_less<websocketpp::connection_hdl>> clients_;
+    LatencyHistogram snapshot_latency_;
+
+    bool resolve(const std::string& channel, Held& held) const;
+    // Called with mutex_ held; the channels to subscribe or unsubscribe
+    // upstream are collected so one request covers a whole batch, and sent
+    // before the lock is released so upstream sees them in order
+    bool hold(const std::string& channel, std::vector<std::string>& subscribe);
+    void drop(const std::string& channel, std::vector<std::string>& unsubscribe);
+    void send_upstream(const std::vector<std::string>& subscribe, const std::vector<std::string>& unsubscribe);
+    // Feed thread; false while the local book is not synced, in which case
+    // Deribit's own snapshot or the resync one reaches the client instead
+    bool send_book_snapshot(websocketpp::connection_hdl hdl, const std::string& channel, InstrumentId instrument,
+        size_t depth);
+};
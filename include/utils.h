@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <cstdint>
 #include <vector>
 #include <iomanip>
 #include <sstream>
@@ -8,4 +9,11 @@
 
 std::string hex_encode(const unsigned char* data, size_t length);
 std::vector<std::string> split_string(const std::string& str, char delimiter);
-std::string get_current_timestamp();
\ No newline at end of file
+std::string get_current_timestamp();
+// Monotonic clock in nanoseconds, for latency measurement
+int64_t monotonic_time_ns();
+
+// Pins the calling thread to one CPU; returns false where unsupported
+bool pin_current_thread(int cpu);
+// Switches the calling thread to real-time scheduling (SCHED_FIFO on Linux)
+bool set_current_thread_realtime(int priority);
@@ -1,43 +1,268 @@
 #pragma once
 #include <websocketpp/config/asio.hpp>
 #include <websocketpp/server.hpp>
-#include <set>
+#include <atomic>
+#include <cstdint>
+#include <deque>
 #include <mutex>
 #include <functional>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 #include <nlohmann/json.hpp>
+#include "binary_protocol.h"
+#include "instrument_registry.h"
 
 using json = nlohmann::json;
 // Using TLS-enabled configuration
 using WebsocketServer = websocketpp::server<websocketpp::config::asio_tls>;
 
+// What a client's queue does once it holds max_queued messages
+enum class SlowClientPolicy {
+    Conflate,     // keyed messages replace their queued predecessor; otherwise drop the oldest
+    DropOldest,
+    Disconnect    // close the connection; also once the oldest message is max_lag_ms old
+};
+
+const char* to_string(SlowClientPolicy policy);
+
+struct ClientQueueConfig {
+    SlowClientPolicy policy = SlowClientPolicy::Conflate;
+    size_t max_queued = 1024;                 // messages waiting per client
+    size_t max_buffered_bytes = 256 * 1024;   // handed to the socket but not yet written
+    int max_lag_ms = 5000;
+    int pump_interval_ms = 5;                 // how often backed-up queues are retried
+};
+
+struct ClientStats {
+    std::string remote;
+    size_t queued = 0;
+    size_t max_queued = 0;
+    size_t buffered_bytes = 0;
+    int64_t lag_ms = 0;         // age of the oldest queued message
+    uint64_t sent = 0;
+    uint64_t dropped = 0;
+    uint64_t conflated = 0;
+    uint64_t gaps = 0;          // sequenced streams resynced after a drop
+    bool disconnecting = false;
+    bool binary = false;
+};
+
+// Broadcasts are framed once into a shared, reference-counted message and
+// queued as-is on every connection. The connection list is copy-on-write:
+// open/close publish a new list, broadcast iterates a snapshot unlocked.
+// Each client has a bounded queue in front of its socket: messages go
+// straight through while the socket keeps up, and only a slow client
+// queues, conflates or drops, so it never holds back the others.
+// Clients that negotiate kBinarySubprotocol get market data in the
+// binary_protocol.h encoding, which is built only if one of them needs it.
 class WebSocketServer {
 public:
     using MessageHandler = std::function<void(const std::string&, websocketpp::connection_hdl)>;
+    using CloseHandler = std::function<void(websocketpp::connection_hdl)>;
+    // A client lost a sequenced message of this instrument; see kSequenced
+    using GapHandler = std::function<void(websocketpp::connection_hdl, InstrumentId)>;
+    // A complete frame, header included; immutable once built
+    using Frame = WebsocketServer::message_ptr;
+
+    static constexpr uint64_t kNoConflation = UINT64_MAX;
+    // Conflation keys for publish on streams where each message continues
+    // the last (book deltas). Such messages are never conflated; a client
+    // that loses one is reported to the gap handler and gets no more of
+    // that instrument's sequenced messages until one published or sent as
+    // kSnapshot restarts it. A lost kSnapshot message is a gap as well.
+    static constexpr uint64_t kSequenced = UINT64_MAX - 1;
+    static constexpr uint64_t kSnapshot = UINT64_MAX - 2;
 
-    WebSocketServer(int port, const std::string& cert_file, const std::string& key_file);
+    WebSocketServer(int port, const std::string& cert_file, const std::string& key_file,
+        const ClientQueueConfig& queue_config = ClientQueueConfig());
     ~WebSocketServer();
 
     void start();
     void stop();
     void broadcast(const std::string& message);
+    // conflation_key names a stream of full-state messages (e.g. one
+    // instrument's position) where only the newest needs delivering
+    void broadcast(const Frame& frame, uint64_t conflation_key = kNoConflation);
+    // JSON text to text clients, and what encode_binary(std::string&)
+    // appends to binary clients (nothing is sent if it appends nothing)
+    template <typename EncodeBinary>
+    void broadcast(const std::string& text, EncodeBinary&& encode_binary, uint64_t conflation_key = kNoConflation);
+    size_t client_count() const;
+    std::vector<ClientStats> client_stats() const;
+
+    static Frame make_frame(std::string_view payload,
+        websocketpp::frame::opcode::value opcode = websocketpp::frame::opcode::text);
     void send(websocketpp::connection_hdl hdl, const std::string& message);
+    void send(websocketpp::connection_hdl hdl, const Frame& frame);
+    // A kSnapshot message for one client, e.g. a late-join book snapshot
+    void send_snapshot(websocketpp::connection_hdl hdl, InstrumentId instrument, const Frame& frame);
+    bool is_binary(websocketpp::connection_hdl hdl) const;
     void register_message_handler(MessageHandler handler);
+    // Called after a closed connection has left the client list and subscriber index
+    void register_close_handler(CloseHandler handler);
+    // Called outside the client's lock, on the thread whose message made room
+    void register_gap_handler(GapHandler handler);
+
+    // Per-instrument subscriber index. Streams are caller-defined bits, one
+    // per channel of an instrument; publish reaches only the clients that
+    // subscribed to that instrument and stream: text to text clients,
+    // encode_binary's messages to binary ones. Each encoding is framed only
+    // if some subscriber needs it.
+    void add_subscription(websocketpp::connection_hdl hdl, InstrumentId instrument, uint32_t streams);
+    void remove_subscription(websocketpp::connection_hdl hdl, InstrumentId instrument, uint32_t streams);
+    // Lets callers skip building a message nobody would receive
+    bool has_subscribers(InstrumentId instrument, uint32_t stream) const;
+    template <typename EncodeBinary>
+    void publish(InstrumentId instrument, uint32_t stream, const std::string& text, EncodeBinary&& encode_binary,
+        uint64_t conflation_key = kNoConflation);
 
 private:
     int port_;
     WebsocketServer server_;
-    std::set<websocketpp::connection_hdl, std::owner_less<websocketpp::connection_hdl>> connections_;
+    ClientQueueConfig queue_config_;
+
+    struct Pending {
+        Frame frame;
+        uint64_t key;
+        int64_t queued_ns;
+        InstrumentId sequenced;         // kInvalidInstrument unless kSequenced or kSnapshot
+    };
+
+    struct Client {
+        websocketpp::connection_hdl hdl;
+        WebsocketServer::connection_ptr connection;
+        bool rfc6455;   // hybi-07 and later share one framing; hybi-00 needs its own
+        bool binary;    // negotiated kBinarySubprotocol
+        std::string remote;
+
+        std::mutex mutex;               // broadcasting thread vs. the pump timer
+        std::deque<Pending> queue;
+        uint64_t popped = 0;            // sequence number of queue.front()
+        std::unordered_map<uint64_t, uint64_t> latest;   // key -> sequence of its queued message
+        std::atomic<size_t> queued{ 0 };
+        size_t max_queued = 0;
+        uint64_t sent = 0;
+        uint64_t dropped = 0;
+        uint64_t conflated = 0;
+        uint64_t gaps = 0;
+        bool disconnecting = false;
+        std::vector<InstrumentId> gapped;   // sequenced streams waiting for a snapshot
+
+        std::vector<InstrumentId> subscribed;   // guarded by connections_mutex_
+    };
+    using ClientList = std::vector<std::shared_ptr<Client>>;
+
+    struct Subscriber {
+        std::shared_ptr<Client> client;
+        uint32_t streams;
+    };
+    using SubscriberList = std::vector<Subscriber>;
+
+    // Read with std::atomic_load; replaced under connections_mutex_
+    std::shared_ptr<const ClientList> clients_;
     std::mutex connections_mutex_;
+    // Per instrument, copy-on-write like clients_; null when nobody subscribed
+    std::unique_ptr<std::shared_ptr<const SubscriberList>[]> subscribers_;
     MessageHandler message_handler_;
+    CloseHandler close_handler_;
+    GapHandler gap_handler_;
 
+    bool on_validate(websocketpp::connection_hdl hdl);
     void on_open(websocketpp::connection_hdl hdl);
     void on_close(websocketpp::connection_hdl hdl);
     void on_message(websocketpp::connection_hdl hdl, WebsocketServer::message_ptr msg);
 
+    // Frames the binary encoding once per call; empty when there is nothing to send
+    template <typename EncodeBinary>
+    static Frame make_binary_frame(EncodeBinary& encode_binary);
+    std::shared_ptr<Client> find_client(websocketpp::connection_hdl hdl) const;
+    // Called with connections_mutex_ held
+    void update_subscription(const std::shared_ptr<Client>& client, InstrumentId instrument, uint32_t add,
+        uint32_t remove);
+
+    // instrument is only used by kSequenced and kSnapshot messages
+    void deliver(Client& client, const Frame& frame, uint64_t key, InstrumentId instrument = kInvalidInstrument);
+    // Called with client.mutex held
+    void pump(Client& client, int64_t now_ns);
+    void pop_front(Client& client);
+    // Drops the oldest message to make room; the instrument whose sequenced
+    // stream now has a gap, or kInvalidInstrument
+    InstrumentId drop_oldest(Client& client);
+    void disconnect_slow(Client& client, const char* reason);
+    void schedule_pump();
+
     // TLS context setup
     std::string cert_file_;
     std::string key_file_;
     // Using connection_hdl in the signature for TLS init handler
     std::shared_ptr<websocketpp::lib::asio::ssl::context> on_tls_init(websocketpp::connection_hdl hdl);
-};
\ No newline at end of file
+};
+
+template <typename EncodeBinary>
+WebSocketServer::Frame WebSocketServer::make_binary_frame(EncodeBinary& encode_binary) {
+    thread_local std::string buffer;
+    buffer.clear();
+    encode_binary(buffer);
+    return buffer.empty() ? Frame() : make_frame(buffer, websocketpp::frame::opcode::binary);
+}
+
+template <typename EncodeBinary>
+void WebSocketServer::broadcast(const std::string& text, EncodeBinary&& encode_binary, uint64_t conflation_key) {
+    std::shared_ptr<const ClientList> clients = std::atomic_load(&clients_);
+    Frame text_frame;
+    Frame binary_frame;
+    bool binary_encoded = false;
+    for (const std::shared_ptr<Client>& client : *clients) {
+        if (!client->binary) {
+            if (!text_frame) {
+                text_frame = make_frame(text);
+            }
+            deliver(*client, text_frame, conflation_key);
+            continue;
+        }
+        if (!binary_encoded) {
+            binary_frame = make_binary_frame(encode_binary);
+            binary_encoded = true;
+        }
+        if (binary_frame) {
+            deliver(*client, binary_frame, conflation_key);
+        }
+    }
+}
+
+template <typename EncodeBinary>
+void WebSocketServer::publish(InstrumentId instrument, uint32_t stream, const std::string& text,
+    EncodeBinary&& encode_binary, uint64_t conflation_key) {
+    if (instrument >= InstrumentRegistry::kMaxInstruments) {
+        return;
+    }
+    std::shared_ptr<const SubscriberList> subscribers = std::atomic_load(&subscribers_[instrument]);
+    if (!subscribers) {
+        return;
+    }
+    Frame text_frame;
+    Frame binary_frame;
+    bool binary_encoded = false;
+    for (const Subscriber& subscriber : *subscribers) {
+        if (!(subscriber.streams & stream)) {
+            continue;
+        }
+        if (!subscriber.client->binary) {
+            if (!text_frame) {
+                text_frame = make_frame(text);
+            }
+            deliver(*subscriber.client, text_frame, conflation_key, instrument);
+            continue;
+        }
+        if (!binary_encoded) {
+            binary_frame = make_binary_frame(encode_binary);
+            binary_encoded = true;
+        }
+        if (binary_frame) {
+            deliver(*subscriber.client, binary_frame, conflation_key, instrument);
+        }
+    }
+}
@@ -0,0 +1,139 @@
+#include "binary_encoder.h"
+#include "order_manager.h"
+
+namespace {
+
+BinarySide binary_side(std::string_view direction) {
+    switch (parse_order_side(direction)) {
+    case OrderSide::Buy: return BinarySide::Buy;
+    case OrderSide::Sell: return BinarySide::Sell;
+    default: return BinarySide::Unknown;
+    }
+}
+
+BinaryOrderState binary_state(std::string_view state) {
+    switch (parse_order_status(state)) {
+    case OrderStatus::Open: return BinaryOrderState::Open;
+    case OrderStatus::Filled: return BinaryOrderState::Filled;
+    case OrderStatus::Rejected: return BinaryOrderState::Rejected;
+    case OrderStatus::Cancelled: return BinaryOrderState::Cancelled;
+    case OrderStatus::Untriggered: return BinaryOrderState::Untriggered;
+    default: return BinaryOrderState::Unknown;
+    }
+}
+
+BinaryOrderType binary_type(std::string_view type) {
+    switch (parse_order_type(type)) {
+    case OrderType::Limit: return BinaryOrderType::Limit;
+    case OrderType::Market: return BinaryOrderType::Market;
+    case OrderType::StopLimit: return BinaryOrderType::StopLimit;
+    case OrderType::StopMarket: return BinaryOrderType::StopMarket;
+    case OrderType::TakeLimit: return BinaryOrderType::TakeLimit;
+    case OrderType::TakeMarket: return BinaryOrderType::TakeMarket;
+    case OrderType::MarketLimit: return BinaryOrderType::MarketLimit;
+    case OrderType::TrailingStop: return BinaryOrderType::TrailingStop;
+    default: return BinaryOrderType::Unknown;
+    }
+}
+
+BinaryInstrumentKind binary_kind(InstrumentKind kind) {
+    switch (kind) {
+    case InstrumentKind::Future: return BinaryInstrumentKind::Future;
+    case InstrumentKind::Option: return BinaryInstrumentKind::Option;
+    case InstrumentKind::Spot: return BinaryInstrumentKind::Spot;
+    case InstrumentKind::FutureCombo: return BinaryInstrumentKind::FutureCombo;
+    case InstrumentKind::OptionCombo: return BinaryInstrumentKind::OptionCombo;
+    default: return BinaryInstrumentKind::Unknown;
+    }
+}
+
+uint8_t* store_levels(uint8_t* out, const std::vector<BookLevelUpdate>& levels) {
+    for (const BookLevelUpdate& level : levels) {
+        store_le<int64_t>(out, to_scaled(level.price));
+        store_le<int64_t>(out + 8, level.action == BookAction::Delete ? 0 : to_scaled(level.amount));
+        out += kBinaryBookLevelSize;
+    }
+    return out;
+}
+
+}
+
+void encode_binary_book(std::string& out, InstrumentId instrument, const BookUpdate& update) {
+    size_t length = kBinaryBookLevelsOffset + (update.bids.size() + update.asks.size()) * kBinaryBookLevelSize;
+    uint8_t* body = append_binary_message(out,
+        update.is_snapshot ? BinaryMessageType::BookSnapshot : BinaryMessageType::BookDelta,
+        instrument, update.timestamp, length);
+    store_le<int64_t>(body, update.change_id);
+    store_le<int64_t>(body + 8, update.is_snapshot ? 0 : update.prev_change_id);
+    store_le<uint32_t>(body + 16, static_cast<uint32_t>(update.bids.size()));
+    store_le<uint32_t>(body + 20, static_cast<uint32_t>(update.asks.size()));
+    store_levels(store_levels(body + 24, update.bids), update.asks);
+}
+
+void encode_binary_top_of_book(std::string& out, InstrumentId instrument, const TickerUpdate& update) {
+    uint8_t* body = append_binary_message(out, BinaryMessageType::TopOfBook, instrument, update.timestamp,
+        kBinaryTopOfBookSize);
+    store_le<int64_t>(body, to_scaled(update.best_bid_price));
+    store_le<int64_t>(body + 8, to_scaled(update.best_bid_amount));
+    store_le<int64_t>(body + 16, to_scaled(update.best_ask_price));
+    store_le<int64_t>(body + 24, to_scaled(update.best_ask_amount));
+    store_le<int64_t>(body + 32, to_scaled(update.last_price));
+    store_le<int64_t>(body + 40, to_scaled(update.mark_price));
+    store_le<int64_t>(body + 48, to_scaled(update.index_price));
+}
+
+void encode_binary_trades(std::string& out, InstrumentId instrument, const TradesUpdate& update) {
+    for (const TradeEvent& trade : update.trades) {
+        uint8_t* body = append_binary_message(out, BinaryMessageType::Trade, instrument, trade.timestamp,
+            kBinaryTradeSize);
+        store_le<int64_t>(body, to_scaled(trade.price));
+        store_le<int64_t>(body + 8, to_scaled(trade.amount));
+        store_le<int64_t>(body + 16, trade.trade_seq);
+        body[24] = static_cast<uint8_t>(binary_side(trade.direction));
+    }
+}
+
+void encode_binary_analytics(std::string& out, InstrumentId instrument, int64_t timestamp,
+    const BookAnalytics& analytics) {
+    uint8_t* body = append_binary_message(out, BinaryMessageType::Analytics, instrument, timestamp,
+        kBinaryAnalyticsSize);
+    store_le<int64_t>(body, to_scaled(analytics.mid));
+    store_le<int64_t>(body + 8, to_scaled(analytics.spread));
+    store_le<int64_t>(body + 16, to_scaled(analytics.microprice));
+    store_le<int64_t>(body + 24, to_scaled(analytics.imbalance));
+    store_le<int64_t>(body + 32, to_scaled(analytics.bid_vwap));
+    store_le<int64_t>(body + 40, to_scaled(analytics.ask_vwap));
+    store_le<int64_t>(body + 48, to_scaled(analytics.vwap_size));
+    store_le<uint32_t>(body + 56, analytics.imbalance_levels);
+}
+
+void encode_binary_orders(std::string& out, const InstrumentRegistry& instruments, const OrdersUpdate& update) {
+    for (const OrderEvent& order : update.orders) {
+        InstrumentId instrument = instruments.find(order.instrument_name);
+        if (instrument == kInvalidInstrument) {
+            continue;
+        }
+        encode_binary_instrument(out, instrument, instruments.info(instrument));
+        uint8_t* body = append_binary_message(out, BinaryMessageType::Order, instrument,
+            order.last_update_timestamp, kBinaryOrderSize);
+        store_le<int64_t>(body, to_scaled(order.price));
+        store_le<int64_t>(body + 8, to_scaled(order.amount));
+        store_le<int64_t>(body + 16, to_scaled(order.filled_amount));
+        store_le<int64_t>(body + 24, to_scaled(order.average_price));
+        body[32] = static_cast<uint8_t>(binary_side(order.direction));
+        body[33] = static_cast<uint8_t>(binary_state(order.order_state));
+        body[34] = static_cast<uint8_t>(binary_type(order.order_type));
+        store_text(body + 35, body + 40, order.order_id, kBinaryOrderIdCapacity);
+    }
+}
+
+void encode_binary_instrument(std::string& out, InstrumentId instrument, const InstrumentInfo& info) {
+    uint8_t* body = append_binary_message(out, BinaryMessageType::Instrument, instrument, 0, kBinaryInstrumentSize);
+    store_le<int64_t>(body, to_scaled(info.tick_size));
+    store_le<int64_t>(body + 8, to_scaled(info.contract_size));
+    store_le<int64_t>(body + 16, to_scaled(info.strike));
+    store_le<int64_t>(body + 24, info.expiration_timestamp);
+    body[32] = static_cast<uint8_t>(binary_kind(info.kind));
+    body[33] = static_cast<uint8_t>((info.is_call ? 1 : 0) | (info.inverse ? 2 : 0));
+    store_text(body + 34, body + 40, info.name, kBinaryNameCapacity);
+}
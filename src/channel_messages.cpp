@@ -0,0 +1,62 @@
+#include "channel_messages.h"
+
+namespace {
+
+// Splits on '.' into at most N parts; returns the part count
+template <size_t N>
+size_t split_channel(std::string_view channel, std::string_view (&parts)[N]) {
+    size_t count = 0;
+    while (count < N) {
+        size_t dot = channel.find('.');
+        parts[count++] = channel.substr(0, dot);
+        if (dot == std::string_view::npos) {
+            return count;
+        }
+        channel.remove_prefix(dot + 1);
+    }
+    return N + 1;
+}
+
+}
+
+bool parse_channel(std::string_view channel, ChannelRoute& route) {
+    route = ChannelRoute();
+    route.channel = std::string(channel);
+
+    std::string_view parts[6];
+    size_t count = split_channel(channel, parts);
+
+    if (parts[0] == "user" && count >= 4 && count <= 5) {
+        if (parts[1] == "orders") {
+            route.family = ChannelFamily::UserOrders;
+        }
+        else if (parts[1] == "trades") {
+            route.family = ChannelFamily::UserTrades;
+        }
+        if (count == 4) {
+            route.instrument = std::string(parts[2]);
+        }
+        route.interval = std::string(parts[count - 1]);
+    }
+    else if (parts[0] == "book" && count == 3) {
+        // Grouped books (book.<instrument>.<group>.<depth>.<interval>) carry
+        // plain snapshots and stay on the generic handler path
+        route.family = ChannelFamily::Book;
+        route.instrument = std::string(parts[1]);
+        route.interval = std::string(parts[2]);
+    }
+    else if (parts[0] == "ticker" && count == 3) {
+        route.family = ChannelFamily::Ticker;
+        route.instrument = std::string(parts[1]);
+        route.interval = std::string(parts[2]);
+    }
+    else if (parts[0] == "trades" && (count == 3 || count == 4)) {
+        route.family = ChannelFamily::Trades;
+        if (count == 3) {
+            route.instrument = std::string(parts[1]);
+        }
+        route.interval = std::string(parts[count - 1]);
+    }
+
+    return route.family != ChannelFamily::Unknown;
+}
@@ -0,0 +1,143 @@
+#include "channel_router.h"
+#include <algorithm>
+#include <cstring>
+
+ChannelTable::ChannelTable(std::vector<ChannelEntry> entries, uint64_t version)
+    : entries_(std::move(entries)), version_(version) {
+    // Load factor stays at or below one half so probe chains remain short
+    size_t capacity = 16;
+    while (capacity < entries_.size() * 2) {
+        capacity <<= 1;
+    }
+    slots_.resize(capacity);
+    mask_ = capacity - 1;
+
+    for (uint32_t id = 0; id < entries_.size(); ++id) {
+        const std::string& channel = entries_[id].route.channel;
+        if (channel.empty()) {
+            continue;
+        }
+        uint64_t h = hash(channel);
+        size_t index = h & mask_;
+        while (slots_[index].id != kNoChannel) {
+            index = (index + 1) & mask_;
+        }
+        slots_[index].hash = h;
+        slots_[index].id = id;
+    }
+}
+
+uint32_t ChannelTable::find(std::string_view channel) const {
+    uint64_t h = hash(channel);
+    for (size_t index = h & mask_;; index = (index + 1) & mask_) {
+        const Slot& slot = slots_[index];
+        if (slot.id == kNoChannel) {
+            return kNoChannel;
+        }
+        if (slot.hash == h) {
+            const std::string& key = entries_[slot.id].route.channel;
+            if (key.size() == channel.size() && std::memcmp(key.data(), channel.data(), key.size()) == 0) {
+                return slot.id;
+            }
+        }
+    }
+}
+
+uint64_t ChannelTable::hash(std::string_view channel) {
+    // FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+    for (char c : channel) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+ChannelRouter::ChannelRouter()
+    : current_(std::make_shared<ChannelTable>(std::vector<ChannelEntry>(), 0)),
+    published_(current_.get()) {}
+
+uint32_t ChannelRouter::set_route(const ChannelRoute& route) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    uint32_t id = find_or_allocate(route.channel);
+    entries_[id].route = route;
+    entries_[id].route.channel_id = id;
+    publish();
+    return id;
+}
+
+void ChannelRouter::set_routes(const std::vector<ChannelRoute>& routes) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    for (const ChannelRoute& route : routes) {
+        uint32_t id = find_or_allocate(route.channel);
+        entries_[id].route = route;
+        entries_[id].route.channel_id = id;
+    }
+    publish();
+}
+
+uint32_t ChannelRouter::set_handler(const std::string& channel, std::function<void(const json&)> handler) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    uint32_t id = find_or_allocate(channel);
+    entries_[id].handler = handler;
+    publish();
+    return id;
+}
+
+void ChannelRouter::remove_route(const std::string& channel) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    for (uint32_t id = 0; id < entries_.size(); ++id) {
+        ChannelEntry& entry = entries_[id];
+        if (entry.route.channel != channel) {
+            continue;
+        }
+        entry.route.family = ChannelFamily::Unknown;
+        if (!entry.handler) {
+            // Nothing left on this channel; recycle the ID
+            entry = ChannelEntry();
+            free_ids_.push_back(id);
+        }
+        publish();
+        return;
+    }
+}
+
+const ChannelTable& ChannelRouter::acquire() {
+    const ChannelTable* table = published_.load(std::memory_order_acquire);
+    reader_version_.store(table->version(), std::memory_order_release);
+    return *table;
+}
+
+uint32_t ChannelRouter::find_or_allocate(const std::string& channel) {
+    for (uint32_t id = 0; id < entries_.size(); ++id) {
+        if (entries_[id].route.channel == channel) {
+            return id;
+        }
+    }
+
+    uint32_t id;
+    if (!free_ids_.empty()) {
+        id = free_ids_.back();
+        free_ids_.pop_back();
+    }
+    else {
+        id = static_cast<uint32_t>(entries_.size());
+        entries_.emplace_back();
+    }
+    entries_[id].route.channel = channel;
+    entries_[id].route.channel_id = id;
+    return id;
+}
+
+void ChannelRouter::publish() {
+    retired_.push_back(current_);
+    current_ = std::make_shared<ChannelTable>(entries_, ++version_);
+    published_.store(current_.get(), std::memory_order_release);
+
+    // The reader announces the version it loaded before using it, so every
+    // table older than that announcement is unreachable
+    uint64_t in_use = reader_version_.load(std::memory_order_acquire);
+    retired_.erase(std::remove_if(retired_.begin(), retired_.end(),
+        [in_use](const std::shared_ptr<const ChannelTable>& table) { return table->version() < in_use; }),
+        retired_.end());
+}
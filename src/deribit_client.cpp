@@ -16,8 +16,29 @@
 #include <boost/asio.hpp>
 #include <boost/asio/ssl/context.hpp>
 
-DeribitClient::DeribitClient(const std::string& client_id, const std::string& client_secret)
-    : client_id_(client_id), client_secret_(client_secret) {
+namespace {
+
+// Order entry encodes into a per-thread buffer instead of a json DOM
+thread_local OrderEncoder order_encoder;
+
+// Frames handed to websocketpp per drain before other I/O gets a turn
+const size_t kMaxOutboundBatch = 64;
+
+SendPriority priority_for(std::string_view method) {
+    if (method.compare(0, 14, "private/cancel") == 0) {
+        return SendPriority::Cancel;
+    }
+    if (method == "private/buy" || method == "private/sell" || method == "private/edit" ||
+        method == "private/mass_quote") {
+        return SendPriority::Order;
+    }
+    return SendPriority::Other;
+}
+
+}
+
+DeribitClient::DeribitClient(const std::string& client_id, const std::string& client_secret, InstrumentRegistry& instruments)
+    : client_id_(client_id), client_secret_(client_secret), instruments_(instruments) {
 
     client_ = std::make_unique<WebsocketClient>();
 
@@ -33,6 +54,10 @@ DeribitClient::DeribitClient(const std::string& client_id, const std::string& cl
     client_->set_close_handler(std::bind(&DeribitClient::on_close, this, std::placeholders::_1));
     client_->set_fail_handler(std::bind(&DeribitClient::on_fail, this, std::placeholders::_1));
 
+    rate_limiter_.set_drop_handler([this](int64_t request_id, const char* reason) {
+        fail_request(request_id, reason);
+        });
+
     client_->set_tls_init_handler([](websocketpp::connection_hdl hdl) {
         namespace asio = websocketpp::lib::asio;
 
@@ -64,6 +89,65 @@ DeribitClient::DeribitClient(const std::string& client_id, const std::string& cl
 
 DeribitClient::~DeribitClient() {
     disconnect();
+    stop_io();
+    stop_processing();
+}
+
+void DeribitClient::set_pipeline_config(const PipelineConfig& config) {
+    pipeline_config_ = config;
+}
+
+void DeribitClient::set_rate_limit_config(const RateLimitConfig& config) {
+    rate_limiter_.configure(config);
+}
+
+void DeribitClient::set_event_loop_config(const EventLoopConfig& config) {
+    event_loop_config_ = config;
+    event_loop_mode_.store(config.mode, std::memory_order_relaxed);
+}
+
+void DeribitClient::set_event_loop_mode(EventLoopMode mode) {
+    if (event_loop_mode_.exchange(mode) == mode) {
+        return;
+    }
+    // Wake both loops so a sleeping thread notices the change immediately
+    client_->get_io_service().post([]() {});
+    std::lock_guard<std::mutex> lock(processor_mutex_);
+    processor_cv_.notify_one();
+}
+
+EventLoopMode DeribitClient::event_loop_mode() const {
+    return event_loop_mode_.load(std::memory_order_relaxed);
+}
+
+PipelineStats DeribitClient::pipeline_stats() const {
+    PipelineStats stats;
+    stats.received = frames_received_.load(std::memory_order_relaxed);
+    stats.processed = frames_processed_.load(std::memory_order_relaxed);
+    stats.dropped = frames_dropped_.load(std::memory_order_relaxed);
+    stats.depth = inbound_ ? inbound_->size() : 0;
+    stats.high_water = ring_high_water_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+PendingRequestStats DeribitClient::request_stats() const {
+    return pending_.stats();
+}
+
+LatencyHistogram::Summary DeribitClient::request_latency() const {
+    return pending_.latency().summary();
+}
+
+OutboundStats DeribitClient::outbound_stats() const {
+    return outbound_.stats();
+}
+
+LatencyHistogram::Summary DeribitClient::outbound_latency() const {
+    return outbound_.latency().summary();
+}
+
+RateLimitStats DeribitClient::rate_limit_stats() const {
+    return rate_limiter_.stats();
 }
 
 bool DeribitClient::connect() {
@@ -81,11 +165,13 @@ bool DeribitClient::connect() {
         }
 
         connection_ = con->get_handle();
+        start_processing();
         client_->connect(con);
 
-        // Start the ASIO io_service run loop in a separate thread
-        websocketpp::lib::thread asio_thread(&WebsocketClient::run, client_.get());
-        asio_thread.detach();
+        // Start the ASIO event loop in a separate thread
+        if (!io_running_.exchange(true)) {
+            io_thread_ = std::thread(&DeribitClient::io_loop, this);
+        }
         return true;
     }
     catch (const std::exception& e) {
@@ -151,23 +237,85 @@ void DeribitClient::authenticate() {
 }
 
 void DeribitClient::subscribe(const std::string& channel) {
+    ChannelRoute route;
+    if (parse_channel(channel, route)) {
+        if (!route.instrument.empty()) {
+            route.instrument_id = instruments_.intern(route.instrument);
+        }
+        router_.set_route(route);
+    }
+
     json params = {
         {"channels", {channel}}
     };
 
-    send_request("public/subscribe", params);
+    // user.* channels are private and need the authenticated endpoint
+    send_request(channel.compare(0, 5, "user.") == 0 ? "private/subscribe" : "public/subscribe", params);
+}
+
+void DeribitClient::subscribe(const std::vector<std::string>& channels) {
+    if (channels.empty()) {
+        return;
+    }
+    std::vector<ChannelRoute> routes;
+    routes.reserve(channels.size());
+    for (const std::string& channel : channels) {
+        ChannelRoute route;
+        if (parse_channel(channel, route)) {
+            if (!route.instrument.empty()) {
+                route.instrument_id = instruments_.intern(route.instrument);
+            }
+            routes.push_back(std::move(route));
+        }
+    }
+    router_.set_routes(routes);
+
+    json params = {
+        {"channels", channels}
+    };
+
+    send_request(channels.front().compare(0, 5, "user.") == 0 ? "private/subscribe" : "public/subscribe", params);
 }
 
 void DeribitClient::unsubscribe(const std::string& channel) {
+    router_.remove_route(channel);
+
     json params = {
         {"channels", {channel}}
     };
 
-    send_request("public/unsubscribe", params);
+    send_request(channel.compare(0, 5, "user.") == 0 ? "private/unsubscribe" : "public/unsubscribe", params);
 }
 
-void DeribitClient::place_order(const std::string& instrument, double amount, double price,
-    const std::string& type, const std::string& side) {
+RiskReject DeribitClient::place_order(InstrumentId instrument_id, double amount, double price,
+    const std::string& type, const std::string& side, const std::string& label,
+    std::function<void(const json&)> handler, const std::function<void()>& on_accepted) {
+    if (instrument_id >= InstrumentRegistry::kMaxInstruments) {
+        return RiskReject::InvalidOrder;
+    }
+    const std::string& instrument = instruments_.name(instrument_id);
+    if (risk_gate_) {
+        RiskReject verdict = risk_gate_->check_order(instrument_id, parse_order_side(side), amount, price);
+        if (verdict != RiskReject::None) {
+            std::cerr << "Order on " << instrument << " rejected by risk gate: " << to_string(verdict) << std::endl;
+            return verdict;
+        }
+    }
+
+    if (!handler) {
+        handler = [](const json& response) {
+            std::cout << "Order response: " << response.dump() << std::endl;
+            };
+    }
+    if (on_accepted) {
+        on_accepted();
+    }
+
+    if (order_encoder.encode_order(side, instrument, amount, price, type, label)) {
+        send_encoded(order_encoder, handler);
+        return RiskReject::None;
+    }
+
     json params = {
         {"instrument_name", instrument},
         {"amount", amount},
@@ -179,45 +327,147 @@ void DeribitClient::place_order(const std::string& instrument, double amount, do
         params["price"] = price;
     }
 
-    send_request("private/" + side, params, [](const json& response) {
-        std::cout << "Order response: " << response.dump() << std::endl;
-        });
+    if (!label.empty()) {
+        params["label"] = label;
+    }
+
+    send_request("private/" + side, params, handler);
+    return RiskReject::None;
 }
 
 void DeribitClient::cancel_order(const std::string& order_id) {
+    auto handler = [](const json& response) {
+        std::cout << "Cancel response: " << response.dump() << std::endl;
+        };
+
+    // Keyed by order so that admitting it drops edits still held back for it
+    if (order_encoder.encode_cancel(order_id)) {
+        send_encoded(order_encoder, handler, PendingRequestTable::kDefaultTimeoutNs, order_id);
+        return;
+    }
+
     json params = {
         {"order_id", order_id}
     };
 
-    send_request("private/cancel", params, [](const json& response) {
-        std::cout << "Cancel response: " << response.dump() << std::endl;
-        });
+    send_request("private/cancel", params, handler);
 }
 
-void DeribitClient::modify_order(const std::string& order_id, double amount, double price) {
+RiskReject DeribitClient::modify_order(const std::string& order_id, double amount, double price) {
+    if (risk_gate_) {
+        RiskReject verdict = risk_gate_->check_edit(order_id, amount, price);
+        if (verdict != RiskReject::None) {
+            std::cerr << "Edit of " << order_id << " rejected by risk gate: " << to_string(verdict) << std::endl;
+            return verdict;
+        }
+    }
+
+    auto handler = [](const json& response) {
+        std::cout << "Modify response: " << response.dump() << std::endl;
+        };
+
+    // Edits of one order held back by the rate limiter collapse into the newest
+    if (order_encoder.encode_edit(order_id, amount, price)) {
+        send_encoded(order_encoder, handler, PendingRequestTable::kDefaultTimeoutNs, order_id);
+        return RiskReject::None;
+    }
+
     json params = {
         {"order_id", order_id},
         {"amount", amount},
         {"price", price}
     };
 
-    send_request("private/edit", params, [](const json& response) {
-        std::cout << "Modify response: " << response.dump() << std::endl;
-        });
+    send_request("private/edit", params, handler);
+    return RiskReject::None;
 }
 
-void DeribitClient::get_orderbook(const std::string& instrument, int depth) {
+void DeribitClient::cancel_all(std::function<void(const json&)> handler) {
+    json params = {
+        {"detailed", true}
+    };
+
+    send_request("private/cancel_all", params, handler);
+}
+
+void DeribitClient::cancel_all_by_instrument(const std::string& instrument, std::function<void(const json&)> handler) {
     json params = {
         {"instrument_name", instrument},
-        {"depth", depth}
+        {"detailed", true}
     };
 
-    send_request("public/get_order_book", params, [](const json& response) {
+    send_request("private/cancel_all_by_instrument", params, handler);
+}
+
+void DeribitClient::cancel_by_label(const std::string& label, std::function<void(const json&)> handler) {
+    json params = {
+        {"label", label},
+        {"detailed", true}
+    };
+
+    send_request("private/cancel_by_label", params, handler);
+}
+
+void DeribitClient::mass_quote(const std::string& quote_id, const std::vector<MassQuoteEntry>& quotes,
+    std::function<void(const json&)> handler, const std::string& mmp_group) {
+    json entries = json::array();
+    for (const auto& quote : quotes) {
+        json entry = {
+            {"instrument_name", quote.instrument}
+        };
+        if (quote.bid_amount > 0) {
+            entry["bid"] = { {"price", quote.bid_price}, {"amount", quote.bid_amount} };
+        }
+        if (quote.ask_amount > 0) {
+            entry["ask"] = { {"price", quote.ask_price}, {"amount", quote.ask_amount} };
+        }
+        entries.push_back(entry);
+    }
+
+    json params = {
+        {"quote_id", quote_id},
+        {"detailed", true},
+        {"quotes", entries}
+    };
+
+    if (!mmp_group.empty()) {
+        params["mmp_group"] = mmp_group;
+    }
+
+    send_request("private/mass_quote", params, handler);
+}
+
+void DeribitClient::get_orderbook(const std::string& instrument, int depth) {
+    get_orderbook(instrument, depth, [](const json& response) {
         std::cout << "Orderbook: " << response.dump(2) << std::endl;
         });
 }
 
+void DeribitClient::get_orderbook(const std::string& instrument, int depth, std::function<void(const json&)> handler) {
+    json params = {
+        {"instrument_name", instrument},
+        {"depth", depth}
+    };
+
+    send_request("public/get_order_book", params, handler);
+}
+
 void DeribitClient::get_positions(const std::string& currency, const std::string& kind) {
+    std::string requestDescription = "Positions";
+    if (!currency.empty()) {
+        requestDescription = currency + " " + requestDescription;
+    }
+    if (!kind.empty()) {
+        requestDescription = kind + " " + requestDescription;
+    }
+
+    get_positions(currency, kind, [requestDescription](const json& response) {
+        std::cout << requestDescription << ": " << response.dump(2) << std::endl;
+        });
+}
+
+void DeribitClient::get_positions(const std::string& currency, const std::string& kind,
+    std::function<void(const json&)> handler) {
     json params = {};
 
     if (!currency.empty()) {
@@ -228,21 +478,25 @@ void DeribitClient::get_positions(const std::string& currency, const std::string
         params["kind"] = kind;
     }
 
-    std::string requestDescription = "Positions";
-    if (!currency.empty()) {
-        requestDescription = currency + " " + requestDescription;
-    }
+    send_request("private/get_positions", params, handler);
+}
+
+void DeribitClient::get_instruments(const std::string& currency, const std::string& kind,
+    std::function<void(const json&)> handler) {
+    json params = {
+        {"currency", currency},
+        {"expired", false}
+    };
+
     if (!kind.empty()) {
-        requestDescription = kind + " " + requestDescription;
+        params["kind"] = kind;
     }
 
-    send_request("private/get_positions", params, [requestDescription](const json& response) {
-        std::cout << requestDescription << ": " << response.dump(2) << std::endl;
-        });
+    send_request("public/get_instruments", params, handler);
 }
 
 void DeribitClient::register_message_handler(const std::string& channel, MessageHandler handler) {
-    message_handlers_[channel] = handler;
+    router_.set_handler(channel, handler);
 }
 
 void DeribitClient::on_open(websocketpp::connection_hdl hdl) {
@@ -251,24 +505,208 @@ void DeribitClient::on_open(websocketpp::connection_hdl hdl) {
 }
 
 void DeribitClient::on_message(websocketpp::connection_hdl hdl, WebsocketClient::message_ptr msg) {
+    InboundFrame frame;
+    frame.message = std::move(msg);
+    frame.receive_ns = monotonic_time_ns();
+    push_inbound(std::move(frame));
+}
+
+void DeribitClient::push_inbound(InboundFrame&& frame) {
+    frames_received_.fetch_add(1, std::memory_order_relaxed);
+
+    while (!inbound_->try_push(std::move(frame))) {
+        if (pipeline_config_.overflow_policy == OverflowPolicy::Drop) {
+            frames_dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (pipeline_config_.overflow_policy == OverflowPolicy::Spin) {
+            cpu_relax();
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+
+    size_t depth = inbound_->size();
+    if (depth > ring_high_water_.load(std::memory_order_relaxed)) {
+        ring_high_water_.store(depth, std::memory_order_relaxed);
+    }
+
+    // Pairs with the fence in processing_loop so a parked consumer is always woken
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (processor_sleeping_.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(processor_mutex_);
+        processor_cv_.notify_one();
+    }
+}
+
+void DeribitClient::post(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(posted_mutex_);
+        posted_.push_back(std::move(task));
+        has_posted_.store(true, std::memory_order_release);
+    }
+
+    // Pairs with the fence in processing_loop so a parked consumer is always woken
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (processor_sleeping_.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(processor_mutex_);
+        processor_cv_.notify_one();
+    }
+}
+
+void DeribitClient::post_after(long delay_ms, std::function<void()> task) {
+    client_->set_timer(delay_ms, [this, task](const websocketpp::lib::error_code& ec) {
+        if (!ec) {
+            post(task);
+        }
+        });
+}
+
+void DeribitClient::run_posted() {
+    std::vector<std::function<void()>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(posted_mutex_);
+        tasks.swap(posted_);
+        has_posted_.store(false, std::memory_order_relaxed);
+    }
+    for (auto& task : tasks) {
+        task();
+    }
+}
+
+void DeribitClient::io_loop() {
+    const ThreadTuning& tuning = event_loop_config_.io_thread;
+    if (tuning.cpu >= 0 && !pin_current_thread(tuning.cpu)) {
+        std::cerr << "Failed to pin I/O thread to CPU " << tuning.cpu << std::endl;
+    }
+    if (tuning.realtime && !set_current_thread_realtime(tuning.priority)) {
+        std::cerr << "Failed to set real-time scheduling for I/O thread" << std::endl;
+    }
+
     try {
-        json response = json::parse(msg->get_payload());
+        // Ends like run() would: once the io_service has no work left
+        while (io_running_.load(std::memory_order_relaxed) && !client_->stopped()) {
+            if (event_loop_mode_.load(std::memory_order_relaxed) == EventLoopMode::BusyPoll) {
+                if (client_->poll() == 0) {
+                    cpu_relax();
+                }
+            }
+            else {
+                client_->run_one();
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Exception in I/O loop: " << e.what() << std::endl;
+    }
+}
 
-        if (response.contains("id")) {
-            int id = response["id"].get<int>();
-            auto it = response_handlers_.find(id);
-            if (it != response_handlers_.end()) {
-                it->second(response);
-                response_handlers_.erase(it);
+void DeribitClient::stop_io() {
+    if (!io_running_.exchange(false)) {
+        return;
+    }
+    client_->stop();
+    if (io_thread_.joinable()) {
+        io_thread_.join();
+    }
+}
+
+void DeribitClient::start_processing() {
+    if (processing_running_.exchange(true)) {
+        return;
+    }
+    inbound_ = std::make_unique<SpscRing<InboundFrame>>(pipeline_config_.ring_capacity);
+    processing_thread_ = std::thread(&DeribitClient::processing_loop, this);
+}
+
+void DeribitClient::stop_processing() {
+    if (!processing_running_.exchange(false)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(processor_mutex_);
+        processor_cv_.notify_one();
+    }
+    if (processing_thread_.joinable()) {
+        processing_thread_.join();
+    }
+}
+
+void DeribitClient::processing_loop() {
+    const ThreadTuning& tuning = event_loop_config_.processing_thread;
+    if (tuning.cpu >= 0 && !pin_current_thread(tuning.cpu)) {
+        std::cerr << "Failed to pin processing thread to CPU " << tuning.cpu << std::endl;
+    }
+    if (tuning.realtime && !set_current_thread_realtime(tuning.priority)) {
+        std::cerr << "Failed to set real-time scheduling for processing thread" << std::endl;
+    }
+
+    const int spin_iterations = 1000;
+    const uint64_t frames_per_timer_check = 256;
+    InboundFrame frame;
+    uint64_t frames = 0;
+
+    while (processing_running_.load(std::memory_order_acquire)) {
+        if (has_posted_.load(std::memory_order_acquire)) {
+            run_posted();
+        }
+        if (inbound_->try_pop(frame)) {
+            process_frame(frame);
+            frame.message.reset();
+            frame.synthetic_payload.clear();
+            frames_processed_.fetch_add(1, std::memory_order_relaxed);
+            if (++frames % frames_per_timer_check == 0) {
+                pending_.expire(frame.receive_ns);
             }
+            continue;
+        }
+
+        // The parked wait below is bounded, so deadlines are checked at least
+        // once per millisecond even without traffic
+        pending_.expire(monotonic_time_ns());
+
+        // Idle: spin briefly, then park until the I/O thread pushes again
+        bool found = false;
+        for (int i = 0; i < spin_iterations && !found; ++i) {
+            cpu_relax();
+            found = !inbound_->empty() || has_posted_.load(std::memory_order_relaxed);
+        }
+        if (found || event_loop_mode_.load(std::memory_order_relaxed) == EventLoopMode::BusyPoll) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(processor_mutex_);
+        processor_sleeping_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (inbound_->empty() && !has_posted_.load(std::memory_order_relaxed) &&
+            processing_running_.load(std::memory_order_acquire)) {
+            processor_cv_.wait_for(lock, std::chrono::milliseconds(1));
+        }
+        processor_sleeping_.store(false, std::memory_order_relaxed);
+    }
+}
+
+void DeribitClient::process_frame(const InboundFrame& frame) {
+    const std::string& payload = frame.message ? frame.message->get_payload() : frame.synthetic_payload;
+    try {
+        if (dispatch_fast(payload, frame.receive_ns)) {
+            return;
+        }
+
+        // DOM fallback for responses and channels without a streaming decoder
+        json response = json::parse(payload);
+
+        if (response.contains("id")) {
+            pending_.complete(response["id"].get<int64_t>(), response, frame.receive_ns);
         }
         else if (response.contains("params")) {
-            json params = response["params"];
+            const json& params = response["params"];
             if (params.contains("channel")) {
-                std::string channel = params["channel"].get<std::string>();
-                auto it = message_handlers_.find(channel);
-                if (it != message_handlers_.end()) {
-                    it->second(response);
+                const ChannelTable& table = router_.acquire();
+                uint32_t id = table.find(params["channel"].get_ref<const std::string&>());
+                if (id != ChannelTable::kNoChannel && table.entry(id).handler) {
+                    table.entry(id).handler(response);
                 }
             }
         }
@@ -278,6 +716,31 @@ void DeribitClient::on_message(websocketpp::connection_hdl hdl, WebsocketClient:
     }
 }
 
+bool DeribitClient::dispatch_fast(const std::string& payload, int64_t receive_ns) {
+    NotificationEnvelope envelope;
+    if (!decode_envelope(payload, envelope)) {
+        return false;
+    }
+
+    if (envelope.has_id) {
+        // Responses nobody waits for are dropped without parsing them
+        return !pending_.is_pending(envelope.id);
+    }
+
+    if (envelope.channel.empty() || !dispatcher_) {
+        return false;
+    }
+
+    const ChannelTable& table = router_.acquire();
+    uint32_t id = table.find(envelope.channel);
+    if (id == ChannelTable::kNoChannel || table.entry(id).route.family == ChannelFamily::Unknown) {
+        return false;
+    }
+
+    ChannelContext context{ table.entry(id).route, payload, receive_ns };
+    return dispatcher_->dispatch(context, envelope.data);
+}
+
 void DeribitClient::on_close(websocketpp::connection_hdl hdl) {
     std::cout << "Disconnected from Deribit" << std::endl;
 }
@@ -287,29 +750,154 @@ void DeribitClient::on_fail(websocketpp::connection_hdl hdl) {
 }
 
 void DeribitClient::send_request(const std::string& method, const json& params,
-    std::function<void(const json&)> handler) {
+    std::function<void(const json&)> handler, int64_t timeout_ns) {
     if (!is_connected()) {
-        std::cerr << "Not connected to Deribit" << std::endl;
+        reject_unsent(0, std::move(handler), method.c_str(), "not_connected");
         return;
     }
 
+    int64_t id;
+    bool registered = static_cast<bool>(handler);
+    if (registered) {
+        id = pending_.add(std::move(handler), [method](int64_t request_id) {
+            std::cerr << "Request " << request_id << " (" << method << ") timed out" << std::endl;
+            }, timeout_ns, monotonic_time_ns());
+        if (id == 0) {
+            reject_unsent(0, std::move(handler), method.c_str(), "too_many_in_flight");
+            return;
+        }
+    }
+    else {
+        id = pending_.next_id();
+    }
+
     json request = {
         {"jsonrpc", "2.0"},
-        {"id", ++request_id_},
+        {"id", id},
         {"method", method},
         {"params", params}
     };
 
-    if (handler) {
-        response_handlers_[request_id_] = handler;
+    if (!outbound_.push(priority_for(method), request.dump(), id, monotonic_time_ns())) {
+        reject_unsent(registered ? id : 0, nullptr, method.c_str(), "outbound_queue_full");
+        return;
     }
+    schedule_drain();
+}
 
-    try {
-        client_->send(connection_, request.dump(), websocketpp::frame::opcode::text);
+void DeribitClient::send_encoded(OrderEncoder& encoder, std::function<void(const json&)> handler,
+    int64_t timeout_ns, std::string_view merge_key) {
+    // Captures only the static method literal, so no allocation here
+    const char* method = encoder.method();
+    if (!is_connected()) {
+        reject_unsent(0, std::move(handler), method, "not_connected");
+        return;
     }
-    catch (const std::exception& e) {
-        std::cerr << "Error sending request: " << e.what() << std::endl;
+
+    int64_t id = pending_.add(std::move(handler), [method](int64_t request_id) {
+        std::cerr << "Request " << request_id << " (" << method << ") timed out" << std::endl;
+        }, timeout_ns, monotonic_time_ns());
+    if (id == 0) {
+        reject_unsent(0, std::move(handler), method, "too_many_in_flight");
+        return;
     }
+    encoder.set_id(id);
+
+    if (!outbound_.push(priority_for(method), encoder.frame(), id, monotonic_time_ns(), merge_key)) {
+        reject_unsent(id, nullptr, method, "outbound_queue_full");
+        return;
+    }
+    schedule_drain();
+}
+
+void DeribitClient::reject_unsent(int64_t request_id, std::function<void(const json&)> handler, const char* method,
+    const char* reason) {
+    std::cerr << "Request " << method << " not sent: " << reason << std::endl;
+    if (request_id == 0 && !handler) {
+        return;
+    }
+
+    // A registered request is completed through the table, which also frees
+    // its slot; otherwise the handler is answered directly
+    auto complete = [this, request_id, handler = std::move(handler), reason]() {
+        json response = PendingRequestTable::error_response(request_id, PendingRequestTable::kRequestNotSent, reason);
+        if (request_id != 0) {
+            pending_.complete(request_id, response, monotonic_time_ns());
+        }
+        else if (handler) {
+            handler(response);
+        }
+        };
+    // Responses are handled on the processing thread; with none running
+    // there is nothing to race with
+    if (processing_running_.load(std::memory_order_acquire)) {
+        post(std::move(complete));
+    }
+    else {
+        complete();
+    }
+}
+
+void DeribitClient::schedule_drain() {
+    // One drain in flight at a time; frames pushed meanwhile ride along
+    if (!drain_scheduled_.exchange(true, std::memory_order_acq_rel)) {
+        client_->get_io_service().post([this]() { drain_outbound(); });
+    }
+}
+
+void DeribitClient::drain_outbound() {
+    // Clearing the flag first means a push that finds it clear schedules
+    // another drain, and one that finds it set is visible to the pops below
+    drain_scheduled_.exchange(false, std::memory_order_acq_rel);
+
+    // websocketpp gathers every message queued while no write is in flight
+    // into a single async_write, so handing over the whole burst from one
+    // handler coalesces it into one transport write
+    // The rate limiter decides what may leave now and holds back the rest
+    OutboundFrame frame;
+    size_t batch = 0;
+    while (batch < kMaxOutboundBatch && rate_limiter_.next(outbound_, monotonic_time_ns(), frame)) {
+        std::string_view payload = frame.payload();
+        websocketpp::lib::error_code ec;
+        client_->send(connection_, payload.data(), payload.size(), websocketpp::frame::opcode::text, ec);
+        if (ec) {
+            std::cerr << "Error sending request: " << ec.message() << std::endl;
+        }
+        outbound_.record_sent(frame, monotonic_time_ns());
+        ++batch;
+    }
+    outbound_.record_batch(batch);
+
+    if (batch == kMaxOutboundBatch) {
+        schedule_drain();
+        return;
+    }
+
+    // Come back when credits for the first held-back frame have refilled
+    int64_t now = monotonic_time_ns();
+    int64_t release_ns = rate_limiter_.next_release_ns(now);
+    if (release_ns != 0 && !retry_timer_armed_) {
+        retry_timer_armed_ = true;
+        long delay_ms = static_cast<long>((release_ns - now) / 1000000) + 1;
+        client_->set_timer(delay_ms, [this](const websocketpp::lib::error_code& ec) {
+            retry_timer_armed_ = false;
+            if (!ec) {
+                schedule_drain();
+            }
+            });
+    }
+}
+
+void DeribitClient::fail_request(int64_t request_id, const char* reason) {
+    std::cerr << "Request " << request_id << " not sent: " << reason << std::endl;
+
+    // Answer it like Deribit would, through the inbound pipeline, so the
+    // handler still runs on the processing thread
+    InboundFrame frame;
+    frame.receive_ns = monotonic_time_ns();
+    frame.synthetic_payload =
+        PendingRequestTable::error_response(request_id, PendingRequestTable::kRequestNotSent, reason).dump();
+    push_inbound(std::move(frame));
 }
 
 std::string DeribitClient::generate_nonce() const {
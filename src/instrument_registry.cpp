@@ -0,0 +1,105 @@
+#include "instrument_registry.h"
+#include <iostream>
+
+namespace {
+
+bool same_metadata(const InstrumentInfo& a, const InstrumentInfo& b) {
+    return a.kind == b.kind && a.base_currency == b.base_currency && a.settlement_currency == b.settlement_currency &&
+        a.tick_size == b.tick_size && a.contract_size == b.contract_size &&
+        a.min_trade_amount == b.min_trade_amount && a.inverse == b.inverse && a.strike == b.strike &&
+        a.expiration_timestamp == b.expiration_timestamp && a.is_call == b.is_call;
+}
+
+InstrumentKind parse_kind(const std::string& kind) {
+    if (kind == "future") return InstrumentKind::Future;
+    if (kind == "option") return InstrumentKind::Option;
+    if (kind == "spot") return InstrumentKind::Spot;
+    if (kind == "future_combo") return InstrumentKind::FutureCombo;
+    if (kind == "option_combo") return InstrumentKind::OptionCombo;
+    return InstrumentKind::Unknown;
+}
+
+}
+
+const InstrumentInfo InstrumentRegistry::kNoInstrument;
+
+InstrumentRegistry::InstrumentRegistry()
+    : entries_(new std::atomic<const InstrumentInfo*>[kMaxInstruments]) {
+    for (size_t i = 0; i < kMaxInstruments; ++i) {
+        entries_[i].store(&kNoInstrument, std::memory_order_relaxed);
+    }
+}
+
+InstrumentId InstrumentRegistry::intern(const std::string& name) {
+    std::lock_guard<std::mutex> lock(names_mutex_);
+    auto it = ids_by_name_.find(name);
+    if (it != ids_by_name_.end()) {
+        return it->second;
+    }
+    InstrumentInfo info;
+    info.name = name;
+    return insert(info);
+}
+
+InstrumentId InstrumentRegistry::add(const InstrumentInfo& info) {
+    std::lock_guard<std::mutex> lock(names_mutex_);
+    auto it = ids_by_name_.find(info.name);
+    if (it == ids_by_name_.end()) {
+        return insert(info);
+    }
+    // Readers may hold the current entry, so changes go into a new one
+    InstrumentId id = it->second;
+    if (!same_metadata(*entries_[id].load(std::memory_order_relaxed), info)) {
+        storage_.push_back(std::make_unique<const InstrumentInfo>(info));
+        entries_[id].store(storage_.back().get(), std::memory_order_release);
+    }
+    return id;
+}
+
+InstrumentId InstrumentRegistry::find(std::string_view name) const {
+    std::lock_guard<std::mutex> lock(names_mutex_);
+    auto it = ids_by_name_.find(name);
+    return it != ids_by_name_.end() ? it->second : kInvalidInstrument;
+}
+
+size_t InstrumentRegistry::load_instruments(const json& result) {
+    size_t loaded = 0;
+    for (const auto& instrument : result) {
+        InstrumentInfo info;
+        info.name = instrument.value("instrument_name", "");
+        if (info.name.empty()) {
+            continue;
+        }
+        info.kind = parse_kind(instrument.value("kind", ""));
+        info.base_currency = instrument.value("base_currency", "");
+        info.settlement_currency = instrument.value("settlement_currency", "");
+        info.tick_size = instrument.value("tick_size", 0.0);
+        info.contract_size = instrument.value("contract_size", 0.0);
+        info.min_trade_amount = instrument.value("min_trade_amount", 0.0);
+        info.inverse = instrument.value("instrument_type", "") == "reversed";
+        if (info.kind == InstrumentKind::Option) {
+            info.strike = instrument.value("strike", 0.0);
+            info.expiration_timestamp = instrument.value("expiration_timestamp", int64_t(0));
+            info.is_call = instrument.value("option_type", "") == "call";
+        }
+
+        if (add(info) != kInvalidInstrument) {
+            ++loaded;
+        }
+    }
+    return loaded;
+}
+
+InstrumentId InstrumentRegistry::insert(const InstrumentInfo& info) {
+    size_t id = count_.load(std::memory_order_relaxed);
+    if (id >= kMaxInstruments) {
+        std::cerr << "Instrument registry full, cannot add " << info.name << std::endl;
+        return kInvalidInstrument;
+    }
+    storage_.push_back(std::make_unique<const InstrumentInfo>(info));
+    const InstrumentInfo* entry = storage_.back().get();
+    ids_by_name_.emplace(std::string_view(entry->name), static_cast<InstrumentId>(id));
+    entries_[id].store(entry, std::memory_order_release);
+    count_.store(id + 1, std::memory_order_release);
+    return static_cast<InstrumentId>(id);
+}
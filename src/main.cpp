@@ -1,36 +1,142 @@
+#include "binary_encoder.h"
 #include "deribit_client.h"
 #include "websocket_server.h"
 #include "order_manager.h"
 #include "market_data.h"
+#include "option_chain.h"
+#include "position_engine.h"
+#include "risk_gate.h"
+#include "subscription_manager.h"
+#include "utils.h"
+#include <algorithm>
 #include <iostream>
 #include <thread>
 #include <chrono>
 #include <nlohmann/json.hpp>
 #include <atomic>
-#include <mutex>
-#include <condition_variable>
+#include <future>
+#include <memory>
 
 using json = nlohmann::json;
 
 // Global variables for controlling the application flow
 std::atomic<bool> running(true);
-std::mutex orderbook_mutex;
-std::condition_variable orderbook_cv;
-bool orderbook_received = false;
-OrderBook latest_orderbook;
-std::string latest_instrument;
 
 // Forward declarations
 void print_menu();
-void handle_menu_choice(int choice, DeribitClient& deribit_client, OrderManager& order_manager, MarketData& market_data);
+void handle_menu_choice(int choice, DeribitClient& deribit_client, OrderManager& order_manager, MarketData& market_data,
+    InstrumentRegistry& instruments, RiskGate& risk_gate, PositionEngine& positions, OptionChainEngine& option_chain,
+    WebSocketServer& websocket_server, SubscriptionManager& subscriptions);
 void print_orderbook(const OrderBook& orderbook, const std::string& instrument);
-void handle_place_order(DeribitClient& deribit_client, OrderManager& order_manager);
+void print_book_analytics(const MarketData& market_data, InstrumentId instrument);
+BookUpdate parse_book_snapshot(const json& result);
+OrderBook orderbook_from_snapshot(const BookUpdate& snapshot);
+void request_book_snapshot(DeribitClient& deribit_client, MarketData& market_data, SubscriptionManager& subscriptions,
+    const ChannelRoute& route, int attempt = 0);
+
+// Handles decoded Deribit channel notifications on the client's processing
+// thread, which is fed from the I/O thread through the SPSC inbound ring
+struct FeedSink {
+    DeribitClient& deribit_client;
+    MarketData& market_data;
+    WebSocketServer& websocket_server;
+    SubscriptionManager& subscriptions;
+    OrderManager& order_manager;
+    InstrumentRegistry& instruments;
+    PositionEngine& positions;
+    OptionChainEngine& option_chain;
+
+    void on_channel(const ChannelContext& context, const BookUpdate& update) {
+        InstrumentId instrument = context.route.instrument_id;
+        BookUpdateResult result = market_data.apply_book_update(instrument, update);
+        if (result == BookUpdateResult::GapDetected) {
+            request_book_snapshot(deribit_client, market_data, subscriptions, context.route);
+        }
+        positions.on_book_update(instrument, market_data);
+
+        // Forward the original frame, or its binary encoding, to the clients subscribed to this channel;
+        // a client that loses a delta is resynced from the local book
+        websocket_server.publish(instrument, SubscriptionManager::stream_bit(context.route), context.frame,
+            [instrument, &update](std::string& out) { encode_binary_book(out, instrument, update); },
+            update.is_snapshot ? WebSocketServer::kSnapshot : WebSocketServer::kSequenced);
+        if (result == BookUpdateResult::Applied) {
+            subscriptions.publish_analytics(instrument, update.timestamp);
+        }
+    }
+
+    // Option tickers are only queued here; greeks are solved in batches
+    void on_channel(const ChannelContext& context, const TickerUpdate& update) {
+        InstrumentId instrument = context.route.instrument_id;
+        option_chain.on_ticker(instrument, update);
+        // Each ticker carries the full state, so a slow client only needs the newest
+        websocket_server.publish(instrument, SubscriptionManager::stream_bit(context.route), context.frame,
+            [instrument, &update](std::string& out) { encode_binary_top_of_book(out, instrument, update); },
+            SubscriptionManager::conflation_key(context.route));
+    }
+
+    void on_channel(const ChannelContext& context, const TradesUpdate& update) {
+        InstrumentId instrument = context.route.instrument_id;
+        websocket_server.publish(instrument, SubscriptionManager::stream_bit(context.route), context.frame,
+            [instrument, &update](std::string& out) { encode_binary_trades(out, instrument, update); });
+    }
+
+    // Private order and fill events drive the local order state machine
+    // and go out to every downstream client
+    void on_channel(const ChannelContext& context, const OrdersUpdate& update) {
+        websocket_server.broadcast(context.frame,
+            [this, &update](std::string& out) { encode_binary_orders(out, instruments, update); });
+        for (const auto& event : update.orders) {
+            order_manager.on_order_event(event, instruments, context.receive_ns);
+        }
+    }
+
+    void on_channel(const ChannelContext& context, const UserTradesUpdate& update) {
+        for (const auto& trade : update.trades) {
+            order_manager.on_user_trade(trade, context.receive_ns);
+
+            // Interned, with an allocation, only the first time a name is seen
+            InstrumentId instrument = instruments.find(trade.instrument_name);
+            if (instrument == kInvalidInstrument) {
+                instrument = instruments.intern(std::string(trade.instrument_name));
+            }
+            positions.on_fill(instrument, parse_order_side(trade.direction), trade.amount, trade.price,
+                trade.fee, trade.timestamp);
+
+            // Downstream clients get the updated position straight from the snapshot
+            Position position;
+            if (websocket_server.client_count() > 0 && positions.get_position(instrument, position)) {
+                json message = {
+                    {"type", "position"},
+                    {"instrument_name", trade.instrument_name},
+                    {"size", position.size},
+                    {"average_price", position.average_price},
+                    {"mark_price", position.mark_price},
+                    {"realized_pnl", position.realized_pnl},
+                    {"unrealized_pnl", position.unrealized_pnl}
+                };
+                // A slow client only needs the latest position per instrument
+                websocket_server.broadcast(WebSocketServer::make_frame(message.dump()), instrument);
+            }
+        }
+    }
+};
+
+void handle_place_order(DeribitClient& deribit_client, OrderManager& order_manager, InstrumentRegistry& instruments);
 void handle_cancel_order(DeribitClient& deribit_client);
 void handle_modify_order(DeribitClient& deribit_client);
+void print_risk_report(RiskGate& risk_gate);
+void print_positions(PositionEngine& positions, InstrumentRegistry& instruments);
+void handle_stream_option_chain(SubscriptionManager& subscriptions, OptionChainEngine& option_chain,
+    InstrumentRegistry& instruments);
+void print_option_greeks(OptionChainEngine& option_chain, InstrumentRegistry& instruments);
+void print_client_report(WebSocketServer& websocket_server, SubscriptionManager& subscriptions);
 void handle_get_positions(DeribitClient& deribit_client);
-void handle_get_orderbook(DeribitClient& deribit_client, MarketData& market_data);
-void handle_subscribe_instrument(DeribitClient& deribit_client, MarketData& market_data);
-void handle_unsubscribe_instrument(DeribitClient& deribit_client, MarketData& market_data);
+void handle_get_orderbook(DeribitClient& deribit_client, MarketData& market_data, InstrumentRegistry& instruments);
+void handle_subscribe_instrument(SubscriptionManager& subscriptions);
+void handle_unsubscribe_instrument(SubscriptionManager& subscriptions);
+void handle_bulk_cancel(DeribitClient& deribit_client, OrderManager& order_manager, InstrumentRegistry& instruments);
+void handle_mass_quote(DeribitClient& deribit_client, OrderManager& order_manager, InstrumentRegistry& instruments);
+void print_order_latency(OrderManager& order_manager, InstrumentRegistry& instruments);
 
 int main() {
     // Configuration
@@ -43,10 +149,45 @@ int main() {
     const std::string key_file = "PATh";
 
     // Initialize components
-    DeribitClient deribit_client(client_id, client_secret);
-    WebSocketServer websocket_server(websocket_port, cert_file, key_file);
+    InstrumentRegistry instruments;
+    DeribitClient deribit_client(client_id, client_secret, instruments);
+    // Slow downstream clients are conflated and bounded instead of buffering without limit
+    ClientQueueConfig client_queue_config;
+    client_queue_config.policy = SlowClientPolicy::Conflate;
+    client_queue_config.max_queued = 4096;
+    WebSocketServer websocket_server(websocket_port, cert_file, key_file, client_queue_config);
     OrderManager order_manager;
-    MarketData market_data;
+    MarketData market_data(instruments);
+    PositionEngine positions(instruments);
+
+    // Pre-trade checks on every order and edit; tighten per instrument with set_limits
+    RiskGate risk_gate(market_data, positions, order_manager);
+    RiskLimits risk_limits;
+    risk_limits.price_band = 0.05;
+    risk_limits.max_open_orders = 50;
+    risk_gate.set_default_limits(risk_limits);
+    deribit_client.set_risk_gate(&risk_gate);
+
+    // Implied vol and greeks for streamed options, solved every 100ms
+    OptionChainEngine option_chain(instruments, positions);
+
+    // Upstream channels are shared, and reference counted, between the console
+    // and downstream clients, which subscribe per instrument and channel
+    SubscriptionManager subscriptions(deribit_client, websocket_server, market_data, instruments);
+    websocket_server.register_message_handler([&subscriptions](const std::string& payload, websocketpp::connection_hdl hdl) {
+        subscriptions.on_client_message(payload, hdl);
+        });
+    websocket_server.register_close_handler([&subscriptions](websocketpp::connection_hdl hdl) {
+        subscriptions.on_client_close(hdl);
+        });
+    websocket_server.register_gap_handler([&subscriptions](websocketpp::connection_hdl hdl, InstrumentId instrument) {
+        subscriptions.on_client_gap(hdl, instrument);
+        });
+
+    // Decoded channel notifications are delivered to the sink
+    FeedSink feed_sink{ deribit_client, market_data, websocket_server, subscriptions, order_manager, instruments, positions,
+        option_chain };
+    deribit_client.set_channel_sink(feed_sink);
 
     // Connect to Deribit
     std::cout << "Connecting to Deribit..." << std::endl;
@@ -59,49 +200,45 @@ int main() {
     std::cout << "Authenticating..." << std::endl;
     std::this_thread::sleep_for(std::chrono::seconds(2));
 
+    // Load instrument metadata (tick sizes, contract sizes) before any book is built
+    std::cout << "Loading instruments..." << std::endl;
+    std::promise<void> instruments_loaded;
+    deribit_client.get_instruments("any", "", [&](const json& response) {
+        if (response.contains("result")) {
+            size_t count = instruments.load_instruments(response["result"]);
+            std::cout << "Loaded " << count << " instruments" << std::endl;
+        }
+        else {
+            std::cerr << "Failed to load instruments: " << response.dump() << std::endl;
+        }
+        instruments_loaded.set_value();
+        });
+    if (instruments_loaded.get_future().wait_for(std::chrono::seconds(10)) != std::future_status::ready) {
+        std::cerr << "Timeout loading instruments, using default tick sizes" << std::endl;
+    }
+    std::cout << "Option chain: " << option_chain.build() << " options" << std::endl;
+    option_chain.start();
+
+    // Exchange-side order lifecycle for every instrument
+    deribit_client.subscribe("user.orders.any.any.raw");
+    deribit_client.subscribe("user.trades.any.any.raw");
+
+    // Seed positions once; from here on fills keep them current
+    int64_t positions_requested_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    deribit_client.get_positions("", "", [&positions, positions_requested_ms](const json& response) {
+        if (!response.contains("result")) {
+            std::cerr << "Failed to load positions: " << response.dump() << std::endl;
+        }
+        positions.seed(response.contains("result") ? response["result"] : json::array(), positions_requested_ms);
+        });
+
     // Start WebSocket server in a separate thread
     std::thread server_thread([&websocket_server]() {
         websocket_server.start();
         });
     server_thread.detach();
 
-    // Register message handlers for orderbook updates
-    auto register_orderbook_handler = [&](const std::string& instrument) {
-        std::string channel = "book." + instrument + ".raw";
-        deribit_client.register_message_handler(channel, [&](const json& msg) {
-            if (msg.contains("params") && msg["params"].contains("data")) {
-                json data = msg["params"]["data"];
-                OrderBook orderbook;
-                orderbook.timestamp = data["timestamp"].get<int64_t>();
-
-                for (const auto& bid : data["bids"]) {
-                    orderbook.bids.push_back({ bid[0].get<double>(), bid[1].get<double>() });
-                }
-                for (const auto& ask : data["asks"]) {
-                    orderbook.asks.push_back({ ask[0].get<double>(), ask[1].get<double>() });
-                }
-
-                market_data.update_orderbook(instrument, orderbook);
-
-                // Store latest orderbook for display
-                {
-                    std::lock_guard<std::mutex> lock(orderbook_mutex);
-                    latest_orderbook = orderbook;
-                    latest_instrument = instrument;
-                    orderbook_received = true;
-                }
-                orderbook_cv.notify_one();
-
-                // Broadcast to WebSocket clients
-                websocket_server.broadcast(msg.dump());
-            }
-            });
-        };
-
-    // Register handlers for common instruments
-    register_orderbook_handler("BTC-PERPETUAL");
-    register_orderbook_handler("ETH-PERPETUAL");
-
     // Main menu loop
     int choice = 0;
     do {
@@ -113,12 +250,14 @@ int main() {
         std::cin.clear();
         std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 
-        handle_menu_choice(choice, deribit_client, order_manager, market_data);
+        handle_menu_choice(choice, deribit_client, order_manager, market_data, instruments, risk_gate, positions,
+            option_chain, websocket_server, subscriptions);
 
     } while (choice != 0 && running);
 
     // Clean up
     deribit_client.disconnect();
+    option_chain.stop();
     websocket_server.stop();
 
     std::cout << "Application terminated." << std::endl;
@@ -136,18 +275,29 @@ void print_menu() {
     std::cout << "7. Unsubscribe from Instrument\n";
     std::cout << "8. List All Orders\n";
     std::cout << "9. List Subscribed Instruments\n";
+    std::cout << "10. Toggle Busy-Poll Mode\n";
+    std::cout << "11. Bulk Cancel (all/instrument/label)\n";
+    std::cout << "12. Mass Quote\n";
+    std::cout << "13. Order Latency Report\n";
+    std::cout << "14. Risk Gate Report\n";
+    std::cout << "15. Local Positions & PnL\n";
+    std::cout << "16. Stream Option Chain\n";
+    std::cout << "17. Option Greeks & Portfolio Greeks\n";
+    std::cout << "18. Downstream Client Report\n";
     std::cout << "0. Exit\n";
     std::cout << "============================================\n";
 }
 
 void handle_menu_choice(int choice, DeribitClient& deribit_client,
-    OrderManager& order_manager, MarketData& market_data) {
+    OrderManager& order_manager, MarketData& market_data, InstrumentRegistry& instruments, RiskGate& risk_gate,
+    PositionEngine& positions, OptionChainEngine& option_chain, WebSocketServer& websocket_server,
+    SubscriptionManager& subscriptions) {
     switch (choice) {
     case 0:
         running = false;
         break;
     case 1:
-        handle_place_order(deribit_client,order_manager);
+        handle_place_order(deribit_client, order_manager, instruments);
         break;
     case 2:
         handle_cancel_order(deribit_client);
@@ -159,48 +309,82 @@ void handle_menu_choice(int choice, DeribitClient& deribit_client,
         handle_get_positions(deribit_client);
         break;
     case 5:
-        handle_get_orderbook(deribit_client, market_data);
+        handle_get_orderbook(deribit_client, market_data, instruments);
         break;
     case 6:
-        handle_subscribe_instrument(deribit_client, market_data);
+        handle_subscribe_instrument(subscriptions);
         break;
     case 7:
-        handle_unsubscribe_instrument(deribit_client, market_data);
+        handle_unsubscribe_instrument(subscriptions);
         break;
     case 8: {
-        std::vector<Order> orders = order_manager.get_orders();
-        std::cout << "\nAll Orders (" << orders.size() << "):\n";
-        for (const auto& order : orders) {
-            std::cout << "ID: " << order.id
-                << ", Instrument: " << order.instrument
-                << ", Side: " << order.side
-                << ", Type: " << order.type
+        size_t count = order_manager.size();
+        std::cout << "\nAll Orders (" << count << "):\n";
+        order_manager.for_each_order([&instruments](const Order& order) {
+            std::cout << "ID: " << order.id.view()
+                << ", Instrument: " << (order.instrument_id != kInvalidInstrument ? instruments.name(order.instrument_id) : "?")
+                << ", Side: " << to_string(order.side)
+                << ", Type: " << to_string(order.type)
                 << ", Price: " << order.price
                 << ", Amount: " << order.amount
-                << ", Status: " << order.status << std::endl;
-        }
-        if (orders.empty()) {
+                << ", Status: " << to_string(order.status);
+            if (!order.label.empty()) {
+                std::cout << ", Label: " << order.label.view();
+            }
+            std::cout << std::endl;
+            });
+        if (count == 0) {
             std::cout << "No orders found.\n";
         }
         break;
     }
     case 9: {
-        std::vector<std::string> instruments = market_data.get_subscribed_instruments();
-        std::cout << "\nSubscribed Instruments (" << instruments.size() << "):\n";
-        for (const auto& instrument : instruments) {
-            std::cout << "- " << instrument << std::endl;
+        std::vector<InstrumentId> subscribed = market_data.get_subscribed_instruments();
+        std::cout << "\nSubscribed Instruments (" << subscribed.size() << "):\n";
+        for (InstrumentId instrument : subscribed) {
+            std::cout << "- " << instruments.name(instrument) << std::endl;
         }
-        if (instruments.empty()) {
+        if (subscribed.empty()) {
             std::cout << "No subscriptions found.\n";
         }
         break;
     }
+    case 10: {
+        bool busy = deribit_client.event_loop_mode() == EventLoopMode::BusyPoll;
+        deribit_client.set_event_loop_mode(busy ? EventLoopMode::Blocking : EventLoopMode::BusyPoll);
+        std::cout << "Event loop mode: " << (busy ? "blocking" : "busy-poll") << std::endl;
+        break;
+    }
+    case 11:
+        handle_bulk_cancel(deribit_client, order_manager, instruments);
+        break;
+    case 12:
+        handle_mass_quote(deribit_client, order_manager, instruments);
+        break;
+    case 13:
+        print_order_latency(order_manager, instruments);
+        break;
+    case 14:
+        print_risk_report(risk_gate);
+        break;
+    case 15:
+        print_positions(positions, instruments);
+        break;
+    case 16:
+        handle_stream_option_chain(subscriptions, option_chain, instruments);
+        break;
+    case 17:
+        print_option_greeks(option_chain, instruments);
+        break;
+    case 18:
+        print_client_report(websocket_server, subscriptions);
+        break;
     default:
         std::cout << "Invalid choice. Please try again." << std::endl;
     }
 }
 
-void handle_place_order(DeribitClient& deribit_client, OrderManager& order_manager) {
+void handle_place_order(DeribitClient& deribit_client, OrderManager& order_manager, InstrumentRegistry& instruments) {
     std::string instrument, type, side;
     double amount, price;
 
@@ -222,24 +406,35 @@ void handle_place_order(DeribitClient& deribit_client, OrderManager& order_manag
         std::cin >> price;
     }
 
-    std::cout << "Placing order..." << std::endl;
-    deribit_client.place_order(instrument, amount, price, type, side);
+    // The label correlates exchange events with this order until Deribit
+    // assigns its ID; the exchange then drives every state change
+    static std::atomic<uint64_t> label_sequence{ 0 };
+    std::string label = "dts-" + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count()) + "-" + std::to_string(++label_sequence);
 
-    // Create a local order record and add it to the order manager
     Order new_order;
-    new_order.id = "completed" + std::to_string(std::chrono::system_clock::now().time_since_epoch().count()); // Temporary ID
-    new_order.instrument = instrument;
-    new_order.side = side;
-    new_order.type = type;
+    new_order.label.assign(label);
+    new_order.instrument_id = instruments.intern(instrument);
+    new_order.side = parse_order_side(side);
+    new_order.type = parse_order_type(type);
     new_order.amount = amount;
     new_order.price = price;
-    new_order.filled = 0;
-    new_order.status = "successfull";
-    new_order.timestamp = std::chrono::system_clock::now().time_since_epoch().count();
-
-    // Add the order to the order manager
-    order_manager.add_order(new_order);
-    std::cout << "Order added to local tracking with temporary ID: " << new_order.id << std::endl;
+    new_order.send_ns = monotonic_time_ns();
+
+    std::cout << "Placing order " << label << "..." << std::endl;
+    // Tracked once it passed the risk gate, so it does not count against its
+    // own open-order limit, and before it is queued, so no response can beat
+    // it. Exchange errors reject it; after a timeout or send failure it stays
+    // Pending until Deribit's own events say what became of it.
+    RiskReject verdict = deribit_client.place_order(new_order.instrument_id, amount, price, type, side, label,
+        [&order_manager, &instruments, label](const json& response) {
+            std::cout << "Order response: " << response.dump() << std::endl;
+            order_manager.on_place_response(label, response, instruments, monotonic_time_ns());
+        },
+        [&order_manager, &new_order] { order_manager.track_new_order(new_order); });
+    if (verdict != RiskReject::None) {
+        std::cout << "Order not sent: " << to_string(verdict) << std::endl;
+    }
 }
 
 void handle_cancel_order(DeribitClient& deribit_client) {
@@ -266,7 +461,290 @@ void handle_modify_order(DeribitClient& deribit_client) {
     std::cin >> price;
 
     std::cout << "Modifying order " << order_id << "..." << std::endl;
-    deribit_client.modify_order(order_id, amount, price);
+    RiskReject verdict = deribit_client.modify_order(order_id, amount, price);
+    if (verdict != RiskReject::None) {
+        std::cout << "Edit not sent: " << to_string(verdict) << std::endl;
+    }
+}
+
+void handle_bulk_cancel(DeribitClient& deribit_client, OrderManager& order_manager, InstrumentRegistry& instruments) {
+    int choice;
+
+    std::cout << "\nBulk Cancel Options:\n";
+    std::cout << "1. Cancel All Orders\n";
+    std::cout << "2. Cancel All Orders for Instrument\n";
+    std::cout << "3. Cancel Orders by Label\n";
+    std::cout << "Enter your choice: ";
+    std::cin >> choice;
+    std::cin.clear();
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+    // Every affected order is reconciled from the single response
+    auto reconcile = [&order_manager, &instruments](InstrumentId instrument, std::string label) {
+        return [&order_manager, &instruments, instrument, label](const json& response) {
+            if (!response.contains("result")) {
+                std::cerr << "Bulk cancel failed: " << response.dump() << std::endl;
+                return;
+            }
+            size_t updated = order_manager.apply_cancel_result(response["result"], instruments, instrument, label);
+            std::cout << "Bulk cancel done, " << updated << " orders updated" << std::endl;
+            };
+        };
+
+    switch (choice) {
+    case 1:
+        std::cout << "Cancelling all orders..." << std::endl;
+        deribit_client.cancel_all(reconcile(kInvalidInstrument, ""));
+        break;
+    case 2: {
+        std::string instrument;
+        std::cout << "Enter instrument (e.g., BTC-PERPETUAL): ";
+        std::getline(std::cin, instrument);
+
+        std::cout << "Cancelling all orders for " << instrument << "..." << std::endl;
+        deribit_client.cancel_all_by_instrument(instrument, reconcile(instruments.intern(instrument), ""));
+        break;
+    }
+    case 3: {
+        std::string label;
+        std::cout << "Enter label: ";
+        std::getline(std::cin, label);
+
+        std::cout << "Cancelling orders labelled " << label << "..." << std::endl;
+        deribit_client.cancel_by_label(label, reconcile(kInvalidInstrument, label));
+        break;
+    }
+    default:
+        std::cout << "Invalid choice." << std::endl;
+    }
+}
+
+void handle_mass_quote(DeribitClient& deribit_client, OrderManager& order_manager, InstrumentRegistry& instruments) {
+    std::string quote_id;
+    std::vector<MassQuoteEntry> quotes;
+
+    std::cout << "Enter quote ID: ";
+    std::getline(std::cin, quote_id);
+
+    while (true) {
+        MassQuoteEntry quote;
+        std::cout << "Enter instrument (empty to send): ";
+        std::getline(std::cin, quote.instrument);
+        if (quote.instrument.empty()) {
+            break;
+        }
+
+        std::cout << "Enter bid price and amount (amount 0 for no bid): ";
+        std::cin >> quote.bid_price >> quote.bid_amount;
+
+        std::cout << "Enter ask price and amount (amount 0 for no ask): ";
+        std::cin >> quote.ask_price >> quote.ask_amount;
+        std::cin.clear();
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+        quotes.push_back(quote);
+    }
+
+    if (quotes.empty()) {
+        std::cout << "No quotes entered." << std::endl;
+        return;
+    }
+
+    std::cout << "Sending " << quotes.size() << " quotes..." << std::endl;
+    deribit_client.mass_quote(quote_id, quotes, [&order_manager, &instruments](const json& response) {
+        if (!response.contains("result")) {
+            std::cerr << "Mass quote failed: " << response.dump() << std::endl;
+            return;
+        }
+        const json& result = response["result"];
+        size_t updated = result.contains("orders") ? order_manager.apply_order_reports(result["orders"], instruments) : 0;
+        std::cout << "Mass quote done, " << updated << " orders updated" << std::endl;
+        if (result.contains("errors") && !result["errors"].empty()) {
+            std::cerr << "Mass quote errors: " << result["errors"].dump() << std::endl;
+        }
+        });
+}
+
+void print_order_latency(OrderManager& order_manager, InstrumentRegistry& instruments) {
+    auto print = [](const char* stage, const LatencyHistogram::Summary& summary) {
+        std::cout << "  " << stage << ": n=" << summary.count
+            << " p50=" << summary.p50_ns / 1000 << "us"
+            << " p99=" << summary.p99_ns / 1000 << "us"
+            << " max=" << summary.max_ns / 1000 << "us\n";
+        };
+
+    bool any = false;
+    for (InstrumentId id = 0; id < instruments.size(); ++id) {
+        OrderLatencySummary summary;
+        if (!order_manager.order_latency(id, summary)) {
+            continue;
+        }
+        any = true;
+        std::cout << instruments.name(id) << "\n";
+        print("send -> ack", summary.ack);
+        print("send -> first fill", summary.first_fill);
+        print("send -> done", summary.done);
+    }
+    if (!any) {
+        std::cout << "No acknowledged orders yet.\n";
+    }
+    std::cout << "Ignored order events: " << order_manager.rejected_events() << std::endl;
+}
+
+void print_risk_report(RiskGate& risk_gate) {
+    RiskStats stats = risk_gate.stats();
+    std::cout << "\nRisk checks: " << stats.checked << ", rejected: " << stats.rejected << "\n";
+    for (size_t i = 1; i < kRiskRejectReasons; ++i) {
+        if (stats.by_reason[i] > 0) {
+            std::cout << "  " << to_string(static_cast<RiskReject>(i)) << ": " << stats.by_reason[i] << "\n";
+        }
+    }
+    std::cout << "Check latency: p50=" << stats.latency.p50_ns << "ns"
+        << " p99=" << stats.latency.p99_ns << "ns"
+        << " p99.9=" << stats.latency.p999_ns << "ns"
+        << " max=" << stats.latency.max_ns << "ns" << std::endl;
+}
+
+void print_positions(PositionEngine& positions, InstrumentRegistry& instruments) {
+    if (!positions.seeded()) {
+        std::cout << "Positions not loaded yet." << std::endl;
+        return;
+    }
+
+    std::cout << "\nPositions:\n";
+    bool any = false;
+    positions.for_each_position([&](const Position& position) {
+        if (position.size == 0) {
+            return;
+        }
+        any = true;
+        std::cout << instruments.name(position.instrument_id)
+            << ": size=" << position.size
+            << " avg=" << position.average_price
+            << " mark=" << position.mark_price
+            << " uPnL=" << position.unrealized_pnl
+            << " rPnL=" << position.realized_pnl << "\n";
+        });
+    if (!any) {
+        std::cout << "No open positions.\n";
+    }
+
+    for (uint32_t currency = 0; currency < positions.currency_count(); ++currency) {
+        CurrencyTotals totals;
+        if (positions.get_totals(currency, totals)) {
+            std::cout << positions.currency_name(currency) << ": " << totals.open_positions << " open"
+                << ", uPnL=" << totals.unrealized_pnl
+                << ", rPnL=" << totals.realized_pnl << "\n";
+        }
+    }
+    std::cout << std::flush;
+}
+
+void handle_stream_option_chain(SubscriptionManager& subscriptions, OptionChainEngine& option_chain,
+    InstrumentRegistry& instruments) {
+    std::string currency;
+    std::cout << "Enter underlying currency (e.g., BTC): ";
+    std::getline(std::cin, currency);
+
+    std::vector<InstrumentId> options = option_chain.chain_instruments(currency);
+    if (options.empty()) {
+        std::cout << "No listed options on " << currency << std::endl;
+        return;
+    }
+
+    // A few hundred channels per request keeps each subscribe frame small
+    const size_t kChannelsPerRequest = 500;
+    std::vector<std::string> channels;
+    for (size_t i = 0; i < options.size(); ++i) {
+        channels.push_back("ticker." + instruments.name(options[i]) + ".100ms");
+        if (channels.size() == kChannelsPerRequest || i + 1 == options.size()) {
+            subscriptions.acquire(channels);
+            channels.clear();
+        }
+    }
+    std::cout << "Subscribed to " << options.size() << " " << currency << " option tickers" << std::endl;
+}
+
+void print_option_greeks(OptionChainEngine& option_chain, InstrumentRegistry& instruments) {
+    std::string instrument;
+    std::cout << "Enter option (blank for portfolio only): ";
+    std::getline(std::cin, instrument);
+
+    if (!instrument.empty()) {
+        OptionGreeks greeks;
+        if (!option_chain.get_greeks(instruments.find(instrument), greeks)) {
+            std::cout << instrument << " is not in the option chain" << std::endl;
+        }
+        else if (!greeks.valid) {
+            std::cout << instrument << ": no implied vol yet" << std::endl;
+        }
+        else {
+            std::cout << instrument
+                << ": price=" << greeks.price
+                << " underlying=" << greeks.underlying_price
+                << " iv=" << greeks.iv * 100 << "%"
+                << " delta=" << greeks.delta
+                << " gamma=" << greeks.gamma
+                << " vega=" << greeks.vega
+                << " theta=" << greeks.theta << std::endl;
+        }
+    }
+
+    std::cout << "\nPortfolio greeks:\n";
+    for (size_t chain = 0; chain < option_chain.chain_count(); ++chain) {
+        PortfolioGreeks greeks;
+        if (option_chain.get_portfolio_greeks(chain, greeks) && greeks.positions > 0) {
+            std::cout << option_chain.chain_currency(chain) << ": " << greeks.positions << " options"
+                << ", delta=" << greeks.delta
+                << ", gamma=" << greeks.gamma
+                << ", vega=" << greeks.vega
+                << ", theta=" << greeks.theta;
+            if (greeks.unsolved > 0) {
+                std::cout << " (" << greeks.unsolved << " without a valid solve)";
+            }
+            std::cout << "\n";
+        }
+    }
+
+    OptionChainStats stats = option_chain.stats();
+    std::cout << "Batches: " << stats.batches << ", options solved: " << stats.options_solved
+        << ", tickers dropped: " << stats.quotes_dropped
+        << ", batch p50=" << stats.batch_latency.p50_ns << "ns"
+        << " p99=" << stats.batch_latency.p99_ns << "ns" << std::endl;
+}
+
+void print_client_report(WebSocketServer& websocket_server, SubscriptionManager& subscriptions) {
+    std::vector<ClientStats> clients = websocket_server.client_stats();
+    std::cout << "\nDownstream clients (" << clients.size() << "):\n";
+    for (const ClientStats& client : clients) {
+        std::cout << client.remote
+            << " (" << (client.binary ? "binary" : "json") << ")"
+            << ": queued=" << client.queued
+            << " (max " << client.max_queued << ")"
+            << " buffered=" << client.buffered_bytes << "B"
+            << " lag=" << client.lag_ms << "ms"
+            << " sent=" << client.sent
+            << " conflated=" << client.conflated
+            << " dropped=" << client.dropped
+            << " gaps=" << client.gaps;
+        if (client.disconnecting) {
+            std::cout << " [disconnecting]";
+        }
+        std::cout << "\n";
+    }
+
+    std::vector<std::pair<std::string, size_t>> upstream = subscriptions.upstream_channels();
+    std::cout << "Upstream channels (" << upstream.size() << "):\n";
+    for (const auto& [channel, holders] : upstream) {
+        std::cout << "- " << channel << " (" << holders << (holders == 1 ? " holder)\n" : " holders)\n");
+    }
+
+    LatencyHistogram::Summary snapshots = subscriptions.snapshot_latency();
+    std::cout << "Late-join book snapshots: " << snapshots.count
+        << " p50=" << snapshots.p50_ns / 1000.0 << "us"
+        << " p99=" << snapshots.p99_ns / 1000.0 << "us"
+        << " max=" << snapshots.max_ns / 1000.0 << "us\n";
+    std::cout << std::flush;
 }
 
 void handle_get_positions(DeribitClient& deribit_client) {
@@ -355,7 +833,95 @@ void print_orderbook(const OrderBook& orderbook, const std::string& instrument)
     std::cout << "========================================\n";
 }
 
-void handle_get_orderbook(DeribitClient& deribit_client, MarketData& market_data) {
+void print_book_analytics(const MarketData& market_data, InstrumentId instrument) {
+    BookAnalytics analytics;
+    if (!market_data.get_analytics(instrument, analytics) || analytics.mid == 0) {
+        return;
+    }
+    std::cout << "Mid: " << analytics.mid << "  Spread: " << analytics.spread
+        << "  Microprice: " << analytics.microprice << "\n";
+    std::cout << "Imbalance (top " << analytics.imbalance_levels << "): " << analytics.imbalance << "\n";
+    if (analytics.vwap_size > 0) {
+        std::cout << "VWAP for " << analytics.vwap_size << ": bid " << analytics.bid_vwap
+            << ", ask " << analytics.ask_vwap << "\n";
+    }
+    std::cout << std::flush;
+}
+
+void request_book_snapshot(DeribitClient& deribit_client, MarketData& market_data, SubscriptionManager& subscriptions,
+    const ChannelRoute& route, int attempt) {
+    // Full-depth snapshot used to recover from sequence gaps on the raw channel
+    const int resync_depth = 10000;
+    static constexpr long retry_base_ms = 100;
+    static constexpr long retry_max_ms = 10000;
+
+    if (attempt == 0) {
+        std::cout << "Orderbook gap detected for " << route.instrument << ", resyncing..." << std::endl;
+    }
+    deribit_client.get_orderbook(route.instrument, resync_depth,
+        [&deribit_client, &market_data, &subscriptions, route, attempt](const json& response) {
+            if (!response.contains("result")) {
+                // Errors and timeouts alike: the book stays resyncing, buffering
+                // deltas, until a snapshot lands, so keep asking with backoff
+                long delay_ms = std::min(retry_max_ms, retry_base_ms << std::min(attempt, 7));
+                std::cerr << "Orderbook resync failed: " << response.dump() << ", retrying in " << delay_ms << "ms"
+                    << std::endl;
+                deribit_client.post_after(delay_ms, [&deribit_client, &market_data, &subscriptions, route, attempt] {
+                    // Nothing to do once a raw snapshot has resynced the book or it was unsubscribed
+                    std::vector<InstrumentId> subscribed = market_data.get_subscribed_instruments();
+                    if (market_data.is_resyncing(route.instrument_id) &&
+                        std::find(subscribed.begin(), subscribed.end(), route.instrument_id) != subscribed.end()) {
+                        request_book_snapshot(deribit_client, market_data, subscriptions, route, attempt + 1);
+                    }
+                    });
+                return;
+            }
+            BookUpdate snapshot = parse_book_snapshot(response["result"]);
+            BookUpdateResult result = market_data.apply_book_snapshot(route.instrument_id, snapshot);
+            if (result == BookUpdateResult::GapDetected) {
+                request_book_snapshot(deribit_client, market_data, subscriptions, route);
+            }
+            else if (result == BookUpdateResult::Applied) {
+                // Downstream clients saw the same gap; give them the resynced book
+                subscriptions.publish_book_snapshot(route);
+                subscriptions.publish_analytics(route.instrument_id, snapshot.timestamp);
+            }
+        });
+}
+
+BookUpdate parse_book_snapshot(const json& result) {
+    BookUpdate snapshot;
+    snapshot.is_snapshot = true;
+    snapshot.change_id = result["change_id"].get<int64_t>();
+    snapshot.timestamp = result["timestamp"].get<int64_t>();
+
+    auto parse_levels = [](const json& levels, std::vector<BookLevelUpdate>& out) {
+        out.reserve(levels.size());
+        for (const auto& level : levels) {
+            out.push_back({ BookAction::New, level[0].get<double>(), level[1].get<double>() });
+        }
+        };
+    parse_levels(result["bids"], snapshot.bids);
+    parse_levels(result["asks"], snapshot.asks);
+    return snapshot;
+}
+
+OrderBook orderbook_from_snapshot(const BookUpdate& snapshot) {
+    OrderBook orderbook;
+    orderbook.timestamp = snapshot.timestamp;
+    orderbook.change_id = snapshot.change_id;
+    orderbook.bids.reserve(snapshot.bids.size());
+    for (const auto& level : snapshot.bids) {
+        orderbook.bids.push_back({ level.price, level.amount });
+    }
+    orderbook.asks.reserve(snapshot.asks.size());
+    for (const auto& level : snapshot.asks) {
+        orderbook.asks.push_back({ level.price, level.amount });
+    }
+    return orderbook;
+}
+
+void handle_get_orderbook(DeribitClient& deribit_client, MarketData& market_data, InstrumentRegistry& instruments) {
     std::string instrument;
     int depth;
 
@@ -367,38 +933,52 @@ void handle_get_orderbook(DeribitClient& deribit_client, MarketData& market_data
     std::getline(std::cin, depth_str);
     depth = depth_str.empty() ? 10 : std::stoi(depth_str);
 
-    std::cout << "Getting orderbook for " << instrument << "..." << std::endl;
-
-    // Reset orderbook flag
-    {
-        std::lock_guard<std::mutex> lock(orderbook_mutex);
-        orderbook_received = false;
+    // Subscribed books are served from the local cache: the published top
+    // levels directly, deeper books from the ladders on the feed thread
+    InstrumentId id = instruments.find(instrument);
+    size_t levels = static_cast<size_t>(std::max(depth, 0));
+    int64_t start_ns = monotonic_time_ns();
+    OrderBook cached;
+    if (levels <= BookSnapshot::kMaxDepth) {
+        cached = market_data.get_orderbook(id, levels);
     }
-
-    // Request orderbook
-    deribit_client.get_orderbook(instrument, depth);
-
-    // Wait for the response or timeout
-    {
-        std::unique_lock<std::mutex> lock(orderbook_mutex);
-        if (orderbook_cv.wait_for(lock, std::chrono::seconds(5),
-            [&] { return orderbook_received; })) {
-            print_orderbook(latest_orderbook, instrument);
-        }
-        else {
-            std::cout << "Timeout waiting for orderbook data." << std::endl;
-
-            // Try to get from stored data
-            OrderBook ob = market_data.get_orderbook(instrument);
-            if (!ob.bids.empty() || !ob.asks.empty()) {
-                std::cout << "Using cached orderbook data:" << std::endl;
-                print_orderbook(ob, instrument);
+    else if (id != kInvalidInstrument) {
+        auto promise = std::make_shared<std::promise<OrderBook>>();
+        std::future<OrderBook> result = promise->get_future();
+        deribit_client.post([&market_data, id, levels, promise]() {
+            BookUpdate snapshot;
+            OrderBook orderbook;
+            if (market_data.snapshot_book(id, levels, snapshot)) {
+                orderbook = orderbook_from_snapshot(snapshot);
+                orderbook.valid = true;
             }
+            promise->set_value(std::move(orderbook));
+            });
+        if (result.wait_for(std::chrono::seconds(1)) == std::future_status::ready) {
+            cached = result.get();
         }
     }
+    int64_t elapsed_ns = monotonic_time_ns() - start_ns;
+    if (cached.valid) {
+        print_orderbook(cached, instrument);
+        print_book_analytics(market_data, id);
+        std::cout << "Served from the local book (change_id " << cached.change_id << ") in "
+            << elapsed_ns / 1000.0 << "us" << std::endl;
+        return;
+    }
+
+    // Not subscribed (or resyncing): a one-off REST snapshot, printed when it arrives
+    std::cout << "No local book for " << instrument << "; requesting a snapshot from Deribit..." << std::endl;
+    deribit_client.get_orderbook(instrument, depth, [instrument](const json& response) {
+        if (!response.contains("result")) {
+            std::cerr << "Orderbook request failed: " << response.dump() << std::endl;
+            return;
+        }
+        print_orderbook(orderbook_from_snapshot(parse_book_snapshot(response["result"])), instrument);
+        });
 }
 
-void handle_subscribe_instrument(DeribitClient& deribit_client, MarketData& market_data) {
+void handle_subscribe_instrument(SubscriptionManager& subscriptions) {
     std::string instrument;
 
     std::cout << "Enter instrument to subscribe (e.g., BTC-PERPETUAL): ";
@@ -407,11 +987,13 @@ void handle_subscribe_instrument(DeribitClient& deribit_client, MarketData& mark
     std::string channel = "book." + instrument + ".raw";
     std::cout << "Subscribing to " << channel << "..." << std::endl;
 
-    market_data.subscribe_instrument(instrument);
-    deribit_client.subscribe(channel);
+    // Shared with downstream clients: Deribit is only asked once per channel
+    if (subscriptions.acquire({ channel }).empty()) {
+        std::cout << "Unknown instrument " << instrument << std::endl;
+    }
 }
 
-void handle_unsubscribe_instrument(DeribitClient& deribit_client, MarketData& market_data) {
+void handle_unsubscribe_instrument(SubscriptionManager& subscriptions) {
     std::string instrument;
 
     std::cout << "Enter instrument to unsubscribe (e.g., BTC-PERPETUAL): ";
@@ -420,6 +1002,5 @@ void handle_unsubscribe_instrument(DeribitClient& deribit_client, MarketData& ma
     std::string channel = "book." + instrument + ".raw";
     std::cout << "Unsubscribing from " << channel << "..." << std::endl;
 
-    market_data.unsubscribe_instrument(instrument);
-    deribit_client.unsubscribe(channel);
+    subscriptions.release({ channel });
 }
\ No newline at end of file
@@ -1,29 +1,398 @@
 #include "market_data.h"
+#include <algorithm>
+#include "book_kernels.h"
 
-MarketData::MarketData() {}
+namespace {
 
-void MarketData::update_orderbook(const std::string& instrument, const OrderBook& orderbook) {
-    std::lock_guard<std::mutex> lock(orderbooks_mutex_);
-    orderbooks_[instrument] = orderbook;
+void apply_side(PriceLadder& side, const std::vector<BookLevelUpdate>& levels) {
+    for (const auto& level : levels) {
+        if (level.action == BookAction::Delete) {
+            side.erase(level.price);
+        }
+        else {
+            side.set(level.price, level.amount);
+        }
+    }
+}
+
+}
+
+MarketData::MarketData(const InstrumentRegistry& registry)
+    : registry_(registry), orderbooks_(new std::atomic<BookState*>[InstrumentRegistry::kMaxInstruments]) {
+    for (size_t i = 0; i < InstrumentRegistry::kMaxInstruments; ++i) {
+        orderbooks_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+MarketData::~MarketData() {
+    for (size_t i = 0; i < InstrumentRegistry::kMaxInstruments; ++i) {
+        delete orderbooks_[i].load(std::memory_order_relaxed);
+    }
+}
+
+void MarketData::update_orderbook(InstrumentId instrument, const OrderBook& orderbook) {
+    BookState* state = book_for(instrument);
+    if (!state) {
+        return;
+    }
+    BookState& book = *state;
+    book.bids.clear();
+    book.asks.clear();
+    for (const auto& bid : orderbook.bids) {
+        book.bids.set(bid.price, bid.amount);
+    }
+    for (const auto& ask : orderbook.asks) {
+        book.asks.set(ask.price, ask.amount);
+    }
+    book.change_id = orderbook.change_id;
+    book.timestamp = orderbook.timestamp;
+    book.synced = true;
+    book.resyncing = false;
+    book.pending.clear();
+    publish(book);
+}
+
+OrderBook MarketData::get_orderbook(InstrumentId instrument, size_t depth) const {
+    OrderBook result;
+    const BookState* book = find_book(instrument);
+    if (!book) {
+        return result;
+    }
+
+    // Copy into fixed storage under the seqlock, allocate afterwards
+    depth = std::min(depth, BookSnapshot::kMaxDepth);
+    OrderBookEntry bids[BookSnapshot::kMaxDepth];
+    OrderBookEntry asks[BookSnapshot::kMaxDepth];
+    size_t bid_count = 0;
+    size_t ask_count = 0;
+    book->published.read([&](const BookSnapshot& snapshot) {
+        bid_count = std::min<size_t>(depth, snapshot.bid_count);
+        ask_count = std::min<size_t>(depth, snapshot.ask_count);
+        for (size_t i = 0; i < bid_count; ++i) {
+            bids[i] = { snapshot.bid_prices[i], snapshot.bid_amounts[i] };
+        }
+        for (size_t i = 0; i < ask_count; ++i) {
+            asks[i] = { snapshot.ask_prices[i], snapshot.ask_amounts[i] };
+        }
+        result.timestamp = snapshot.timestamp;
+        result.change_id = snapshot.change_id;
+        result.valid = snapshot.valid;
+        });
+
+    result.bids.assign(bids, bids + bid_count);
+    result.asks.assign(asks, asks + ask_count);
+    return result;
+}
+
+bool MarketData::get_top_of_book(InstrumentId instrument, TopOfBook& top) const {
+    const BookState* book = find_book(instrument);
+    if (!book) {
+        return false;
+    }
+
+    bool valid = false;
+    book->published.read([&](const BookSnapshot& snapshot) {
+        valid = snapshot.valid;
+        top.bid_price = snapshot.bid_count > 0 ? snapshot.bid_prices[0] : 0.0;
+        top.bid_amount = snapshot.bid_count > 0 ? snapshot.bid_amounts[0] : 0.0;
+        top.ask_price = snapshot.ask_count > 0 ? snapshot.ask_prices[0] : 0.0;
+        top.ask_amount = snapshot.ask_count > 0 ? snapshot.ask_amounts[0] : 0.0;
+        top.timestamp = snapshot.timestamp;
+        top.change_id = snapshot.change_id;
+        });
+    return valid;
 }
 
-OrderBook MarketData::get_orderbook(const std::string& instrument) const {
-    std::lock_guard<std::mutex> lock(orderbooks_mutex_);
-    auto it = orderbooks_.find(instrument);
-    if (it != orderbooks_.end()) {
-        return it->second;
+bool MarketData::get_analytics(InstrumentId instrument, BookAnalytics& analytics) const {
+    const BookState* book = find_book(instrument);
+    if (!book) {
+        return false;
     }
-    return {};
+
+    bool valid = false;
+    book->published.read([&](const BookSnapshot& snapshot) {
+        valid = snapshot.valid;
+        analytics = snapshot.analytics;
+        });
+    return valid;
+}
+
+double MarketData::get_vwap(InstrumentId instrument, BookSide side, double size) const {
+    const BookState* book = find_book(instrument);
+    if (!book) {
+        return 0.0;
+    }
+
+    double vwap = 0;
+    book->published.read([&](const BookSnapshot& snapshot) {
+        // A torn count must not index past the arrays; the retry discards the result
+        if (side == BookSide::Bid) {
+            size_t count = std::min<size_t>(snapshot.bid_count, BookSnapshot::kMaxDepth);
+            vwap = vwap_for_size(snapshot.bid_prices, snapshot.bid_depth, snapshot.bid_notional, count, size);
+        }
+        else {
+            size_t count = std::min<size_t>(snapshot.ask_count, BookSnapshot::kMaxDepth);
+            vwap = vwap_for_size(snapshot.ask_prices, snapshot.ask_depth, snapshot.ask_notional, count, size);
+        }
+        });
+    return vwap;
+}
+
+bool MarketData::is_resyncing(InstrumentId instrument) const {
+    const BookState* book = find_book(instrument);
+    if (!book) {
+        return false;
+    }
+    bool valid = false;
+    book->published.read([&](const BookSnapshot& snapshot) { valid = snapshot.valid; });
+    return !valid;
+}
+
+BookUpdateResult MarketData::apply_book_update(InstrumentId instrument, const BookUpdate& update) {
+    BookState* state = book_for(instrument);
+    if (!state) {
+        return BookUpdateResult::Stale;
+    }
+    BookState& book = *state;
+
+    BookUpdateResult result;
+    if (update.is_snapshot) {
+        load_snapshot(book, update);
+        result = replay_pending(book);
+    }
+    else if (book.resyncing) {
+        if (book.pending.size() < kMaxBufferedUpdates) {
+            book.pending.push_back(update);
+        }
+        return BookUpdateResult::Buffered;
+    }
+    else if (!book.synced || update.prev_change_id != book.change_id) {
+        if (book.synced && update.change_id <= book.change_id) {
+            return BookUpdateResult::Stale;
+        }
+        start_resync(book, update);
+        result = BookUpdateResult::GapDetected;
+    }
+    else {
+        apply_levels(book, update);
+        result = BookUpdateResult::Applied;
+    }
+
+    publish(book);
+    return result;
+}
+
+BookUpdateResult MarketData::apply_book_snapshot(InstrumentId instrument, const BookUpdate& snapshot) {
+    BookState* state = book_for(instrument);
+    if (!state) {
+        return BookUpdateResult::Stale;
+    }
+    BookState& book = *state;
+
+    // A newer raw snapshot may already have resynced the book
+    if (!book.resyncing && book.synced && snapshot.change_id <= book.change_id) {
+        return BookUpdateResult::Stale;
+    }
+
+    load_snapshot(book, snapshot);
+    BookUpdateResult result = replay_pending(book);
+    publish(book);
+    return result;
 }
 
-void MarketData::subscribe_instrument(const std::string& instrument) {
+bool MarketData::snapshot_book(InstrumentId instrument, size_t depth, BookUpdate& snapshot) const {
+    const BookState* book = find_book(instrument);
+    if (!book || !book->synced || book->resyncing) {
+        return false;
+    }
+    snapshot.is_snapshot = true;
+    snapshot.change_id = book->change_id;
+    snapshot.prev_change_id = 0;
+    snapshot.timestamp = book->timestamp;
+    snapshot.bids.clear();
+    snapshot.asks.clear();
+    snapshot.bids.reserve(std::min(depth, book->bids.size()));
+    snapshot.asks.reserve(std::min(depth, book->asks.size()));
+    book->bids.for_each_level(depth, [&](double price, double amount) {
+        snapshot.bids.push_back({ BookAction::New, price, amount });
+        });
+    book->asks.for_each_level(depth, [&](double price, double amount) {
+        snapshot.asks.push_back({ BookAction::New, price, amount });
+        });
+    return true;
+}
+
+void MarketData::reset_book(InstrumentId instrument) {
+    if (instrument >= InstrumentRegistry::kMaxInstruments) {
+        return;
+    }
+    BookState* book = orderbooks_[instrument].load(std::memory_order_relaxed);
+    if (!book) {
+        return;
+    }
+    book->bids.clear();
+    book->asks.clear();
+    book->change_id = 0;
+    book->synced = false;
+    book->resyncing = false;
+    book->pending.clear();
+    publish(*book);
+}
+
+void MarketData::set_analytics_config(InstrumentId instrument, const AnalyticsConfig& config) {
+    BookState* state = book_for(instrument);
+    if (state) {
+        state->analytics_config = config;
+    }
+}
+
+void MarketData::set_tick_size(InstrumentId instrument, double tick_size) {
+    BookState* state = book_for(instrument);
+    if (!state) {
+        return;
+    }
+    BookState& book = *state;
+    if (tick_size > 0 && book.bids.tick_size() != tick_size) {
+        // Re-indexing drops the levels, so the next delta triggers a resync
+        book.bids.set_tick_size(tick_size);
+        book.asks.set_tick_size(tick_size);
+        book.synced = false;
+        publish(book);
+    }
+}
+
+const MarketData::BookState* MarketData::find_book(InstrumentId instrument) const {
+    if (instrument >= InstrumentRegistry::kMaxInstruments) {
+        return nullptr;
+    }
+    return orderbooks_[instrument].load(std::memory_order_acquire);
+}
+
+MarketData::BookState* MarketData::book_for(InstrumentId instrument) {
+    if (instrument >= InstrumentRegistry::kMaxInstruments) {
+        return nullptr;
+    }
+    BookState* book = orderbooks_[instrument].load(std::memory_order_relaxed);
+    if (!book) {
+        double tick_size = registry_.info(instrument).tick_size;
+        book = new BookState(tick_size > 0 ? tick_size : kDefaultTickSize);
+        publish(*book);
+        orderbooks_[instrument].store(book, std::memory_order_release);
+    }
+    return book;
+}
+
+void MarketData::apply_levels(BookState& book, const BookUpdate& update) {
+    apply_side(book.bids, update.bids);
+    apply_side(book.asks, update.asks);
+    book.change_id = update.change_id;
+    book.timestamp = update.timestamp;
+}
+
+void MarketData::load_snapshot(BookState& book, const BookUpdate& snapshot) {
+    book.bids.clear();
+    book.asks.clear();
+    apply_levels(book, snapshot);
+    book.synced = true;
+    book.resyncing = false;
+}
+
+BookUpdateResult MarketData::replay_pending(BookState& book) {
+    std::vector<BookUpdate> pending;
+    pending.swap(book.pending);
+
+    for (size_t i = 0; i < pending.size(); ++i) {
+        const BookUpdate& update = pending[i];
+        if (update.change_id <= book.change_id) {
+            continue;
+        }
+        if (update.prev_change_id != book.change_id) {
+            // The snapshot does not bridge the buffered deltas; fetch another one
+            book.resyncing = true;
+            book.pending.assign(pending.begin() + i, pending.end());
+            return BookUpdateResult::GapDetected;
+        }
+        apply_levels(book, update);
+    }
+    return BookUpdateResult::Applied;
+}
+
+void MarketData::start_resync(BookState& book, const BookUpdate& update) {
+    book.resyncing = true;
+    book.pending.clear();
+    book.pending.push_back(update);
+}
+
+void MarketData::publish(BookState& book) {
+    BookSnapshot& snapshot = book.scratch;
+    snapshot.timestamp = book.timestamp;
+    snapshot.change_id = book.change_id;
+    snapshot.valid = book.synced && !book.resyncing;
+
+    uint32_t count = 0;
+    book.bids.for_each_level(BookSnapshot::kMaxDepth, [&](double price, double amount) {
+        snapshot.bid_prices[count] = price;
+        snapshot.bid_amounts[count] = amount;
+        ++count;
+        });
+    snapshot.bid_count = count;
+
+    count = 0;
+    book.asks.for_each_level(BookSnapshot::kMaxDepth, [&](double price, double amount) {
+        snapshot.ask_prices[count] = price;
+        snapshot.ask_amounts[count] = amount;
+        ++count;
+        });
+    snapshot.ask_count = count;
+
+    compute_analytics(book.analytics_config, snapshot);
+    book.published.store(snapshot);
+}
+
+void MarketData::compute_analytics(const AnalyticsConfig& config, BookSnapshot& snapshot) {
+    cumulate_levels(snapshot.bid_prices, snapshot.bid_amounts, snapshot.bid_count,
+        snapshot.bid_depth, snapshot.bid_notional);
+    cumulate_levels(snapshot.ask_prices, snapshot.ask_amounts, snapshot.ask_count,
+        snapshot.ask_depth, snapshot.ask_notional);
+
+    BookAnalytics& analytics = snapshot.analytics;
+    analytics = BookAnalytics();
+    analytics.vwap_size = config.vwap_size;
+    analytics.imbalance_levels = config.imbalance_levels;
+    if (snapshot.bid_count == 0 || snapshot.ask_count == 0) {
+        return;
+    }
+
+    double bid = snapshot.bid_prices[0];
+    double ask = snapshot.ask_prices[0];
+    double bid_amount = snapshot.bid_amounts[0];
+    double ask_amount = snapshot.ask_amounts[0];
+    analytics.mid = 0.5 * (bid + ask);
+    analytics.spread = ask - bid;
+    analytics.microprice = bid_amount + ask_amount > 0 ?
+        (bid * ask_amount + ask * bid_amount) / (bid_amount + ask_amount) : analytics.mid;
+
+    // Cumulative depth already holds the top-N sums
+    if (config.imbalance_levels > 0) {
+        double bid_depth = snapshot.bid_depth[std::min<size_t>(config.imbalance_levels, snapshot.bid_count) - 1];
+        double ask_depth = snapshot.ask_depth[std::min<size_t>(config.imbalance_levels, snapshot.ask_count) - 1];
+        analytics.imbalance = bid_depth + ask_depth > 0 ? (bid_depth - ask_depth) / (bid_depth + ask_depth) : 0.0;
+    }
+
+    analytics.bid_vwap = vwap_for_size(snapshot.bid_prices, snapshot.bid_depth, snapshot.bid_notional,
+        snapshot.bid_count, config.vwap_size);
+    analytics.ask_vwap = vwap_for_size(snapshot.ask_prices, snapshot.ask_depth, snapshot.ask_notional,
+        snapshot.ask_count, config.vwap_size);
+}
+
+void MarketData::subscribe_instrument(InstrumentId instrument) {
     std::lock_guard<std::mutex> lock(subscriptions_mutex_);
     if (std::find(subscribed_instruments_.begin(), subscribed_instruments_.end(), instrument) == subscribed_instruments_.end()) {
         subscribed_instruments_.push_back(instrument);
     }
 }
 
-void MarketData::unsubscribe_instrument(const std::string& instrument) {
+void MarketData::unsubscribe_instrument(InstrumentId instrument) {
     std::lock_guard<std::mutex> lock(subscriptions_mutex_);
     subscribed_instruments_.erase(
         std::remove(subscribed_instruments_.begin(), subscribed_instruments_.end(), instrument),
@@ -31,7 +400,7 @@ void MarketData::unsubscribe_instrument(const std::string& instrument) {
     );
 }
 
-std::vector<std::string> MarketData::get_subscribed_instruments() const {
+std::vector<InstrumentId> MarketData::get_subscribed_instruments() const {
     std::lock_guard<std::mutex> lock(subscriptions_mutex_);
     return subscribed_instruments_;
-}
\ No newline at end of file
+}
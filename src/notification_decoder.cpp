@@ -0,0 +1,200 @@
+#include "notification_decoder.h"
+#include "json_scanner.h"
+
+namespace {
+
+bool decode_levels(JsonScanner& scanner, std::vector<BookLevelUpdate>& levels) {
+    levels.clear();
+    return scanner.for_each_element([&](JsonScanner& level) {
+        std::string_view action;
+        BookLevelUpdate entry;
+        if (!level.consume('[') || !level.read_string(action) || !level.consume(',')
+            || !level.read_number(entry.price) || !level.consume(',')
+            || !level.read_number(entry.amount) || !level.consume(']')) {
+            return false;
+        }
+        entry.action = action == "delete" ? BookAction::Delete
+            : action == "change" ? BookAction::Change : BookAction::New;
+        levels.push_back(entry);
+        return true;
+        });
+}
+
+// Ticker and order fields may be null, and order prices may be the
+// string "market_price"; both read as zero
+template <typename T>
+bool read_optional_number(JsonScanner& scanner, T& out) {
+    out = T();
+    char next = scanner.peek();
+    if (next == 'n' || next == '"') {
+        return scanner.skip_value();
+    }
+    return scanner.read_number(out);
+}
+
+bool read_optional_string(JsonScanner& scanner, std::string_view& out) {
+    out = std::string_view();
+    if (scanner.peek() != '"') {
+        return scanner.skip_value();
+    }
+    return scanner.read_string(out);
+}
+
+// Channels that publish either a single object or an array of them
+template <typename Event, typename F>
+bool decode_events(std::string_view data, std::vector<Event>& events, F&& decode_event) {
+    events.clear();
+    JsonScanner scanner(data);
+    auto decode_one = [&](JsonScanner& element) {
+        events.emplace_back();
+        return decode_event(element, events.back());
+    };
+    if (scanner.peek() == '[') {
+        return scanner.for_each_element(decode_one);
+    }
+    return decode_one(scanner);
+}
+
+}
+
+bool decode_envelope(std::string_view frame, NotificationEnvelope& envelope) {
+    envelope = NotificationEnvelope();
+    JsonScanner scanner(frame);
+
+    return scanner.for_each_member([&](std::string_view key, JsonScanner& value) {
+        if (key == "id") {
+            if (value.is_null()) {
+                return true;
+            }
+            envelope.has_id = true;
+            return value.read_number(envelope.id);
+        }
+        if (key == "params") {
+            if (value.peek() != '{') {
+                return value.skip_value();
+            }
+            return value.for_each_member([&](std::string_view param, JsonScanner& field) {
+                if (param == "channel") {
+                    return field.read_string(envelope.channel);
+                }
+                if (param == "data") {
+                    return field.read_raw(envelope.data);
+                }
+                return field.skip_value();
+                });
+        }
+        return value.skip_value();
+        });
+}
+
+bool decode_book_data(std::string_view data, BookUpdate& update) {
+    update.is_snapshot = false;
+    update.change_id = 0;
+    update.prev_change_id = 0;
+    update.timestamp = 0;
+    update.bids.clear();
+    update.asks.clear();
+
+    JsonScanner scanner(data);
+    return scanner.for_each_member([&](std::string_view key, JsonScanner& value) {
+        if (key == "type") {
+            std::string_view type;
+            if (!value.read_string(type)) {
+                return false;
+            }
+            update.is_snapshot = type == "snapshot";
+            return true;
+        }
+        if (key == "change_id") {
+            return value.read_number(update.change_id);
+        }
+        if (key == "prev_change_id") {
+            return value.read_number(update.prev_change_id);
+        }
+        if (key == "timestamp") {
+            return value.read_number(update.timestamp);
+        }
+        if (key == "bids") {
+            return decode_levels(value, update.bids);
+        }
+        if (key == "asks") {
+            return decode_levels(value, update.asks);
+        }
+        return value.skip_value();
+        });
+}
+
+bool decode_ticker_data(std::string_view data, TickerUpdate& update) {
+    update = TickerUpdate();
+
+    JsonScanner scanner(data);
+    return scanner.for_each_member([&](std::string_view key, JsonScanner& value) {
+        if (key == "instrument_name") return value.read_string(update.instrument_name);
+        if (key == "timestamp") return value.read_number(update.timestamp);
+        if (key == "best_bid_price") return read_optional_number(value, update.best_bid_price);
+        if (key == "best_bid_amount") return read_optional_number(value, update.best_bid_amount);
+        if (key == "best_ask_price") return read_optional_number(value, update.best_ask_price);
+        if (key == "best_ask_amount") return read_optional_number(value, update.best_ask_amount);
+        if (key == "last_price") return read_optional_number(value, update.last_price);
+        if (key == "mark_price") return read_optional_number(value, update.mark_price);
+        if (key == "index_price") return read_optional_number(value, update.index_price);
+        if (key == "underlying_price") return read_optional_number(value, update.underlying_price);
+        if (key == "mark_iv") return read_optional_number(value, update.mark_iv);
+        if (key == "bid_iv") return read_optional_number(value, update.bid_iv);
+        if (key == "ask_iv") return read_optional_number(value, update.ask_iv);
+        if (key == "open_interest") return read_optional_number(value, update.open_interest);
+        return value.skip_value();
+        });
+}
+
+bool decode_trades_data(std::string_view data, TradesUpdate& update) {
+    return decode_events(data, update.trades, [](JsonScanner& scanner, TradeEvent& trade) {
+        return scanner.for_each_member([&](std::string_view key, JsonScanner& value) {
+            if (key == "trade_id") return value.read_string(trade.trade_id);
+            if (key == "instrument_name") return value.read_string(trade.instrument_name);
+            if (key == "direction") return value.read_string(trade.direction);
+            if (key == "price") return value.read_number(trade.price);
+            if (key == "amount") return value.read_number(trade.amount);
+            if (key == "trade_seq") return value.read_number(trade.trade_seq);
+            if (key == "timestamp") return value.read_number(trade.timestamp);
+            return value.skip_value();
+            });
+        });
+}
+
+bool decode_user_orders_data(std::string_view data, OrdersUpdate& update) {
+    return decode_events(data, update.orders, [](JsonScanner& scanner, OrderEvent& order) {
+        return scanner.for_each_member([&](std::string_view key, JsonScanner& value) {
+            if (key == "order_id") return value.read_string(order.order_id);
+            if (key == "label") return read_optional_string(value, order.label);
+            if (key == "instrument_name") return value.read_string(order.instrument_name);
+            if (key == "order_state") return value.read_string(order.order_state);
+            if (key == "direction") return value.read_string(order.direction);
+            if (key == "order_type") return value.read_string(order.order_type);
+            if (key == "price") return read_optional_number(value, order.price);
+            if (key == "amount") return read_optional_number(value, order.amount);
+            if (key == "filled_amount") return read_optional_number(value, order.filled_amount);
+            if (key == "average_price") return read_optional_number(value, order.average_price);
+            if (key == "creation_timestamp") return value.read_number(order.creation_timestamp);
+            if (key == "last_update_timestamp") return value.read_number(order.last_update_timestamp);
+            return value.skip_value();
+            });
+        });
+}
+
+bool decode_user_trades_data(std::string_view data, UserTradesUpdate& update) {
+    return decode_events(data, update.trades, [](JsonScanner& scanner, UserTradeEvent& trade) {
+        return scanner.for_each_member([&](std::string_view key, JsonScanner& value) {
+            if (key == "trade_id") return value.read_string(trade.trade_id);
+            if (key == "order_id") return value.read_string(trade.order_id);
+            if (key == "label") return read_optional_string(value, trade.label);
+            if (key == "instrument_name") return value.read_string(trade.instrument_name);
+            if (key == "direction") return value.read_string(trade.direction);
+            if (key == "price") return value.read_number(trade.price);
+            if (key == "amount") return value.read_number(trade.amount);
+            if (key == "fee") return read_optional_number(value, trade.fee);
+            if (key == "timestamp") return value.read_number(trade.timestamp);
+            return value.skip_value();
+            });
+        });
+}
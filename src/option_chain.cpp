@@ -0,0 +1,384 @@
+#include "option_chain.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include "option_kernels.h"
+#include "utils.h"
+
+namespace {
+
+constexpr double kMillisPerYear = 365.0 * 24 * 60 * 60 * 1000;
+
+int64_t wall_time_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+}
+
+OptionChainEngine::OptionChainEngine(const InstrumentRegistry& registry, const PositionEngine& positions,
+    const OptionChainConfig& config)
+    : registry_(registry), positions_(positions), config_(config),
+    slot_of_(new uint32_t[InstrumentRegistry::kMaxInstruments]),
+    quotes_(new SpscRing<OptionQuote>(config.quote_capacity)) {
+    std::fill(slot_of_.get(), slot_of_.get() + InstrumentRegistry::kMaxInstruments, kNoSlot);
+}
+
+OptionChainEngine::~OptionChainEngine() {
+    stop();
+}
+
+size_t OptionChainEngine::build() {
+    if (running_.load(std::memory_order_acquire)) {
+        return instruments_.size();
+    }
+
+    int64_t now_ms = wall_time_ms();
+    std::vector<InstrumentId> options;
+    size_t count = registry_.size();
+    for (size_t id = 0; id < count; ++id) {
+        const InstrumentInfo& info = registry_.info(static_cast<InstrumentId>(id));
+        if (info.kind == InstrumentKind::Option && info.strike > 0 && info.expiration_timestamp > now_ms) {
+            options.push_back(static_cast<InstrumentId>(id));
+        }
+    }
+    // Neighbouring strikes of one expiry share a chunk, and so a cache line
+    std::sort(options.begin(), options.end(), [this](InstrumentId a, InstrumentId b) {
+        const InstrumentInfo& x = registry_.info(a);
+        const InstrumentInfo& y = registry_.info(b);
+        if (x.base_currency != y.base_currency) {
+            return x.base_currency < y.base_currency;
+        }
+        if (x.expiration_timestamp != y.expiration_timestamp) {
+            return x.expiration_timestamp < y.expiration_timestamp;
+        }
+        if (x.strike != y.strike) {
+            return x.strike < y.strike;
+        }
+        return x.is_call > y.is_call;
+        });
+
+    size_t slots = options.size();
+    chains_.clear();
+    std::fill(slot_of_.get(), slot_of_.get() + InstrumentRegistry::kMaxInstruments, kNoSlot);
+    instruments_ = options;
+    chain_of_.assign(slots, 0);
+    expiration_ms_.assign(slots, 0);
+    strikes_.assign(slots, 0.0);
+    signs_.assign(slots, 0.0);
+    coin_quoted_.assign(slots, 0);
+    mark_prices_.assign(slots, 0.0);
+    underlying_prices_.assign(slots, 0.0);
+    timestamps_.assign(slots, 0);
+    vols_.assign(slots, 0.0);
+    results_.assign(slots, OptionGreeks());
+    dirty_.assign(slots, 0);
+    dirty_slots_.clear();
+    dirty_slots_.reserve(slots);
+    published_.reset(new SeqLock<OptionGreeks>[slots]);
+
+    for (size_t slot = 0; slot < slots; ++slot) {
+        const InstrumentInfo& info = registry_.info(options[slot]);
+        if (chains_.empty() || chains_.back().currency != info.base_currency) {
+            chains_.push_back({ info.base_currency, {} });
+        }
+        Chain& chain = chains_.back();
+        if (chain.expiries.empty() || chain.expiries.back().expiration_ms != info.expiration_timestamp) {
+            chain.expiries.push_back({ info.expiration_timestamp, static_cast<uint32_t>(slot), 0 });
+        }
+        ++chain.expiries.back().count;
+
+        slot_of_[options[slot]] = static_cast<uint32_t>(slot);
+        chain_of_[slot] = static_cast<uint32_t>(chains_.size() - 1);
+        expiration_ms_[slot] = info.expiration_timestamp;
+        strikes_[slot] = info.strike;
+        signs_[slot] = info.is_call ? 1.0 : -1.0;
+        // Coin-settled options quote their premium in the underlying; USDC ones in USD
+        coin_quoted_[slot] = info.settlement_currency.empty() || info.settlement_currency == info.base_currency;
+        published_[slot].store(results_[slot]);
+    }
+
+    portfolio_.reset(new SeqLock<PortfolioGreeks>[chains_.size()]);
+    for (size_t chain = 0; chain < chains_.size(); ++chain) {
+        portfolio_[chain].store(PortfolioGreeks());
+    }
+    return slots;
+}
+
+void OptionChainEngine::start() {
+    if (running_.exchange(true)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+        pool_stopping_ = false;
+        generation_ = 0;
+    }
+    for (size_t i = 0; i < config_.worker_threads; ++i) {
+        workers_.emplace_back(&OptionChainEngine::worker_loop, this);
+    }
+    batch_thread_ = std::thread(&OptionChainEngine::batch_loop, this);
+}
+
+void OptionChainEngine::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+    }
+    sleep_cv_.notify_all();
+    if (batch_thread_.joinable()) {
+        batch_thread_.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+        pool_stopping_ = true;
+    }
+    pool_cv_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+    workers_.clear();
+}
+
+void OptionChainEngine::on_ticker(InstrumentId instrument, const TickerUpdate& ticker) {
+    if (instrument >= InstrumentRegistry::kMaxInstruments || slot_of_[instrument] == kNoSlot) {
+        return;
+    }
+    OptionQuote quote;
+    quote.slot = slot_of_[instrument];
+    quote.mark_price = ticker.mark_price;
+    quote.underlying_price = ticker.underlying_price;
+    quote.mark_iv = ticker.mark_iv;
+    quote.timestamp = ticker.timestamp;
+    if (!quotes_->try_push(std::move(quote))) {
+        quotes_dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool OptionChainEngine::get_greeks(InstrumentId instrument, OptionGreeks& greeks) const {
+    if (instrument >= InstrumentRegistry::kMaxInstruments || slot_of_[instrument] == kNoSlot) {
+        return false;
+    }
+    greeks = published_[slot_of_[instrument]].load();
+    return true;
+}
+
+bool OptionChainEngine::get_portfolio_greeks(size_t chain, PortfolioGreeks& greeks) const {
+    if (chain >= chains_.size()) {
+        return false;
+    }
+    greeks = portfolio_[chain].load();
+    return true;
+}
+
+std::vector<InstrumentId> OptionChainEngine::chain_instruments(std::string_view currency) const {
+    std::vector<InstrumentId> instruments;
+    for (const Chain& chain : chains_) {
+        if (chain.currency != currency) {
+            continue;
+        }
+        for (const Expiry& expiry : chain.expiries) {
+            instruments.insert(instruments.end(), instruments_.begin() + expiry.first_slot,
+                instruments_.begin() + expiry.first_slot + expiry.count);
+        }
+    }
+    return instruments;
+}
+
+OptionChainStats OptionChainEngine::stats() const {
+    OptionChainStats stats;
+    stats.batches = batches_.load(std::memory_order_relaxed);
+    stats.options_solved = options_solved_.load(std::memory_order_relaxed);
+    stats.quotes_dropped = quotes_dropped_.load(std::memory_order_relaxed);
+    stats.batch_latency = batch_latency_.summary();
+    return stats;
+}
+
+void OptionChainEngine::batch_loop() {
+    auto interval = std::chrono::milliseconds(std::max(config_.batch_interval_ms, 1));
+    auto deadline = std::chrono::steady_clock::now() + interval;
+    while (running_.load(std::memory_order_acquire)) {
+        {
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            sleep_cv_.wait_until(lock, deadline, [this] { return !running_.load(std::memory_order_acquire); });
+        }
+        if (!running_.load(std::memory_order_acquire)) {
+            break;
+        }
+        deadline += interval;
+        // Fell behind: skip missed intervals rather than batching back to back
+        auto now = std::chrono::steady_clock::now();
+        if (deadline < now) {
+            deadline = now + interval;
+        }
+        run_batch();
+    }
+}
+
+void OptionChainEngine::run_batch() {
+    int64_t start_ns = monotonic_time_ns();
+
+    // Conflate: only the newest ticker per option is solved
+    OptionQuote quote;
+    while (quotes_->try_pop(quote)) {
+        uint32_t slot = quote.slot;
+        if (!(quote.mark_price > 0) || !(quote.underlying_price > 0)) {
+            continue;
+        }
+        mark_prices_[slot] = quote.mark_price;
+        underlying_prices_[slot] = quote.underlying_price;
+        timestamps_[slot] = quote.timestamp;
+        if (vols_[slot] == 0 && quote.mark_iv > 0) {
+            vols_[slot] = quote.mark_iv / 100.0;
+        }
+        if (!dirty_[slot]) {
+            dirty_[slot] = 1;
+            dirty_slots_.push_back(slot);
+        }
+    }
+
+    if (!dirty_slots_.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex_);
+            chunk_count_ = (dirty_slots_.size() + kChunkSize - 1) / kChunkSize;
+            next_chunk_.store(0, std::memory_order_relaxed);
+            batch_now_ms_ = wall_time_ms();
+            workers_done_ = 0;
+            ++generation_;
+        }
+        pool_cv_.notify_all();
+
+        size_t chunk;
+        while ((chunk = next_chunk_.fetch_add(1, std::memory_order_relaxed)) < chunk_count_) {
+            solve_chunk(chunk);
+        }
+        {
+            std::unique_lock<std::mutex> lock(pool_mutex_);
+            done_cv_.wait(lock, [this] { return workers_done_ == workers_.size(); });
+        }
+
+        options_solved_.fetch_add(dirty_slots_.size(), std::memory_order_relaxed);
+        for (uint32_t slot : dirty_slots_) {
+            dirty_[slot] = 0;
+        }
+        dirty_slots_.clear();
+    }
+
+    // Positions move with fills even when no option ticked
+    update_portfolio();
+    batches_.fetch_add(1, std::memory_order_relaxed);
+    batch_latency_.record(monotonic_time_ns() - start_ns);
+}
+
+void OptionChainEngine::worker_loop() {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(pool_mutex_);
+            pool_cv_.wait(lock, [this, seen] { return pool_stopping_ || generation_ != seen; });
+            if (pool_stopping_) {
+                return;
+            }
+            seen = generation_;
+        }
+        size_t chunk;
+        while ((chunk = next_chunk_.fetch_add(1, std::memory_order_relaxed)) < chunk_count_) {
+            solve_chunk(chunk);
+        }
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex_);
+            ++workers_done_;
+        }
+        done_cv_.notify_one();
+    }
+}
+
+void OptionChainEngine::solve_chunk(size_t chunk) {
+    // Padded to a whole number of vectors
+    constexpr size_t kPadded = kChunkSize + VecD::kWidth;
+    alignas(64) double forward[kPadded];
+    alignas(64) double strike[kPadded];
+    alignas(64) double years[kPadded];
+    alignas(64) double price[kPadded];
+    alignas(64) double sign[kPadded];
+    alignas(64) double vol[kPadded];
+    alignas(64) double delta[kPadded];
+    alignas(64) double gamma[kPadded];
+    alignas(64) double vega[kPadded];
+    alignas(64) double theta[kPadded];
+    alignas(64) double valid[kPadded];
+
+    size_t first = chunk * kChunkSize;
+    size_t count = std::min(kChunkSize, dirty_slots_.size() - first);
+    const uint32_t* slots = dirty_slots_.data() + first;
+
+    // Gather: dirty slots stay in arrival order, but mostly neighbours
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t slot = slots[i];
+        double underlying = underlying_prices_[slot];
+        forward[i] = underlying;
+        strike[i] = strikes_[slot];
+        years[i] = static_cast<double>(expiration_ms_[slot] - batch_now_ms_) / kMillisPerYear;
+        price[i] = coin_quoted_[slot] ? mark_prices_[slot] * underlying : mark_prices_[slot];
+        sign[i] = signs_[slot];
+        vol[i] = vols_[slot] > 0 ? vols_[slot] : 0.5;
+    }
+    size_t padded = (count + VecD::kWidth - 1) / VecD::kWidth * VecD::kWidth;
+    for (size_t i = count; i < padded; ++i) {
+        forward[i] = forward[0];
+        strike[i] = strike[0];
+        years[i] = years[0];
+        price[i] = price[0];
+        sign[i] = sign[0];
+        vol[i] = vol[0];
+    }
+
+    OptionBatch batch{ forward, strike, years, price, sign, vol, delta, gamma, vega, theta, valid, padded };
+    solve_option_batch(batch);
+
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t slot = slots[i];
+        OptionGreeks& result = results_[slot];
+        result.price = price[i];
+        result.underlying_price = forward[i];
+        result.timestamp = timestamps_[slot];
+        result.valid = valid[i] != 0;
+        if (result.valid) {
+            // A failed solve keeps the last good vol as the next starting point
+            vols_[slot] = vol[i];
+            result.iv = vol[i];
+        }
+        result.delta = delta[i];
+        result.gamma = gamma[i];
+        result.vega = vega[i];
+        result.theta = theta[i];
+        published_[slot].store(result);
+    }
+}
+
+void OptionChainEngine::update_portfolio() {
+    std::vector<PortfolioGreeks> totals(chains_.size(), PortfolioGreeks());
+    positions_.for_each_position([this, &totals](const Position& position) {
+        uint32_t slot = position.instrument_id < InstrumentRegistry::kMaxInstruments ?
+            slot_of_[position.instrument_id] : kNoSlot;
+        if (slot == kNoSlot || position.size == 0) {
+            return;
+        }
+        const OptionGreeks& greeks = results_[slot];
+        PortfolioGreeks& total = totals[chain_of_[slot]];
+        total.delta += position.size * greeks.delta;
+        total.gamma += position.size * greeks.gamma;
+        total.vega += position.size * greeks.vega;
+        total.theta += position.size * greeks.theta;
+        ++total.positions;
+        if (!greeks.valid) {
+            ++total.unsolved;
+        }
+        total.timestamp = std::max(total.timestamp, greeks.timestamp);
+        });
+    for (size_t chain = 0; chain < chains_.size(); ++chain) {
+        portfolio_[chain].store(totals[chain]);
+    }
+}
@@ -0,0 +1,136 @@
+#include "order_encoder.h"
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+bool needs_escaping(std::string_view value) {
+    for (char c : value) {
+        if (c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+bool OrderEncoder::encode_order(std::string_view side, std::string_view instrument, double amount, double price,
+    std::string_view type, std::string_view label) {
+    const char* method;
+    if (side == "buy") {
+        method = "private/buy";
+    }
+    else if (side == "sell") {
+        method = "private/sell";
+    }
+    else {
+        return false;
+    }
+    if (needs_escaping(instrument) || needs_escaping(type) || needs_escaping(label)) {
+        return false;
+    }
+
+    begin(method);
+    append("\"instrument_name\":");
+    append_string(instrument);
+    append(",\"amount\":");
+    append_number(amount);
+    append(",\"type\":");
+    append_string(type);
+    append(",\"side\":");
+    append_string(side);
+    if (price > 0) {
+        append(",\"price\":");
+        append_number(price);
+    }
+    if (!label.empty()) {
+        append(",\"label\":");
+        append_string(label);
+    }
+    return finish();
+}
+
+bool OrderEncoder::encode_cancel(std::string_view order_id) {
+    if (needs_escaping(order_id)) {
+        return false;
+    }
+
+    begin("private/cancel");
+    append("\"order_id\":");
+    append_string(order_id);
+    return finish();
+}
+
+bool OrderEncoder::encode_edit(std::string_view order_id, double amount, double price) {
+    if (needs_escaping(order_id)) {
+        return false;
+    }
+
+    begin("private/edit");
+    append("\"order_id\":");
+    append_string(order_id);
+    append(",\"amount\":");
+    append_number(amount);
+    append(",\"price\":");
+    append_number(price);
+    return finish();
+}
+
+void OrderEncoder::set_id(int64_t id) {
+    // JSON allows whitespace after a number, so the digits are written
+    // left-aligned over the padding and the remainder stays blank
+    char* field = buffer_ + id_offset_;
+    std::memset(field, ' ', kIdWidth);
+    std::to_chars(field, field + kIdWidth, id);
+}
+
+void OrderEncoder::begin(const char* method) {
+    size_ = 0;
+    failed_ = false;
+    method_ = method;
+
+    append("{\"jsonrpc\":\"2.0\",\"id\":");
+    id_offset_ = size_;
+    std::memset(buffer_ + size_, ' ', kIdWidth);
+    buffer_[size_] = '0';
+    size_ += kIdWidth;
+    append(",\"method\":\"");
+    append(method);
+    append("\",\"params\":{");
+}
+
+bool OrderEncoder::finish() {
+    append("}}");
+    return !failed_;
+}
+
+void OrderEncoder::append(std::string_view text) {
+    if (failed_ || text.size() > kCapacity - size_) {
+        failed_ = true;
+        return;
+    }
+    std::memcpy(buffer_ + size_, text.data(), text.size());
+    size_ += text.size();
+}
+
+void OrderEncoder::append_string(std::string_view value) {
+    append("\"");
+    append(value);
+    append("\"");
+}
+
+void OrderEncoder::append_number(double value) {
+    if (failed_ || !std::isfinite(value)) {
+        failed_ = true;
+        return;
+    }
+    // Shortest round-trip form, the same digits json::dump() produces
+    auto result = std::to_chars(buffer_ + size_, buffer_ + kCapacity, value);
+    if (result.ec != std::errc()) {
+        failed_ = true;
+        return;
+    }
+    size_ = static_cast<size_t>(result.ptr - buffer_);
+}
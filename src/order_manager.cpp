@@ -1,54 +1,669 @@
 #include "order_manager.h"
+#include <algorithm>
+#include <iostream>
+#include "pending_requests.h"
 
-OrderManager::OrderManager() {}
+namespace {
 
-void OrderManager::add_order(const Order& order) {
+// Repeating a state is allowed: it carries fills and edits
+bool valid_transition(OrderStatus from, OrderStatus to) {
+    if (from == to) {
+        return true;
+    }
+    switch (from) {
+    case OrderStatus::Pending:
+        return to != OrderStatus::Unknown;
+    case OrderStatus::Untriggered:
+        return to == OrderStatus::Open || to == OrderStatus::Filled ||
+            to == OrderStatus::Cancelled || to == OrderStatus::Rejected;
+    case OrderStatus::Open:
+        return to == OrderStatus::Filled || to == OrderStatus::Cancelled;
+    case OrderStatus::Unknown:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Views into a Deribit order object, in the shape user.orders delivers
+OrderEvent event_from_report(const json& report) {
+    auto text = [&report](const char* key) {
+        auto it = report.find(key);
+        return it != report.end() && it->is_string() ? std::string_view(it->get_ref<const std::string&>())
+            : std::string_view();
+        };
+    auto number = [&report](const char* key) {
+        auto it = report.find(key);
+        return it != report.end() && it->is_number() ? it->get<double>() : 0.0;
+        };
+
+    OrderEvent event;
+    event.order_id = text("order_id");
+    event.label = text("label");
+    event.instrument_name = text("instrument_name");
+    event.order_state = text("order_state");
+    event.direction = text("direction");
+    event.order_type = text("order_type");
+    event.price = number("price");
+    event.amount = number("amount");
+    event.filled_amount = number("filled_amount");
+    event.average_price = number("average_price");
+    event.creation_timestamp = static_cast<int64_t>(number("creation_timestamp"));
+    event.last_update_timestamp = static_cast<int64_t>(number("last_update_timestamp"));
+    return event;
+}
+
+}
+
+OrderSide parse_order_side(std::string_view side) {
+    if (side == "buy") return OrderSide::Buy;
+    if (side == "sell") return OrderSide::Sell;
+    return OrderSide::Unknown;
+}
+
+OrderType parse_order_type(std::string_view type) {
+    if (type == "limit") return OrderType::Limit;
+    if (type == "market") return OrderType::Market;
+    if (type == "stop_limit") return OrderType::StopLimit;
+    if (type == "stop_market") return OrderType::StopMarket;
+    if (type == "take_limit") return OrderType::TakeLimit;
+    if (type == "take_market") return OrderType::TakeMarket;
+    if (type == "market_limit") return OrderType::MarketLimit;
+    if (type == "trailing_stop") return OrderType::TrailingStop;
+    return OrderType::Unknown;
+}
+
+OrderStatus parse_order_status(std::string_view status) {
+    if (status == "open") return OrderStatus::Open;
+    if (status == "untriggered") return OrderStatus::Untriggered;
+    if (status == "filled") return OrderStatus::Filled;
+    if (status == "cancelled") return OrderStatus::Cancelled;
+    if (status == "rejected") return OrderStatus::Rejected;
+    return OrderStatus::Unknown;
+}
+
+const char* to_string(OrderSide side) {
+    switch (side) {
+    case OrderSide::Buy: return "buy";
+    case OrderSide::Sell: return "sell";
+    default: return "unknown";
+    }
+}
+
+const char* to_string(OrderType type) {
+    switch (type) {
+    case OrderType::Limit: return "limit";
+    case OrderType::Market: return "market";
+    case OrderType::StopLimit: return "stop_limit";
+    case OrderType::StopMarket: return "stop_market";
+    case OrderType::TakeLimit: return "take_limit";
+    case OrderType::TakeMarket: return "take_market";
+    case OrderType::MarketLimit: return "market_limit";
+    case OrderType::TrailingStop: return "trailing_stop";
+    default: return "unknown";
+    }
+}
+
+const char* to_string(OrderStatus status) {
+    switch (status) {
+    case OrderStatus::Pending: return "pending";
+    case OrderStatus::Open: return "open";
+    case OrderStatus::Untriggered: return "untriggered";
+    case OrderStatus::Filled: return "filled";
+    case OrderStatus::Cancelled: return "cancelled";
+    case OrderStatus::Rejected: return "rejected";
+    default: return "unknown";
+    }
+}
+
+OrderManager::OrderManager(size_t capacity)
+    : records_(capacity), instrument_heads_(new uint32_t[InstrumentRegistry::kMaxInstruments]),
+    open_counts_(new std::atomic<uint32_t>[InstrumentRegistry::kMaxInstruments]) {
+    size_t buckets = 16;
+    while (buckets < capacity) {
+        buckets <<= 1;
+    }
+    id_buckets_.assign(buckets, kNone);
+    label_buckets_.assign(buckets, kNone);
+    bucket_mask_ = buckets - 1;
+    for (size_t i = 0; i < InstrumentRegistry::kMaxInstruments; ++i) {
+        instrument_heads_[i] = kNone;
+        open_counts_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+bool OrderManager::add_order(const Order& order) {
+    if (order.id.empty()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(orders_mutex_);
+
+    uint32_t index = find(order.id.view());
+    if (index == kNone) {
+        return insert(order) != kNone;
+    }
+
+    // Same ID: relink only what changed
+    Record& record = records_[index];
+    set_label(index, order.label.view());
+    set_instrument(index, order.instrument_id);
+    record.order.side = order.side;
+    record.order.type = order.type;
+    set_status(index, order.status);
+    record.order.amount = order.amount;
+    record.order.price = order.price;
+    record.order.filled = order.filled;
+    record.order.timestamp = order.timestamp;
+    return true;
+}
+
+void OrderManager::update_order(std::string_view id, const json& update) {
+    std::lock_guard<std::mutex> lock(orders_mutex_);
+
+    uint32_t index = find(id);
+    if (index != kNone) {
+        Order& order = records_[index].order;
+        if (update.contains("amount")) order.amount = update["amount"];
+        if (update.contains("price")) order.price = update["price"];
+        if (update.contains("filled")) order.filled = update["filled"];
+        if (update.contains("status")) set_status(index, parse_order_status(update["status"].get_ref<const std::string&>()));
+    }
+}
+
+void OrderManager::remove_order(std::string_view id) {
+    std::lock_guard<std::mutex> lock(orders_mutex_);
+    uint32_t index = find(id);
+    if (index != kNone) {
+        release(index);
+    }
+}
+
+size_t OrderManager::purge_terminal() {
     std::lock_guard<std::mutex> lock(orders_mutex_);
-    orders_[order.id] = order;
+    return purge_terminal_locked();
 }
 
-void OrderManager::update_order(const std::string& id, const json& update) {
+bool OrderManager::track_new_order(const Order& order) {
+    if (order.label.empty()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(orders_mutex_);
+    // The place response or a user.orders event can beat the caller here;
+    // the order was then adopted under its label already
+    for (uint32_t i = label_buckets_[hash(order.label.view()) & bucket_mask_]; i != kNone; i = records_[i].label_next) {
+        if (records_[i].order.label.view() == order.label.view()) {
+            if (records_[i].order.send_ns == 0) {
+                records_[i].order.send_ns = order.send_ns;
+            }
+            return true;
+        }
+    }
+    uint32_t index = insert(order);
+    if (index == kNone) {
+        return false;
+    }
+    set_status(index, OrderStatus::Pending);
+    latency_for(order.instrument_id);
+    return true;
+}
+
+void OrderManager::on_place_response(std::string_view label, const json& response, InstrumentRegistry& instruments,
+    int64_t receive_ns) {
+    std::lock_guard<std::mutex> lock(orders_mutex_);
+
+    if (response.contains("result") && response["result"].contains("order")) {
+        OrderEvent event = event_from_report(response["result"]["order"]);
+        if (event.label.empty()) {
+            event.label = label;
+        }
+        apply_event(event, instruments, receive_ns);
+        return;
+    }
+
+    // No response in time, or a local send failure: a timed-out order may
+    // well be live, so it stays Pending until a user.orders event or an
+    // order report settles it, and keeps counting against open orders
+    if (PendingRequestTable::is_local_error(response)) {
+        return;
+    }
+
+    // Rejected by the exchange before reaching the book
+    uint32_t index = find_pending(label);
+    if (index == kNone) {
+        return;
+    }
+    Order& order = records_[index].order;
+    set_status(index, OrderStatus::Rejected);
+    order.ack_ns = receive_ns;
+    order.done_ns = receive_ns;
+    if (InstrumentLatency* latency = latency_for(order.instrument_id)) {
+        if (order.send_ns != 0) {
+            latency->ack.record(receive_ns - order.send_ns);
+            latency->done.record(receive_ns - order.send_ns);
+        }
+    }
+}
+
+void OrderManager::on_order_event(const OrderEvent& event, InstrumentRegistry& instruments, int64_t receive_ns) {
+    std::lock_guard<std::mutex> lock(orders_mutex_);
+    apply_event(event, instruments, receive_ns);
+}
+
+void OrderManager::on_user_trade(const UserTradeEvent& trade, int64_t receive_ns) {
     std::lock_guard<std::mutex> lock(orders_mutex_);
+    uint32_t index = find(trade.order_id);
+    if (index == kNone && !trade.label.empty()) {
+        index = find_pending(trade.label);
+    }
+    // Quantities come from user.orders; the trade only dates the first fill
+    if (index != kNone) {
+        mark_first_fill(index, receive_ns);
+    }
+}
 
-    auto it = orders_.find(id);
-    if (it != orders_.end()) {
-        if (update.contains("amount")) it->second.amount = update["amount"];
-        if (update.contains("price")) it->second.price = update["price"];
-        if (update.contains("filled")) it->second.filled = update["filled"];
-        if (update.contains("status")) it->second.status = update["status"];
+bool OrderManager::order_latency(InstrumentId instrument, OrderLatencySummary& summary) const {
+    std::lock_guard<std::mutex> lock(orders_mutex_);
+    if (instrument >= latency_.size() || !latency_[instrument] || latency_[instrument]->ack.count() == 0) {
+        return false;
     }
+    const InstrumentLatency& latency = *latency_[instrument];
+    summary.ack = latency.ack.summary();
+    summary.first_fill = latency.first_fill.summary();
+    summary.done = latency.done.summary();
+    return true;
 }
 
-void OrderManager::remove_order(const std::string& id) {
+uint64_t OrderManager::rejected_events() const {
     std::lock_guard<std::mutex> lock(orders_mutex_);
-    orders_.erase(id);
+    return rejected_events_;
 }
 
-Order OrderManager::get_order(const std::string& id) const {
+size_t OrderManager::apply_order_reports(const json& orders, InstrumentRegistry& instruments, int64_t receive_ns) {
+    if (!orders.is_array()) {
+        return 0;
+    }
     std::lock_guard<std::mutex> lock(orders_mutex_);
-    auto it = orders_.find(id);
-    if (it != orders_.end()) {
-        return it->second;
+    for (const auto& report : orders) {
+        apply_order_report(report, instruments, receive_ns);
+    }
+    return orders.size();
+}
+
+size_t OrderManager::apply_cancel_result(const json& result, InstrumentRegistry& instruments,
+    InstrumentId instrument, std::string_view label) {
+    std::lock_guard<std::mutex> lock(orders_mutex_);
+    size_t applied = 0;
+
+    if (result.is_number()) {
+        // Only a count came back: everything open in scope is gone
+        auto cancel = [this, &applied](uint32_t index) {
+            if (!is_terminal(records_[index].order.status)) {
+                set_status(index, OrderStatus::Cancelled);
+                ++applied;
+            }
+            };
+        if (instrument != kInvalidInstrument) {
+            if (instrument < InstrumentRegistry::kMaxInstruments) {
+                for (uint32_t i = instrument_heads_[instrument]; i != kNone; i = records_[i].instrument_next) {
+                    if (label.empty() || records_[i].order.label.view() == label) {
+                        cancel(i);
+                    }
+                }
+            }
+        }
+        else if (!label.empty()) {
+            for (uint32_t i = label_buckets_[hash(label) & bucket_mask_]; i != kNone; i = records_[i].label_next) {
+                if (records_[i].order.label.view() == label) {
+                    cancel(i);
+                }
+            }
+        }
+        else {
+            for (uint32_t i = 0; i < high_water_; ++i) {
+                if (records_[i].live) {
+                    cancel(i);
+                }
+            }
+        }
+        return applied;
+    }
+
+    if (!result.is_array()) {
+        return 0;
     }
-    return {};
+    // Detailed results are order reports, possibly grouped per instrument
+    for (const auto& entry : result) {
+        if (entry.contains("order_id")) {
+            apply_order_report(entry, instruments, 0);
+            ++applied;
+        }
+        else if (entry.contains("result") && entry["result"].is_array()) {
+            for (const auto& report : entry["result"]) {
+                apply_order_report(report, instruments, 0);
+                ++applied;
+            }
+        }
+    }
+    return applied;
 }
 
-std::vector<Order> OrderManager::get_orders() const {
+bool OrderManager::get_order(std::string_view id, Order& order) const {
     std::lock_guard<std::mutex> lock(orders_mutex_);
-    std::vector<Order> result;
-    for (const auto& pair : orders_) {
-        result.push_back(pair.second);
+    uint32_t index = find(id);
+    if (index == kNone) {
+        return false;
     }
-    return result;
+    order = records_[index].order;
+    return true;
 }
 
-std::vector<Order> OrderManager::get_orders_for_instrument(const std::string& instrument) const {
+size_t OrderManager::size() const {
     std::lock_guard<std::mutex> lock(orders_mutex_);
-    std::vector<Order> result;
-    for (const auto& pair : orders_) {
-        if (pair.second.instrument == instrument) {
-            result.push_back(pair.second);
+    return count_;
+}
+
+uint64_t OrderManager::hash(std::string_view key) {
+    // FNV-1a
+    uint64_t h = 14695981039346656037ull;
+    for (char c : key) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+uint32_t OrderManager::find(std::string_view id) const {
+    for (uint32_t i = id_buckets_[hash(id) & bucket_mask_]; i != kNone; i = records_[i].id_next) {
+        if (records_[i].order.id.view() == id) {
+            return i;
+        }
+    }
+    return kNone;
+}
+
+uint32_t OrderManager::find_pending(std::string_view label) const {
+    for (uint32_t i = label_buckets_[hash(label) & bucket_mask_]; i != kNone; i = records_[i].label_next) {
+        const Order& order = records_[i].order;
+        if (order.id.empty() && order.label.view() == label) {
+            return i;
+        }
+    }
+    return kNone;
+}
+
+uint32_t OrderManager::insert(const Order& order) {
+    uint32_t index = allocate();
+    if (index == kNone && purge_terminal_locked() > 0) {
+        index = allocate();
+    }
+    if (index == kNone) {
+        std::cerr << "Order store full, cannot track " << (order.id.empty() ? order.label.view() : order.id.view())
+            << std::endl;
+        return kNone;
+    }
+    Record& record = records_[index];
+    record.order = order;
+    record.live = true;
+    ++count_;
+    link_id(index);
+    link_label(index);
+    link_instrument(index);
+    return index;
+}
+
+uint32_t OrderManager::allocate() {
+    if (free_head_ != kNone) {
+        uint32_t index = free_head_;
+        free_head_ = records_[index].id_next;
+        return index;
+    }
+    if (high_water_ < records_.size()) {
+        return high_water_++;
+    }
+    return kNone;
+}
+
+void OrderManager::release(uint32_t index) {
+    unlink_id(index);
+    unlink_label(index);
+    unlink_instrument(index);
+    Record& record = records_[index];
+    record.live = false;
+    record.id_next = free_head_;
+    free_head_ = index;
+    --count_;
+}
+
+void OrderManager::link_id(uint32_t index) {
+    // Orders awaiting their exchange ID are reachable by label only
+    if (records_[index].order.id.empty()) {
+        return;
+    }
+    uint32_t& head = id_buckets_[hash(records_[index].order.id.view()) & bucket_mask_];
+    records_[index].id_next = head;
+    head = index;
+}
+
+void OrderManager::unlink_id(uint32_t index) {
+    if (records_[index].order.id.empty()) {
+        return;
+    }
+    uint32_t* link = &id_buckets_[hash(records_[index].order.id.view()) & bucket_mask_];
+    while (*link != index) {
+        link = &records_[*link].id_next;
+    }
+    *link = records_[index].id_next;
+    records_[index].id_next = kNone;
+}
+
+void OrderManager::link_label(uint32_t index) {
+    if (records_[index].order.label.empty()) {
+        return;
+    }
+    uint32_t& head = label_buckets_[hash(records_[index].order.label.view()) & bucket_mask_];
+    records_[index].label_next = head;
+    head = index;
+}
+
+void OrderManager::unlink_label(uint32_t index) {
+    if (records_[index].order.label.empty()) {
+        return;
+    }
+    uint32_t* link = &label_buckets_[hash(records_[index].order.label.view()) & bucket_mask_];
+    while (*link != index) {
+        link = &records_[*link].label_next;
+    }
+    *link = records_[index].label_next;
+    records_[index].label_next = kNone;
+}
+
+void OrderManager::link_instrument(uint32_t index) {
+    Record& record = records_[index];
+    InstrumentId instrument = record.order.instrument_id;
+    if (instrument >= InstrumentRegistry::kMaxInstruments) {
+        return;
+    }
+    record.instrument_prev = kNone;
+    record.instrument_next = instrument_heads_[instrument];
+    if (record.instrument_next != kNone) {
+        records_[record.instrument_next].instrument_prev = index;
+    }
+    instrument_heads_[instrument] = index;
+    count_open(instrument, record.order.status, 1);
+}
+
+void OrderManager::unlink_instrument(uint32_t index) {
+    Record& record = records_[index];
+    InstrumentId instrument = record.order.instrument_id;
+    if (instrument >= InstrumentRegistry::kMaxInstruments) {
+        return;
+    }
+    if (record.instrument_prev != kNone) {
+        records_[record.instrument_prev].instrument_next = record.instrument_next;
+    }
+    else {
+        instrument_heads_[instrument] = record.instrument_next;
+    }
+    if (record.instrument_next != kNone) {
+        records_[record.instrument_next].instrument_prev = record.instrument_prev;
+    }
+    record.instrument_prev = kNone;
+    record.instrument_next = kNone;
+    count_open(instrument, record.order.status, -1);
+}
+
+void OrderManager::set_label(uint32_t index, std::string_view label) {
+    if (records_[index].order.label.view() == label) {
+        return;
+    }
+    unlink_label(index);
+    records_[index].order.label.assign(label);
+    link_label(index);
+}
+
+void OrderManager::set_instrument(uint32_t index, InstrumentId instrument) {
+    if (records_[index].order.instrument_id == instrument) {
+        return;
+    }
+    unlink_instrument(index);
+    records_[index].order.instrument_id = instrument;
+    link_instrument(index);
+}
+
+void OrderManager::set_status(uint32_t index, OrderStatus status) {
+    Order& order = records_[index].order;
+    if (is_terminal(order.status) != is_terminal(status)) {
+        count_open(order.instrument_id, order.status, -1);
+        count_open(order.instrument_id, status, 1);
+    }
+    order.status = status;
+}
+
+void OrderManager::count_open(InstrumentId instrument, OrderStatus status, int delta) {
+    if (instrument >= InstrumentRegistry::kMaxInstruments || is_terminal(status)) {
+        return;
+    }
+    // Single writer (under the lock), so no read-modify-write is needed
+    uint32_t count = open_counts_[instrument].load(std::memory_order_relaxed);
+    open_counts_[instrument].store(count + delta, std::memory_order_relaxed);
+}
+
+size_t OrderManager::purge_terminal_locked() {
+    size_t purged = 0;
+    for (uint32_t i = 0; i < high_water_; ++i) {
+        if (records_[i].live && is_terminal(records_[i].order.status)) {
+            release(i);
+            ++purged;
+        }
+    }
+    return purged;
+}
+
+void OrderManager::apply_order_report(const json& report, InstrumentRegistry& instruments, int64_t receive_ns) {
+    if (report.contains("order_id")) {
+        apply_event(event_from_report(report), instruments, receive_ns);
+    }
+}
+
+void OrderManager::apply_event(const OrderEvent& event, InstrumentRegistry& instruments, int64_t receive_ns) {
+    uint32_t index = event.order_id.empty() ? kNone : find(event.order_id);
+    if (index == kNone && !event.label.empty()) {
+        // First sight of the exchange ID for an order placed from here
+        index = find_pending(event.label);
+        if (index != kNone && records_[index].order.id.assign(event.order_id)) {
+            link_id(index);
+        }
+    }
+    if (index == kNone) {
+        // Orders placed elsewhere (another session, the web UI) are adopted
+        if (event.order_id.empty()) {
+            return;
+        }
+        Order adopted;
+        if (!adopted.id.assign(event.order_id)) {
+            std::cerr << "Cannot track order " << event.order_id << std::endl;
+            return;
+        }
+        index = insert(adopted);
+        if (index == kNone) {
+            return;
         }
     }
-    return result;
-}
\ No newline at end of file
+
+    Order& order = records_[index].order;
+    // Notifications may overtake the place response or each other
+    if (event.last_update_timestamp != 0 && event.last_update_timestamp < order.timestamp) {
+        ++rejected_events_;
+        return;
+    }
+    OrderStatus next = event.order_state.empty() ? order.status : parse_order_status(event.order_state);
+    if (!valid_transition(order.status, next)) {
+        ++rejected_events_;
+        std::cerr << "Ignoring " << to_string(order.status) << " -> " << to_string(next)
+            << " for order " << order.id.view() << std::endl;
+        return;
+    }
+
+    // Usually already known: compared lock-free, then looked up without
+    // allocating; only a name never seen before is interned
+    if (!event.instrument_name.empty() && (order.instrument_id == kInvalidInstrument ||
+        instruments.name(order.instrument_id) != event.instrument_name)) {
+        InstrumentId instrument = instruments.find(event.instrument_name);
+        if (instrument == kInvalidInstrument) {
+            instrument = instruments.intern(std::string(event.instrument_name));
+        }
+        set_instrument(index, instrument);
+    }
+    if (!event.label.empty()) {
+        set_label(index, event.label);
+    }
+    if (!event.direction.empty()) order.side = parse_order_side(event.direction);
+    if (!event.order_type.empty()) order.type = parse_order_type(event.order_type);
+    if (event.amount > 0) order.amount = event.amount;
+    // Market orders report "market_price", which decodes to 0
+    if (event.price > 0) order.price = event.price;
+    order.filled = std::max(order.filled, event.filled_amount);
+    if (event.last_update_timestamp != 0) order.timestamp = event.last_update_timestamp;
+
+    if (receive_ns != 0) {
+        InstrumentLatency* latency = latency_for(order.instrument_id);
+        bool measured = latency && order.send_ns != 0;
+        if (order.ack_ns == 0 && next != OrderStatus::Pending) {
+            order.ack_ns = receive_ns;
+            if (measured) latency->ack.record(receive_ns - order.send_ns);
+        }
+        if (order.filled > 0) {
+            mark_first_fill(index, receive_ns);
+        }
+        if (order.done_ns == 0 && is_terminal(next)) {
+            order.done_ns = receive_ns;
+            if (measured) latency->done.record(receive_ns - order.send_ns);
+        }
+    }
+    set_status(index, next);
+}
+
+void OrderManager::mark_first_fill(uint32_t index, int64_t receive_ns) {
+    Order& order = records_[index].order;
+    if (order.first_fill_ns != 0 || receive_ns == 0) {
+        return;
+    }
+    order.first_fill_ns = receive_ns;
+    InstrumentLatency* latency = latency_for(order.instrument_id);
+    if (latency && order.send_ns != 0) {
+        latency->first_fill.record(receive_ns - order.send_ns);
+    }
+}
+
+OrderManager::InstrumentLatency* OrderManager::latency_for(InstrumentId instrument) {
+    if (instrument >= InstrumentRegistry::kMaxInstruments) {
+        return nullptr;
+    }
+    if (latency_.empty()) {
+        latency_.resize(InstrumentRegistry::kMaxInstruments);
+    }
+    if (!latency_[instrument]) {
+        latency_[instrument] = std::make_unique<InstrumentLatency>();
+    }
+    return latency_[instrument].get();
+}
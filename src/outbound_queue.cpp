@@ -0,0 +1,98 @@
+#include "outbound_queue.h"
+#include <cstring>
+
+OutboundQueue::OutboundQueue(size_t lane_capacity)
+    : lanes_{ MpscQueue<OutboundFrame>(lane_capacity), MpscQueue<OutboundFrame>(lane_capacity),
+        MpscQueue<OutboundFrame>(lane_capacity) } {
+}
+
+bool OutboundQueue::push(SendPriority priority, std::string_view payload, int64_t request_id, int64_t now_ns,
+    std::string_view merge_key) {
+    OutboundFrame frame;
+    frame.enqueue_ns = now_ns;
+    frame.request_id = request_id;
+    frame.size = static_cast<uint32_t>(payload.size());
+    // Keys too long to store are simply not merged
+    if (!merge_key.empty() && merge_key.size() <= OutboundFrame::kMaxMergeKey) {
+        std::memcpy(frame.merge_key, merge_key.data(), merge_key.size());
+        frame.merge_key_size = static_cast<uint8_t>(merge_key.size());
+    }
+    if (payload.size() <= sizeof(frame.inline_payload)) {
+        std::memcpy(frame.inline_payload, payload.data(), payload.size());
+    }
+    else {
+        frame.heap_payload.assign(payload.data(), payload.size());
+    }
+    return push_frame(priority, std::move(frame));
+}
+
+bool OutboundQueue::push(SendPriority priority, std::string&& payload, int64_t request_id, int64_t now_ns) {
+    if (payload.size() <= OrderEncoder::kCapacity) {
+        return push(priority, std::string_view(payload), request_id, now_ns);
+    }
+    OutboundFrame frame;
+    frame.enqueue_ns = now_ns;
+    frame.request_id = request_id;
+    frame.size = static_cast<uint32_t>(payload.size());
+    frame.heap_payload = std::move(payload);
+    return push_frame(priority, std::move(frame));
+}
+
+bool OutboundQueue::pop(OutboundFrame& frame) {
+    for (auto& lane : lanes_) {
+        if (lane.try_pop(frame)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool OutboundQueue::pop(SendPriority priority, OutboundFrame& frame) {
+    return lanes_[static_cast<size_t>(priority)].try_pop(frame);
+}
+
+void OutboundQueue::record_sent(const OutboundFrame& frame, int64_t now_ns) {
+    latency_.record(now_ns - frame.enqueue_ns);
+    sent_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void OutboundQueue::record_batch(size_t frames) {
+    if (frames == 0) {
+        return;
+    }
+    batches_.fetch_add(1, std::memory_order_relaxed);
+    if (frames > max_batch_.load(std::memory_order_relaxed)) {
+        max_batch_.store(frames, std::memory_order_relaxed);
+    }
+}
+
+bool OutboundQueue::empty() const {
+    for (const auto& lane : lanes_) {
+        if (!lane.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+OutboundStats OutboundQueue::stats() const {
+    OutboundStats result;
+    result.enqueued = enqueued_.load(std::memory_order_relaxed);
+    result.sent = sent_.load(std::memory_order_relaxed);
+    result.rejected = rejected_.load(std::memory_order_relaxed);
+    result.batches = batches_.load(std::memory_order_relaxed);
+    result.max_batch = max_batch_.load(std::memory_order_relaxed);
+    for (const auto& lane : lanes_) {
+        result.depth += lane.size();
+    }
+    return result;
+}
+
+bool OutboundQueue::push_frame(SendPriority priority, OutboundFrame&& frame) {
+    if (!lanes_[static_cast<size_t>(priority)].try_push(std::move(frame))) {
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    enqueued_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
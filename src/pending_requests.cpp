@@ -0,0 +1,196 @@
+#include "pending_requests.h"
+#include <algorithm>
+
+PendingRequestTable::PendingRequestTable(size_t capacity)
+    : armed_(capacity), wheel_(kWheelSlots, kNoSlot) {
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    mask_ = size - 1;
+    slots_.reset(new Slot[size]);
+}
+
+int64_t PendingRequestTable::next_id() {
+    return next_id_.fetch_add(1, std::memory_order_relaxed);
+}
+
+int64_t PendingRequestTable::add(ResponseHandler&& handler, TimeoutHandler&& on_timeout,
+    int64_t timeout_ns, int64_t now_ns) {
+    // A busy slot means its occupant is still waiting after `capacity` newer
+    // requests; skip to the next ID rather than wait for it
+    for (int attempt = 0; attempt < kClaimAttempts; ++attempt) {
+        int64_t id = next_id();
+        Slot& slot = slots_[index_of(id)];
+        uint64_t state = slot.state.load(std::memory_order_relaxed);
+        if ((state & 3) != Free ||
+            !slot.state.compare_exchange_strong(state, pack(id, Claimed), std::memory_order_acquire)) {
+            continue;
+        }
+
+        slot.handler = std::move(handler);
+        slot.on_timeout = std::move(on_timeout);
+        slot.sent_ns = now_ns;
+        slot.deadline_ns = now_ns + (timeout_ns > 0 ? timeout_ns : kDefaultTimeoutNs);
+        in_flight_.fetch_add(1, std::memory_order_relaxed);
+        slot.state.store(pack(id, Pending), std::memory_order_release);
+
+        // At most one arm per in-flight slot is outstanding, so this only
+        // fails if the owner thread has stalled; the request then still
+        // completes but can no longer time out
+        int64_t armed = id;
+        armed_.try_push(std::move(armed));
+        return id;
+    }
+
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+    return 0;
+}
+
+bool PendingRequestTable::is_pending(int64_t id) const {
+    if (id <= 0) {
+        return false;
+    }
+    return slots_[index_of(id)].state.load(std::memory_order_acquire) == pack(id, Pending);
+}
+
+bool PendingRequestTable::complete(int64_t id, const json& response, int64_t receive_ns) {
+    if (id <= 0) {
+        return false;
+    }
+    uint32_t index = index_of(id);
+    Slot& slot = slots_[index];
+    uint64_t expected = pack(id, Pending);
+    if (!slot.state.compare_exchange_strong(expected, pack(id, Claimed), std::memory_order_acquire)) {
+        return false;
+    }
+
+    latency_.record(receive_ns - slot.sent_ns);
+    ResponseHandler handler = std::move(slot.handler);
+    release(index, id);
+    completed_.fetch_add(1, std::memory_order_relaxed);
+
+    // The slot is already reusable, so the handler may issue new requests
+    if (handler) {
+        handler(response);
+    }
+    return true;
+}
+
+size_t PendingRequestTable::expire(int64_t now_ns) {
+    drain_armed();
+
+    int64_t tick = now_ns / kTickNs;
+    if (wheel_tick_ < 0) {
+        wheel_tick_ = tick;
+    }
+    if (tick <= wheel_tick_) {
+        return 0;
+    }
+
+    // Visit every bucket passed since the last call, each at most once
+    int64_t first = std::max(wheel_tick_ + 1, tick - static_cast<int64_t>(kWheelSlots) + 1);
+    wheel_tick_ = tick;
+
+    size_t expired = 0;
+    for (int64_t t = first; t <= tick; ++t) {
+        uint32_t index = wheel_[static_cast<size_t>(t) & (kWheelSlots - 1)];
+        while (index != kNoSlot) {
+            Slot& slot = slots_[index];
+            uint32_t next = slot.wheel_next;
+            // Entries more than one wheel revolution out stay for a later lap
+            if (slot.deadline_ns <= now_ns) {
+                uint64_t state = slot.state.load(std::memory_order_relaxed);
+                int64_t id = static_cast<int64_t>(state >> 2);
+                if (slot.state.compare_exchange_strong(state, pack(id, Claimed), std::memory_order_acquire)) {
+                    TimeoutHandler on_timeout = std::move(slot.on_timeout);
+                    ResponseHandler handler = std::move(slot.handler);
+                    release(index, id);
+                    timed_out_.fetch_add(1, std::memory_order_relaxed);
+                    ++expired;
+                    if (on_timeout) {
+                        on_timeout(id);
+                    }
+                    // Callers waiting on a response learn it is not coming
+                    if (handler) {
+                        handler(error_response(id, kRequestTimeout, "request_timeout"));
+                    }
+                }
+            }
+            index = next;
+        }
+    }
+    return expired;
+}
+
+json PendingRequestTable::error_response(int64_t id, int code, const char* message) {
+    return {
+        {"jsonrpc", "2.0"},
+        {"id", id},
+        {"error", {{"code", code}, {"message", message}}}
+    };
+}
+
+PendingRequestStats PendingRequestTable::stats() const {
+    PendingRequestStats result;
+    result.in_flight = in_flight_.load(std::memory_order_relaxed);
+    result.completed = completed_.load(std::memory_order_relaxed);
+    result.timed_out = timed_out_.load(std::memory_order_relaxed);
+    result.rejected = rejected_.load(std::memory_order_relaxed);
+    return result;
+}
+
+void PendingRequestTable::drain_armed() {
+    int64_t id;
+    while (armed_.try_pop(id)) {
+        uint32_t index = index_of(id);
+        // Requests that completed before their arm was drained are skipped
+        if (slots_[index].state.load(std::memory_order_acquire) == pack(id, Pending) &&
+            slots_[index].wheel_bucket < 0) {
+            link(index);
+        }
+    }
+}
+
+void PendingRequestTable::link(uint32_t index) {
+    Slot& slot = slots_[index];
+    // A deadline that has already passed goes into the next bucket visited
+    int64_t tick = std::max(slot.deadline_ns / kTickNs, wheel_tick_ + 1);
+    size_t bucket = static_cast<size_t>(tick) & (kWheelSlots - 1);
+
+    slot.wheel_bucket = static_cast<int32_t>(bucket);
+    slot.wheel_prev = kNoSlot;
+    slot.wheel_next = wheel_[bucket];
+    if (slot.wheel_next != kNoSlot) {
+        slots_[slot.wheel_next].wheel_prev = index;
+    }
+    wheel_[bucket] = index;
+}
+
+void PendingRequestTable::unlink(uint32_t index) {
+    Slot& slot = slots_[index];
+    if (slot.wheel_bucket < 0) {
+        return;
+    }
+    if (slot.wheel_prev != kNoSlot) {
+        slots_[slot.wheel_prev].wheel_next = slot.wheel_next;
+    }
+    else {
+        wheel_[static_cast<size_t>(slot.wheel_bucket)] = slot.wheel_next;
+    }
+    if (slot.wheel_next != kNoSlot) {
+        slots_[slot.wheel_next].wheel_prev = slot.wheel_prev;
+    }
+    slot.wheel_prev = kNoSlot;
+    slot.wheel_next = kNoSlot;
+    slot.wheel_bucket = -1;
+}
+
+void PendingRequestTable::release(uint32_t index, int64_t id) {
+    Slot& slot = slots_[index];
+    unlink(index);
+    slot.handler = nullptr;
+    slot.on_timeout = nullptr;
+    in_flight_.fetch_sub(1, std::memory_order_relaxed);
+    slot.state.store(pack(id, Free), std::memory_order_release);
+}
@@ -0,0 +1,257 @@
+#include "position_engine.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// Below this a position is treated as flat
+constexpr double kFlatSize = 1e-9;
+
+bool is_flat(double size) {
+    return std::fabs(size) < kFlatSize;
+}
+
+}
+
+PositionEngine::PositionEngine(const InstrumentRegistry& registry)
+    : registry_(registry),
+    positions_(new std::atomic<PositionState*>[InstrumentRegistry::kMaxInstruments]),
+    held_(new InstrumentId[InstrumentRegistry::kMaxInstruments]),
+    currencies_(new CurrencyState[kMaxCurrencies]) {
+    for (size_t i = 0; i < InstrumentRegistry::kMaxInstruments; ++i) {
+        positions_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+PositionEngine::~PositionEngine() {
+    for (size_t i = 0; i < InstrumentRegistry::kMaxInstruments; ++i) {
+        delete positions_[i].load(std::memory_order_relaxed);
+    }
+}
+
+void PositionEngine::seed(const json& positions, int64_t requested_ms) {
+    if (seeded()) {
+        return;
+    }
+    if (positions.is_array()) {
+        for (const auto& entry : positions) {
+            std::string name = entry.value("instrument_name", "");
+            double size = entry.value("size", 0.0);
+            if (name.empty() || is_flat(size)) {
+                continue;
+            }
+            PositionState* state = state_for(registry_.find(name));
+            if (!state) {
+                std::cerr << "Cannot track position in " << name << std::endl;
+                continue;
+            }
+            state->current.size = size;
+            state->current.average_price = entry.value("average_price", 0.0);
+            reprice(*state, entry.value("mark_price", 0.0), entry.value("realized_profit_loss", 0.0), false);
+        }
+    }
+
+    seeded_.store(true, std::memory_order_release);
+    for (const PendingFill& fill : pending_fills_) {
+        if (fill.timestamp >= requested_ms) {
+            on_fill(fill.instrument, fill.side, fill.amount, fill.price, fill.fee, fill.timestamp);
+        }
+    }
+    pending_fills_.clear();
+    pending_fills_.shrink_to_fit();
+}
+
+void PositionEngine::on_fill(InstrumentId instrument, OrderSide side, double amount, double price, double fee,
+    int64_t timestamp) {
+    if (side == OrderSide::Unknown || !(amount > 0) || !(price > 0)) {
+        return;
+    }
+    if (!seeded()) {
+        pending_fills_.push_back({ instrument, side, amount, price, fee, timestamp });
+        return;
+    }
+    PositionState* state = state_for(instrument);
+    if (state) {
+        apply_fill(*state, side, amount, price, fee, timestamp);
+    }
+}
+
+void PositionEngine::on_book_update(InstrumentId instrument, const MarketData& market_data) {
+    PositionState* state = instrument < InstrumentRegistry::kMaxInstruments ?
+        positions_[instrument].load(std::memory_order_relaxed) : nullptr;
+    if (!state || is_flat(state->current.size)) {
+        return;
+    }
+    TopOfBook top;
+    if (!market_data.get_top_of_book(instrument, top)) {
+        return;
+    }
+    double mark = top.bid_price > 0 && top.ask_price > 0 ? 0.5 * (top.bid_price + top.ask_price) :
+        std::max(top.bid_price, top.ask_price);
+    if (mark > 0 && mark != state->current.mark_price) {
+        state->current.timestamp = top.timestamp;
+        reprice(*state, mark, 0.0, true);
+    }
+}
+
+bool PositionEngine::get_position(InstrumentId instrument, Position& position) const {
+    const PositionState* state = find_state(instrument);
+    if (!state) {
+        return false;
+    }
+    position = state->published.load();
+    return true;
+}
+
+double PositionEngine::size(InstrumentId instrument) const {
+    const PositionState* state = find_state(instrument);
+    if (!state) {
+        return 0.0;
+    }
+    double size = 0;
+    state->published.read([&size](const Position& position) { size = position.size; });
+    return size;
+}
+
+bool PositionEngine::get_totals(uint32_t currency, CurrencyTotals& totals) const {
+    if (currency >= currency_count()) {
+        return false;
+    }
+    totals = currencies_[currency].published.load();
+    return true;
+}
+
+std::string_view PositionEngine::currency_name(uint32_t currency) const {
+    if (currency >= currency_count()) {
+        return std::string_view();
+    }
+    return std::string_view(currencies_[currency].name, currencies_[currency].length);
+}
+
+PositionEngine::PositionState* PositionEngine::state_for(InstrumentId instrument) {
+    if (instrument >= InstrumentRegistry::kMaxInstruments) {
+        return nullptr;
+    }
+    PositionState* state = positions_[instrument].load(std::memory_order_relaxed);
+    if (state) {
+        return state;
+    }
+    uint32_t currency = currency_for(instrument);
+    if (currency == UINT32_MAX) {
+        return nullptr;
+    }
+
+    const InstrumentInfo& info = registry_.info(instrument);
+    state = new PositionState();
+    // Inverse options are still priced in coin, so their PnL is linear
+    state->inverse = info.inverse && info.kind != InstrumentKind::Option;
+    state->current.instrument_id = instrument;
+    state->current.currency = currency;
+    state->published.store(state->current);
+    positions_[instrument].store(state, std::memory_order_release);
+
+    size_t held = held_count_.load(std::memory_order_relaxed);
+    held_[held] = instrument;
+    held_count_.store(held + 1, std::memory_order_release);
+    return state;
+}
+
+const PositionEngine::PositionState* PositionEngine::find_state(InstrumentId instrument) const {
+    if (instrument >= InstrumentRegistry::kMaxInstruments) {
+        return nullptr;
+    }
+    return positions_[instrument].load(std::memory_order_acquire);
+}
+
+uint32_t PositionEngine::currency_for(InstrumentId instrument) {
+    const InstrumentInfo& info = registry_.info(instrument);
+    std::string_view name = !info.settlement_currency.empty() ? std::string_view(info.settlement_currency) :
+        std::string_view(info.name).substr(0, info.name.find('-'));
+
+    size_t count = currency_count_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; ++i) {
+        if (currency_name(static_cast<uint32_t>(i)) == name) {
+            return static_cast<uint32_t>(i);
+        }
+    }
+    if (count == kMaxCurrencies || name.size() > sizeof(CurrencyState::name)) {
+        std::cerr << "Cannot track PnL in currency " << name << std::endl;
+        return UINT32_MAX;
+    }
+    CurrencyState& currency = currencies_[count];
+    std::memcpy(currency.name, name.data(), name.size());
+    currency.length = static_cast<uint8_t>(name.size());
+    currency.published.store(currency.current);
+    currency_count_.store(count + 1, std::memory_order_release);
+    return static_cast<uint32_t>(count);
+}
+
+void PositionEngine::apply_fill(PositionState& state, OrderSide side, double amount, double price, double fee,
+    int64_t timestamp) {
+    Position& position = state.current;
+    bool was_open = !is_flat(position.size);
+    double signed_amount = side == OrderSide::Buy ? amount : -amount;
+    double realized = -fee;
+
+    if (!was_open || (position.size > 0) == (signed_amount > 0)) {
+        // Adding to the position: inverse contracts average in 1/price
+        double held = std::fabs(position.size);
+        if (!was_open) {
+            position.average_price = price;
+        }
+        else if (state.inverse) {
+            position.average_price = (held + amount) / (held / position.average_price + amount / price);
+        }
+        else {
+            position.average_price = (held * position.average_price + amount * price) / (held + amount);
+        }
+        position.size += signed_amount;
+    }
+    else {
+        double closed = std::min(amount, std::fabs(position.size));
+        realized += pnl(state, position.size > 0 ? closed : -closed, position.average_price, price);
+        position.size += signed_amount;
+        if (is_flat(position.size)) {
+            position.size = 0;
+            position.average_price = 0;
+        }
+        else if ((position.size > 0) == (signed_amount > 0)) {
+            // Flipped: the remainder opens at the fill price
+            position.average_price = price;
+        }
+    }
+
+    position.timestamp = timestamp;
+    reprice(state, position.mark_price > 0 ? position.mark_price : price, realized, was_open);
+}
+
+void PositionEngine::reprice(PositionState& state, double mark_price, double realized_change, bool was_open) {
+    Position& position = state.current;
+    double previous_unrealized = position.unrealized_pnl;
+    position.mark_price = mark_price;
+    position.realized_pnl += realized_change;
+    position.unrealized_pnl = is_flat(position.size) || mark_price <= 0 ? 0.0 :
+        pnl(state, position.size, position.average_price, mark_price);
+    state.published.store(position);
+
+    CurrencyState& currency = currencies_[position.currency];
+    currency.current.realized_pnl += realized_change;
+    currency.current.unrealized_pnl += position.unrealized_pnl - previous_unrealized;
+    bool is_open = !is_flat(position.size);
+    if (is_open && !was_open) {
+        ++currency.current.open_positions;
+    }
+    else if (was_open && !is_open) {
+        --currency.current.open_positions;
+    }
+    currency.published.store(currency.current);
+}
+
+double PositionEngine::pnl(const PositionState& state, double size, double from_price, double to_price) {
+    if (state.inverse) {
+        return from_price > 0 && to_price > 0 ? size * (1.0 / from_price - 1.0 / to_price) : 0.0;
+    }
+    return size * (to_price - from_price);
+}
@@ -0,0 +1,246 @@
+#include "price_ladder.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+inline size_t highest_bit(uint64_t bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, bits);
+    return index;
+#else
+    return 63 - static_cast<size_t>(__builtin_clzll(bits));
+#endif
+}
+
+inline size_t lowest_bit(uint64_t bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return index;
+#else
+    return static_cast<size_t>(__builtin_ctzll(bits));
+#endif
+}
+
+}
+
+PriceLadder::PriceLadder(BookSide side, size_t capacity)
+    : side_(side), capacity_((capacity + 63) & ~size_t(63)) {
+    sizes_.assign(capacity_, 0.0);
+    occupied_.assign(capacity_ / 64, 0);
+    summary_.assign((occupied_.size() + 63) / 64, 0);
+}
+
+void PriceLadder::set_tick_size(double tick_size) {
+    if (tick_size <= 0 || tick_size == tick_size_) {
+        return;
+    }
+    clear();
+    tick_size_ = tick_size;
+    inv_tick_size_ = 1.0 / tick_size;
+}
+
+void PriceLadder::set(double price, double amount) {
+    if (amount <= 0) {
+        erase_tick(to_tick(price));
+    }
+    else {
+        set_tick(to_tick(price), amount);
+    }
+}
+
+void PriceLadder::erase(double price) {
+    erase_tick(to_tick(price));
+}
+
+void PriceLadder::clear() {
+    if (window_levels_ > 0) {
+        for (size_t slot = find_at_or_above(0); slot != capacity_; slot = find_at_or_above(slot + 1)) {
+            sizes_[slot] = 0.0;
+            unmark(slot);
+        }
+    }
+    overflow_.clear();
+    anchored_ = false;
+    best_tick_ = kNoTick;
+    levels_ = 0;
+    window_levels_ = 0;
+}
+
+double PriceLadder::best_amount() const {
+    if (best_tick_ == kNoTick) {
+        return 0.0;
+    }
+    if (in_window(best_tick_)) {
+        return sizes_[static_cast<size_t>(best_tick_ - base_tick_)];
+    }
+    auto it = overflow_.find(best_tick_);
+    return it != overflow_.end() ? it->second : 0.0;
+}
+
+void PriceLadder::set_tick(int64_t tick, double amount) {
+    if (!in_window(tick) && (window_levels_ == 0 || better(tick, best_tick_))) {
+        // The touch moved off the window: follow it so the hot levels stay contiguous
+        recenter(tick);
+    }
+
+    if (in_window(tick)) {
+        size_t slot = static_cast<size_t>(tick - base_tick_);
+        if (sizes_[slot] == 0.0) {
+            mark(slot);
+            ++levels_;
+            ++window_levels_;
+        }
+        sizes_[slot] = amount;
+    }
+    else {
+        auto result = overflow_.emplace(tick, amount);
+        if (result.second) {
+            ++levels_;
+        }
+        else {
+            result.first->second = amount;
+        }
+    }
+
+    if (better(tick, best_tick_)) {
+        best_tick_ = tick;
+    }
+}
+
+void PriceLadder::erase_tick(int64_t tick) {
+    if (in_window(tick)) {
+        size_t slot = static_cast<size_t>(tick - base_tick_);
+        if (sizes_[slot] == 0.0) {
+            return;
+        }
+        sizes_[slot] = 0.0;
+        unmark(slot);
+        --levels_;
+        --window_levels_;
+    }
+    else if (overflow_.erase(tick) > 0) {
+        --levels_;
+    }
+    else {
+        return;
+    }
+
+    if (tick == best_tick_) {
+        refresh_best();
+    }
+}
+
+void PriceLadder::mark(size_t slot) {
+    size_t word = slot >> 6;
+    occupied_[word] |= uint64_t(1) << (slot & 63);
+    summary_[word >> 6] |= uint64_t(1) << (word & 63);
+}
+
+void PriceLadder::unmark(size_t slot) {
+    size_t word = slot >> 6;
+    occupied_[word] &= ~(uint64_t(1) << (slot & 63));
+    if (occupied_[word] == 0) {
+        summary_[word >> 6] &= ~(uint64_t(1) << (word & 63));
+    }
+}
+
+void PriceLadder::recenter(int64_t center_tick) {
+    // Park the window levels in the overflow map, move the window, then pull
+    // back whatever falls inside it. Only happens when the touch drifts by
+    // half a window, so the map allocations stay off the steady-state path.
+    if (window_levels_ > 0) {
+        for (size_t slot = find_at_or_above(0); slot != capacity_; slot = find_at_or_above(slot + 1)) {
+            overflow_[base_tick_ + static_cast<int64_t>(slot)] = sizes_[slot];
+            sizes_[slot] = 0.0;
+            unmark(slot);
+        }
+        window_levels_ = 0;
+    }
+
+    base_tick_ = center_tick - static_cast<int64_t>(capacity_ / 2);
+    anchored_ = true;
+
+    auto first = overflow_.lower_bound(base_tick_);
+    auto last = overflow_.lower_bound(base_tick_ + static_cast<int64_t>(capacity_));
+    for (auto it = first; it != last; ++it) {
+        size_t slot = static_cast<size_t>(it->first - base_tick_);
+        sizes_[slot] = it->second;
+        mark(slot);
+        ++window_levels_;
+    }
+    overflow_.erase(first, last);
+}
+
+void PriceLadder::refresh_best() {
+    best_tick_ = kNoTick;
+    if (window_levels_ > 0) {
+        size_t slot = side_ == BookSide::Bid ? find_at_or_below(capacity_ - 1) : find_at_or_above(0);
+        best_tick_ = base_tick_ + static_cast<int64_t>(slot);
+    }
+    if (!overflow_.empty()) {
+        int64_t candidate = side_ == BookSide::Bid ? overflow_.rbegin()->first : overflow_.begin()->first;
+        if (better(candidate, best_tick_)) {
+            best_tick_ = candidate;
+        }
+    }
+    if (window_levels_ == 0 && best_tick_ != kNoTick) {
+        recenter(best_tick_);
+    }
+}
+
+size_t PriceLadder::find_at_or_below(size_t slot) const {
+    size_t word = slot >> 6;
+    uint64_t bits = occupied_[word] & (~uint64_t(0) >> (63 - (slot & 63)));
+    if (bits) {
+        return (word << 6) + highest_bit(bits);
+    }
+    if (word == 0) {
+        return capacity_;
+    }
+
+    size_t prev = word - 1;
+    size_t index = prev >> 6;
+    uint64_t summary = summary_[index] & (~uint64_t(0) >> (63 - (prev & 63)));
+    while (true) {
+        if (summary) {
+            size_t found = (index << 6) + highest_bit(summary);
+            return (found << 6) + highest_bit(occupied_[found]);
+        }
+        if (index == 0) {
+            return capacity_;
+        }
+        summary = summary_[--index];
+    }
+}
+
+size_t PriceLadder::find_at_or_above(size_t slot) const {
+    if (slot >= capacity_) {
+        return capacity_;
+    }
+    size_t word = slot >> 6;
+    uint64_t bits = occupied_[word] & (~uint64_t(0) << (slot & 63));
+    if (bits) {
+        return (word << 6) + lowest_bit(bits);
+    }
+
+    size_t next = word + 1;
+    if (next >= occupied_.size()) {
+        return capacity_;
+    }
+    size_t index = next >> 6;
+    uint64_t summary = summary_[index] & (~uint64_t(0) << (next & 63));
+    while (true) {
+        if (summary) {
+            size_t found = (index << 6) + lowest_bit(summary);
+            return (found << 6) + lowest_bit(occupied_[found]);
+        }
+        if (++index >= summary_.size()) {
+            return capacity_;
+        }
+        summary = summary_[index];
+    }
+}
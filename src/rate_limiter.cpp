@@ -0,0 +1,185 @@
+#include "rate_limiter.h"
+#include <algorithm>
+
+RateLimiter::RateLimiter(const RateLimitConfig& config) {
+    configure(config);
+}
+
+void RateLimiter::configure(const RateLimitConfig& config) {
+    config_ = config;
+    buckets_[static_cast<size_t>(RateClass::MatchingEngine)].config = config.matching_engine;
+    buckets_[static_cast<size_t>(RateClass::NonMatching)].config = config.non_matching;
+    for (auto& bucket : buckets_) {
+        bucket.credits = bucket.config.burst_credits;
+        bucket.refilled_ns = 0;
+    }
+    for (auto& backlog : backlogs_) {
+        backlog.frames.clear();
+        backlog.frames.resize(std::max<size_t>(config.max_backlog, 1));
+        backlog.head = 0;
+        backlog.count = 0;
+    }
+    backlog_size_.store(0, std::memory_order_relaxed);
+}
+
+RateClass RateLimiter::class_of(SendPriority priority) {
+    return priority == SendPriority::Other ? RateClass::NonMatching : RateClass::MatchingEngine;
+}
+
+bool RateLimiter::next(OutboundQueue& queue, int64_t now_ns, OutboundFrame& frame) {
+    for (size_t lane = 0; lane < OutboundQueue::kLanes; ++lane) {
+        SendPriority priority = static_cast<SendPriority>(lane);
+        if (!config_.enabled) {
+            if (queue.pop(priority, frame)) {
+                admitted_.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            continue;
+        }
+
+        Bucket& bucket = bucket_for(lane);
+        Backlog& backlog = backlogs_[lane];
+        bucket.refill(now_ns);
+
+        if (backlog.count > 0) {
+            if (!bucket.try_take()) {
+                // Still pull new frames in so they are merged or shed
+                // according to policy instead of waiting unseen
+                while (queue.pop(priority, frame)) {
+                    hold(lane, std::move(frame), bucket.config.policy);
+                }
+                continue;
+            }
+            frame = std::move(backlog.at(0));
+            backlog.head = (backlog.head + 1) % backlog.frames.size();
+            --backlog.count;
+            backlog_size_.fetch_sub(1, std::memory_order_relaxed);
+            admit(priority, frame);
+            return true;
+        }
+
+        if (queue.pop(priority, frame)) {
+            if (bucket.try_take()) {
+                admit(priority, frame);
+                return true;
+            }
+            hold(lane, std::move(frame), bucket.config.policy);
+            while (queue.pop(priority, frame)) {
+                hold(lane, std::move(frame), bucket.config.policy);
+            }
+        }
+    }
+    return false;
+}
+
+int64_t RateLimiter::next_release_ns(int64_t now_ns) const {
+    int64_t release_ns = 0;
+    for (size_t lane = 0; lane < OutboundQueue::kLanes; ++lane) {
+        if (backlogs_[lane].count == 0) {
+            continue;
+        }
+        const Bucket& bucket = buckets_[static_cast<size_t>(class_of(static_cast<SendPriority>(lane)))];
+        double missing = std::max(0.0, bucket.config.cost - bucket.credits);
+        double rate = std::max(bucket.config.credits_per_second, 1e-9);
+        int64_t at = now_ns + static_cast<int64_t>(missing / rate * 1e9);
+        if (release_ns == 0 || at < release_ns) {
+            release_ns = at;
+        }
+    }
+    return release_ns;
+}
+
+RateLimitStats RateLimiter::stats() const {
+    RateLimitStats result;
+    result.admitted = admitted_.load(std::memory_order_relaxed);
+    result.held = held_.load(std::memory_order_relaxed);
+    result.merged = merged_.load(std::memory_order_relaxed);
+    result.shed = shed_.load(std::memory_order_relaxed);
+    result.backlog = backlog_size_.load(std::memory_order_relaxed);
+    return result;
+}
+
+void RateLimiter::Bucket::refill(int64_t now_ns) {
+    if (refilled_ns != 0 && now_ns > refilled_ns) {
+        credits = std::min(config.burst_credits,
+            credits + static_cast<double>(now_ns - refilled_ns) * config.credits_per_second / 1e9);
+    }
+    refilled_ns = now_ns;
+}
+
+bool RateLimiter::Bucket::try_take() {
+    if (credits < config.cost) {
+        return false;
+    }
+    credits -= config.cost;
+    return true;
+}
+
+void RateLimiter::hold(size_t lane, OutboundFrame&& frame, OverLimitPolicy policy) {
+    if (policy == OverLimitPolicy::Shed) {
+        shed_.fetch_add(1, std::memory_order_relaxed);
+        drop(frame.request_id, "shed by local rate limiter");
+        return;
+    }
+
+    Backlog& backlog = backlogs_[lane];
+    if (policy == OverLimitPolicy::Merge && frame.merge_key_size > 0) {
+        // The newer request keeps the older one's place in line
+        for (size_t i = 0; i < backlog.count; ++i) {
+            OutboundFrame& held = backlog.at(i);
+            if (held.merge_key_view() == frame.merge_key_view()) {
+                int64_t superseded = held.request_id;
+                held = std::move(frame);
+                merged_.fetch_add(1, std::memory_order_relaxed);
+                drop(superseded, "superseded by a newer request for the same order");
+                return;
+            }
+        }
+    }
+
+    if (backlog.count == backlog.frames.size()) {
+        shed_.fetch_add(1, std::memory_order_relaxed);
+        drop(frame.request_id, "local rate limit backlog full");
+        return;
+    }
+    backlog.at(backlog.count) = std::move(frame);
+    ++backlog.count;
+    backlog_size_.fetch_add(1, std::memory_order_relaxed);
+    held_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RateLimiter::admit(SendPriority priority, const OutboundFrame& frame) {
+    admitted_.fetch_add(1, std::memory_order_relaxed);
+    if (priority != SendPriority::Cancel || frame.merge_key_size == 0) {
+        return;
+    }
+    // An edit held back behind the cancel of its order would only be
+    // rejected by Deribit, or worse, land first if the cancel fails
+    for (size_t lane = 0; lane < OutboundQueue::kLanes; ++lane) {
+        if (static_cast<SendPriority>(lane) == SendPriority::Cancel) {
+            continue;
+        }
+        Backlog& backlog = backlogs_[lane];
+        size_t kept = 0;
+        for (size_t i = 0; i < backlog.count; ++i) {
+            OutboundFrame& held = backlog.at(i);
+            if (held.merge_key_view() == frame.merge_key_view()) {
+                shed_.fetch_add(1, std::memory_order_relaxed);
+                drop(held.request_id, "order cancelled before the request was sent");
+                continue;
+            }
+            if (kept != i) {
+                backlog.at(kept) = std::move(held);
+            }
+            ++kept;
+        }
+        backlog_size_.fetch_sub(backlog.count - kept, std::memory_order_relaxed);
+        backlog.count = kept;
+    }
+}
+
+void RateLimiter::drop(int64_t request_id, const char* reason) {
+    if (drop_handler_) {
+        drop_handler_(request_id, reason);
+    }
+}
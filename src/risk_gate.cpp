@@ -0,0 +1,137 @@
+#include "risk_gate.h"
+#include <cmath>
+#include "utils.h"
+
+const char* to_string(RiskReject reason) {
+    switch (reason) {
+    case RiskReject::None: return "none";
+    case RiskReject::InvalidOrder: return "invalid_order";
+    case RiskReject::UnknownOrder: return "unknown_order";
+    case RiskReject::NoReferencePrice: return "no_reference_price";
+    case RiskReject::PriceBand: return "price_band";
+    case RiskReject::OrderSize: return "order_size";
+    case RiskReject::Position: return "position";
+    case RiskReject::OpenOrders: return "open_orders";
+    default: return "unknown";
+    }
+}
+
+RiskGate::RiskGate(const MarketData& market_data, const PositionEngine& positions, const OrderManager& orders)
+    : market_data_(market_data), positions_(positions), orders_(orders),
+    instrument_limits_(new std::atomic<SeqLock<RiskLimits>*>[InstrumentRegistry::kMaxInstruments]) {
+    default_limits_.store(RiskLimits());
+    for (size_t i = 0; i < InstrumentRegistry::kMaxInstruments; ++i) {
+        instrument_limits_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+RiskGate::~RiskGate() {
+    for (size_t i = 0; i < InstrumentRegistry::kMaxInstruments; ++i) {
+        delete instrument_limits_[i].load(std::memory_order_relaxed);
+    }
+}
+
+void RiskGate::set_default_limits(const RiskLimits& limits) {
+    default_limits_.store(limits);
+}
+
+void RiskGate::set_limits(InstrumentId instrument, const RiskLimits& limits) {
+    if (instrument >= InstrumentRegistry::kMaxInstruments) {
+        return;
+    }
+    SeqLock<RiskLimits>* slot = instrument_limits_[instrument].load(std::memory_order_relaxed);
+    if (!slot) {
+        slot = new SeqLock<RiskLimits>();
+        slot->store(limits);
+        instrument_limits_[instrument].store(slot, std::memory_order_release);
+        return;
+    }
+    slot->store(limits);
+}
+
+RiskLimits RiskGate::limits(InstrumentId instrument) const {
+    if (instrument < InstrumentRegistry::kMaxInstruments) {
+        if (const SeqLock<RiskLimits>* slot = instrument_limits_[instrument].load(std::memory_order_acquire)) {
+            return slot->load();
+        }
+    }
+    return default_limits_.load();
+}
+
+RiskReject RiskGate::check_order(InstrumentId instrument, OrderSide side, double amount, double price) {
+    int64_t start_ns = monotonic_time_ns();
+    return record(evaluate(instrument, side, amount, price, true), start_ns);
+}
+
+RiskReject RiskGate::check_edit(std::string_view order_id, double amount, double price) {
+    int64_t start_ns = monotonic_time_ns();
+    Order order;
+    if (!orders_.get_order(order_id, order) || is_terminal(order.status)) {
+        return record(RiskReject::UnknownOrder, start_ns);
+    }
+    return record(evaluate(order.instrument_id, order.side, amount - order.filled, price, false), start_ns);
+}
+
+RiskStats RiskGate::stats() const {
+    RiskStats stats;
+    stats.checked = checked_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < kRiskRejectReasons; ++i) {
+        stats.by_reason[i] = rejected_[i].load(std::memory_order_relaxed);
+        if (i != static_cast<size_t>(RiskReject::None)) {
+            stats.rejected += stats.by_reason[i];
+        }
+    }
+    stats.latency = latency_.summary();
+    return stats;
+}
+
+RiskReject RiskGate::evaluate(InstrumentId instrument, OrderSide side, double amount, double price,
+    bool counts_as_new) const {
+    if (instrument >= InstrumentRegistry::kMaxInstruments || side == OrderSide::Unknown ||
+        !std::isfinite(amount) || amount <= 0 || !std::isfinite(price) || price < 0) {
+        return RiskReject::InvalidOrder;
+    }
+    RiskLimits limits = this->limits(instrument);
+
+    if (limits.max_order_amount > 0 && amount > limits.max_order_amount) {
+        return RiskReject::OrderSize;
+    }
+
+    if (limits.max_position > 0) {
+        double projected = positions_.size(instrument) + (side == OrderSide::Buy ? amount : -amount);
+        if (std::fabs(projected) > limits.max_position) {
+            return RiskReject::Position;
+        }
+    }
+
+    // Market orders carry no price to check
+    if (price > 0 && (limits.price_band > 0 || limits.require_quote)) {
+        TopOfBook top;
+        bool quoted = market_data_.get_top_of_book(instrument, top) && top.bid_price > 0 && top.ask_price > 0;
+        if (!quoted) {
+            if (limits.require_quote) {
+                return RiskReject::NoReferencePrice;
+            }
+        }
+        else if (limits.price_band > 0) {
+            double mid = 0.5 * (top.bid_price + top.ask_price);
+            // Only prices through the mid are fat-finger risks; passive ones just rest
+            if ((side == OrderSide::Buy && price > mid * (1.0 + limits.price_band)) ||
+                (side == OrderSide::Sell && price < mid * (1.0 - limits.price_band))) {
+                return RiskReject::PriceBand;
+            }
+        }
+    }
+
+    if (counts_as_new && limits.max_open_orders > 0 && orders_.open_orders(instrument) >= limits.max_open_orders) {
+        return RiskReject::OpenOrders;
+    }
+    return RiskReject::None;
+}
+
+RiskReject RiskGate::record(RiskReject result, int64_t start_ns) {
+    latency_.record(monotonic_time_ns() - start_ns);
+    checked_.fetch_add(1, std::memory_order_relaxed);
+    rejected_[static_cast<size_t>(result)].fetch_add(1, std::memory_order_relaxed);
+    return result;
+}
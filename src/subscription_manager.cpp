@@ -0,0 +1,374 @@
+#include "subscription_manager.h"
+#include <limits>
+#include "binary_encoder.h"
+#include "utils.h"
+
+namespace {
+
+json error_response(const json& id, int code, const char* message) {
+    return {
+        {"jsonrpc", "2.0"},
+        {"id", id},
+        {"error", {{"code", code}, {"message", message}}}
+    };
+}
+
+// The same notification Deribit sends first on a raw book channel
+std::string book_notification(const std::string& channel, const std::string& instrument_name,
+    const BookUpdate& snapshot) {
+    auto levels = [](const std::vector<BookLevelUpdate>& side) {
+        json out = json::array();
+        for (const auto& level : side) {
+            out.push_back({ "new", level.price, level.amount });
+        }
+        return out;
+        };
+    json message = {
+        {"jsonrpc", "2.0"},
+        {"method", "subscription"},
+        {"params", {
+            {"channel", channel},
+            {"data", {
+                {"type", "snapshot"},
+                {"timestamp", snapshot.timestamp},
+                {"instrument_name", instrument_name},
+                {"change_id", snapshot.change_id},
+                {"bids", levels(snapshot.bids)},
+                {"asks", levels(snapshot.asks)}
+            }}
+        }}
+    };
+    return message.dump();
+}
+
+std::string analytics_notification(const std::string& instrument_name, int64_t timestamp,
+    const BookAnalytics& analytics) {
+    json message = {
+        {"jsonrpc", "2.0"},
+        {"method", "subscription"},
+        {"params", {
+            {"channel", "book." + instrument_name + ".analytics"},
+            {"data", {
+                {"timestamp", timestamp},
+                {"instrument_name", instrument_name},
+                {"mid", analytics.mid},
+                {"spread", analytics.spread},
+                {"microprice", analytics.microprice},
+                {"imbalance", analytics.imbalance},
+                {"imbalance_levels", analytics.imbalance_levels},
+                {"bid_vwap", analytics.bid_vwap},
+                {"ask_vwap", analytics.ask_vwap},
+                {"vwap_size", analytics.vwap_size}
+            }}
+        }}
+    };
+    return message.dump();
+}
+
+}
+
+SubscriptionManager::SubscriptionManager(DeribitClient& deribit_client, WebSocketServer& websocket_server,
+    MarketData& market_data, InstrumentRegistry& instruments)
+    : deribit_client_(deribit_client), websocket_server_(websocket_server), market_data_(market_data),
+    instruments_(instruments) {}
+
+uint32_t SubscriptionManager::stream_bit(const ChannelRoute& route) {
+    uint32_t interval = route.interval == "raw" ? 0 : route.interval == "100ms" ? 1 : route.interval == "agg2" ? 2 : 3;
+    switch (route.family) {
+    case ChannelFamily::Book: return route.interval == "analytics" ? kAnalyticsStream : 1u << interval;
+    case ChannelFamily::Ticker: return 1u << (4 + interval);
+    case ChannelFamily::Trades: return 1u << (8 + interval);
+    default: return 0;
+    }
+}
+
+uint64_t SubscriptionManager::conflation_key(const ChannelRoute& route) {
+    return static_cast<uint64_t>(stream_bit(route)) << 32 | route.instrument_id;
+}
+
+std::vector<std::string> SubscriptionManager::acquire(const std::vector<std::string>& channels) {
+    std::vector<std::string> accepted;
+    std::vector<std::string> subscribe;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Local holds live under the empty handle, which no connection has
+        std::set<std::string>& local = clients_[websocketpp::connection_hdl()];
+        for (const std::string& channel : channels) {
+            if (local.count(channel) > 0 || (hold(channel, subscribe) && local.insert(channel).second)) {
+                accepted.push_back(channel);
+            }
+        }
+        send_upstream(subscribe, {});
+    }
+    return accepted;
+}
+
+void SubscriptionManager::release(const std::vector<std::string>& channels) {
+    std::vector<std::string> unsubscribe;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto local = clients_.find(websocketpp::connection_hdl());
+        if (local == clients_.end()) {
+            return;
+        }
+        for (const std::string& channel : channels) {
+            if (local->second.erase(channel) > 0) {
+                drop(channel, unsubscribe);
+            }
+        }
+        send_upstream({}, unsubscribe);
+    }
+}
+
+void SubscriptionManager::on_client_message(const std::string& payload, websocketpp::connection_hdl hdl) {
+    int64_t request_ns = monotonic_time_ns();
+    json request = json::parse(payload, nullptr, false);
+    if (request.is_discarded() || !request.is_object()) {
+        websocket_server_.send(hdl, error_response(nullptr, -32700, "Parse error").dump());
+        return;
+    }
+    json id = request.contains("id") ? request["id"] : json();
+    std::string method = request.value("method", "");
+    bool subscribing = method == "public/subscribe" || method == "subscribe";
+    if (!subscribing && method != "public/unsubscribe" && method != "unsubscribe") {
+        websocket_server_.send(hdl, error_response(id, -32601, "Method not found").dump());
+        return;
+    }
+    if (!request.contains("params") || !request["params"].contains("channels") ||
+        !request["params"]["channels"].is_array()) {
+        websocket_server_.send(hdl, error_response(id, -32602, "Invalid params").dump());
+        return;
+    }
+    // Book snapshots are full depth unless the request asks for fewer levels
+    size_t depth = std::numeric_limits<size_t>::max();
+    const json& depth_param = request["params"].contains("depth") ? request["params"]["depth"] : json();
+    if (depth_param.is_number_unsigned() && depth_param.get<size_t>() > 0) {
+        depth = depth_param.get<size_t>();
+    }
+
+    json result = json::array();
+    std::vector<std::string> subscribe;
+    std::vector<std::string> unsubscribe;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool binary = websocket_server_.is_binary(hdl);
+        std::set<std::string>& channels = clients_[hdl];
+        for (const auto& entry : request["params"]["channels"]) {
+            Held held;
+            if (!entry.is_string() || !resolve(entry.get<std::string>(), held)) {
+                continue;
+            }
+            const std::string& channel = entry.get_ref<const std::string&>();
+            if (subscribing) {
+                bool added = channels.insert(channel).second;
+                if (added) {
+                    if (binary) {
+                        // Queued ahead of the first update, so the ID is known before it is used
+                        std::string definition;
+                        encode_binary_instrument(definition, held.instrument, instruments_.info(held.instrument));
+                        websocket_server_.send(hdl,
+                            WebSocketServer::make_frame(definition, websocketpp::frame::opcode::binary));
+                    }
+                    hold(channel, subscribe);
+                }
+                if (held.book && !held.analytics) {
+                    // Snapshot and subscription happen between two book updates
+                    deribit_client_.post([this, hdl, channel, held, depth, added, request_ns] {
+                        if (send_book_snapshot(hdl, channel, held.instrument, depth)) {
+                            snapshot_latency_.record(monotonic_time_ns() - request_ns);
+                        }
+                        if (added) {
+                            websocket_server_.add_subscription(hdl, held.instrument, held.stream);
+                        }
+                        });
+                }
+                else if (added) {
+                    websocket_server_.add_subscription(hdl, held.instrument, held.stream);
+                }
+            }
+            else if (channels.erase(channel) > 0) {
+                drop(channel, unsubscribe);
+                if (held.book && !held.analytics) {
+                    // Posted as well, so it cannot overtake a pending subscription
+                    deribit_client_.post([this, hdl, held] {
+                        websocket_server_.remove_subscription(hdl, held.instrument, held.stream);
+                        });
+                }
+                else {
+                    websocket_server_.remove_subscription(hdl, held.instrument, held.stream);
+                }
+            }
+            result.push_back(channel);
+        }
+        if (channels.empty()) {
+            clients_.erase(hdl);
+        }
+        send_upstream(subscribe, unsubscribe);
+    }
+
+    json response = {
+        {"jsonrpc", "2.0"},
+        {"id", id},
+        {"result", result}
+    };
+    websocket_server_.send(hdl, response.dump());
+}
+
+void SubscriptionManager::on_client_close(websocketpp::connection_hdl hdl) {
+    // The server has already dropped the connection from its subscriber index
+    std::vector<std::string> unsubscribe;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto client = clients_.find(hdl);
+        if (client == clients_.end()) {
+            return;
+        }
+        for (const std::string& channel : client->second) {
+            drop(channel, unsubscribe);
+        }
+        clients_.erase(client);
+        send_upstream({}, unsubscribe);
+    }
+}
+
+void SubscriptionManager::on_client_gap(websocketpp::connection_hdl hdl, InstrumentId instrument) {
+    // Taken on the feed thread between two updates, like a late-join snapshot;
+    // if the book is resyncing, the resync snapshot restarts the client instead
+    deribit_client_.post([this, hdl, instrument] {
+        std::string channel = "book." + instruments_.info(instrument).name + ".raw";
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto client = clients_.find(hdl);
+            if (client == clients_.end() || client->second.count(channel) == 0) {
+                return;
+            }
+        }
+        send_book_snapshot(hdl, channel, instrument, std::numeric_limits<size_t>::max());
+        });
+}
+
+void SubscriptionManager::publish_book_snapshot(const ChannelRoute& route) {
+    BookUpdate snapshot;
+    if (websocket_server_.client_count() == 0 ||
+        !market_data_.snapshot_book(route.instrument_id, std::numeric_limits<size_t>::max(), snapshot)) {
+        return;
+    }
+    InstrumentId instrument = route.instrument_id;
+    websocket_server_.publish(instrument, stream_bit(route), book_notification(route.channel, route.instrument, snapshot),
+        [instrument, &snapshot](std::string& out) { encode_binary_book(out, instrument, snapshot); },
+        WebSocketServer::kSnapshot);
+}
+
+void SubscriptionManager::publish_analytics(InstrumentId instrument, int64_t timestamp) {
+    BookAnalytics analytics;
+    if (!websocket_server_.has_subscribers(instrument, kAnalyticsStream) ||
+        !market_data_.get_analytics(instrument, analytics)) {
+        return;
+    }
+    // Each message is the whole state, so a slow client only needs the newest
+    websocket_server_.publish(instrument, kAnalyticsStream,
+        analytics_notification(instruments_.info(instrument).name, timestamp, analytics),
+        [instrument, timestamp, &analytics](std::string& out) {
+            encode_binary_analytics(out, instrument, timestamp, analytics);
+        },
+        static_cast<uint64_t>(kAnalyticsStream) << 32 | instrument);
+}
+
+std::vector<std::pair<std::string, size_t>> SubscriptionManager::upstream_channels() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::pair<std::string, size_t>> channels;
+    channels.reserve(held_.size());
+    for (const auto& [channel, held] : held_) {
+        channels.emplace_back(channel, held.holders);
+    }
+    return channels;
+}
+
+bool SubscriptionManager::resolve(const std::string& channel, Held& held) const {
+    ChannelRoute route;
+    if (!parse_channel(channel, route) || route.instrument.empty() || stream_bit(route) == 0 ||
+        (route.family != ChannelFamily::Book && route.family != ChannelFamily::Ticker &&
+            route.family != ChannelFamily::Trades)) {
+        return false;
+    }
+    held.analytics = route.family == ChannelFamily::Book && route.interval == "analytics";
+    // Raw and aggregated book updates would interleave in the one local book
+    if (route.family == ChannelFamily::Book && route.interval != "raw" && !held.analytics) {
+        return false;
+    }
+    if (!held.analytics && route.interval != "raw" && route.interval != "100ms" && route.interval != "agg2") {
+        return false;
+    }
+    held.instrument = instruments_.find(route.instrument);
+    held.stream = stream_bit(route);
+    held.book = route.family == ChannelFamily::Book;
+    held.upstream = held.analytics ? "book." + route.instrument + ".raw" : channel;
+    return held.instrument != kInvalidInstrument;
+}
+
+bool SubscriptionManager::hold(const std::string& channel, std::vector<std::string>& subscribe) {
+    Held held;
+    if (!resolve(channel, held)) {
+        return false;
+    }
+    auto existing = held_.find(held.upstream);
+    if (existing != held_.end()) {
+        ++existing->second.holders;
+        return true;
+    }
+    held.holders = 1;
+    held_.emplace(held.upstream, held);
+    if (held.book) {
+        market_data_.subscribe_instrument(held.instrument);
+    }
+    subscribe.push_back(held.upstream);
+    return true;
+}
+
+void SubscriptionManager::drop(const std::string& channel, std::vector<std::string>& unsubscribe) {
+    Held held;
+    if (!resolve(channel, held)) {
+        return;
+    }
+    auto existing = held_.find(held.upstream);
+    if (existing == held_.end() || --existing->second.holders > 0) {
+        return;
+    }
+    if (existing->second.book) {
+        InstrumentId instrument = existing->second.instrument;
+        market_data_.unsubscribe_instrument(instrument);
+        // The book stops updating; forget it rather than serve it stale
+        deribit_client_.post([this, instrument] { market_data_.reset_book(instrument); });
+    }
+    unsubscribe.push_back(existing->first);
+    held_.erase(existing);
+}
+
+void SubscriptionManager::send_upstream(const std::vector<std::string>& subscribe,
+    const std::vector<std::string>& unsubscribe) {
+    if (!subscribe.empty()) {
+        deribit_client_.subscribe(subscribe);
+    }
+    for (const std::string& channel : unsubscribe) {
+        deribit_client_.unsubscribe(channel);
+    }
+}
+
+bool SubscriptionManager::send_book_snapshot(websocketpp::connection_hdl hdl, const std::string& channel,
+    InstrumentId instrument, size_t depth) {
+    BookUpdate snapshot;
+    if (!market_data_.snapshot_book(instrument, depth, snapshot)) {
+        return false;
+    }
+    if (websocket_server_.is_binary(hdl)) {
+        std::string message;
+        encode_binary_book(message, instrument, snapshot);
+        websocket_server_.send_snapshot(hdl, instrument,
+            WebSocketServer::make_frame(message, websocketpp::frame::opcode::binary));
+    }
+    else {
+        websocket_server_.send_snapshot(hdl, instrument,
+            WebSocketServer::make_frame(book_notification(channel, instruments_.info(instrument).name, snapshot)));
+    }
+    return true;
+}
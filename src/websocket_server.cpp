@@ -1,14 +1,29 @@
 #define _WEBSOCKETPP_CPP11_TYPE_TRAITS_ 1
 #include "websocket_server.h"
+#include <algorithm>
 #include <iostream>
+#include "utils.h"
 
-WebSocketServer::WebSocketServer(int port, const std::string& cert_file, const std::string& key_file)
-    : port_(port), cert_file_(cert_file), key_file_(key_file) {
+const char* to_string(SlowClientPolicy policy) {
+    switch (policy) {
+    case SlowClientPolicy::Conflate: return "conflate";
+    case SlowClientPolicy::DropOldest: return "drop_oldest";
+    case SlowClientPolicy::Disconnect: return "disconnect";
+    default: return "unknown";
+    }
+}
+
+WebSocketServer::WebSocketServer(int port, const std::string& cert_file, const std::string& key_file,
+    const ClientQueueConfig& queue_config)
+    : port_(port), queue_config_(queue_config), clients_(std::make_shared<const ClientList>()),
+    subscribers_(new std::shared_ptr<const SubscriberList>[InstrumentRegistry::kMaxInstruments]),
+    cert_file_(cert_file), key_file_(key_file) {
 
     server_.init_asio();
 
     server_.set_open_handler(std::bind(&WebSocketServer::on_open, this, std::placeholders::_1));
     server_.set_close_handler(std::bind(&WebSocketServer::on_close, this, std::placeholders::_1));
+    server_.set_validate_handler(std::bind(&WebSocketServer::on_validate, this, std::placeholders::_1));
     server_.set_message_handler(std::bind(&WebSocketServer::on_message, this,
         std::placeholders::_1, std::placeholders::_2));
 
@@ -61,6 +76,7 @@ void WebSocketServer::start() {
     try {
         server_.listen(port_);
         server_.start_accept();
+        schedule_pump();
 
         std::thread([this]() {
             try {
@@ -82,40 +98,372 @@ void WebSocketServer::stop() {
     server_.stop();
 }
 
+WebSocketServer::Frame WebSocketServer::make_frame(std::string_view payload, websocketpp::frame::opcode::value opcode) {
+    // Server frames are never masked, so the same bytes are valid on every connection
+    Frame frame = std::make_shared<WebsocketServer::message_type>(nullptr, opcode, 0);
+    frame->set_header(websocketpp::frame::prepare_header(
+        websocketpp::frame::basic_header(opcode, payload.size(), true, false),
+        websocketpp::frame::extended_header(payload.size())));
+    frame->set_payload(payload.data(), payload.size());
+    frame->set_prepared(true);
+    return frame;
+}
+
 void WebSocketServer::broadcast(const std::string& message) {
-    std::lock_guard<std::mutex> lock(connections_mutex_);
-    for (auto hdl : connections_) {
-        try {
-            server_.send(hdl, message, websocketpp::frame::opcode::text);
+    if (client_count() == 0) {
+        return;
+    }
+    broadcast(make_frame(message));
+}
+
+void WebSocketServer::broadcast(const Frame& frame, uint64_t conflation_key) {
+    std::shared_ptr<const ClientList> clients = std::atomic_load(&clients_);
+    for (const std::shared_ptr<Client>& client : *clients) {
+        deliver(*client, frame, conflation_key);
+    }
+}
+
+size_t WebSocketServer::client_count() const {
+    return std::atomic_load(&clients_)->size();
+}
+
+std::vector<ClientStats> WebSocketServer::client_stats() const {
+    std::shared_ptr<const ClientList> clients = std::atomic_load(&clients_);
+    int64_t now_ns = monotonic_time_ns();
+    std::vector<ClientStats> stats;
+    stats.reserve(clients->size());
+    for (const std::shared_ptr<Client>& client : *clients) {
+        ClientStats entry;
+        entry.remote = client->remote;
+        entry.buffered_bytes = client->connection->get_buffered_amount();
+        std::lock_guard<std::mutex> lock(client->mutex);
+        entry.queued = client->queue.size();
+        entry.max_queued = client->max_queued;
+        entry.lag_ms = client->queue.empty() ? 0 : (now_ns - client->queue.front().queued_ns) / 1000000;
+        entry.sent = client->sent;
+        entry.dropped = client->dropped;
+        entry.conflated = client->conflated;
+        entry.gaps = client->gaps;
+        entry.disconnecting = client->disconnecting;
+        entry.binary = client->binary;
+        stats.push_back(std::move(entry));
+    }
+    return stats;
+}
+
+void WebSocketServer::deliver(Client& client, const Frame& frame, uint64_t key, InstrumentId instrument) {
+    InstrumentId gap = kInvalidInstrument;
+    {
+        std::lock_guard<std::mutex> lock(client.mutex);
+        if (client.disconnecting) {
+            return;
         }
-        catch (const std::exception& e) {
-            std::cerr << "Error broadcasting message: " << e.what() << std::endl;
+        if (key == kSequenced || key == kSnapshot) {
+            auto gapped = std::find(client.gapped.begin(), client.gapped.end(), instrument);
+            if (gapped != client.gapped.end()) {
+                if (key == kSequenced) {
+                    // Useless past the gap; the snapshot restarts the stream
+                    ++client.dropped;
+                    return;
+                }
+                client.gapped.erase(gapped);
+            }
+            key = kNoConflation;
+        }
+        else {
+            instrument = kInvalidInstrument;
+        }
+        int64_t now_ns = monotonic_time_ns();
+        // Keeping up: straight to the socket, nothing queued
+        if (client.queue.empty() && client.connection->get_buffered_amount() < queue_config_.max_buffered_bytes) {
+            // Keyed even here: if the socket backs up, the frame stays queued
+            // and a newer one for the same key must still replace it
+            if (key != kNoConflation) {
+                client.latest[key] = client.popped;
+            }
+            client.queue.push_back({ frame, key, now_ns, instrument });
+            pump(client, now_ns);
+            return;
+        }
+
+        if (key != kNoConflation && queue_config_.policy == SlowClientPolicy::Conflate) {
+            auto latest = client.latest.find(key);
+            if (latest != client.latest.end()) {
+                // Replaced in place: the message keeps its slot and its age
+                client.queue[latest->second - client.popped].frame = frame;
+                ++client.conflated;
+                return;
+            }
+        }
+
+        if (client.queue.size() >= queue_config_.max_queued) {
+            if (queue_config_.policy == SlowClientPolicy::Disconnect) {
+                disconnect_slow(client, "queue full");
+                return;
+            }
+            gap = drop_oldest(client);
+        }
+        if (key != kNoConflation) {
+            client.latest[key] = client.popped + client.queue.size();
+        }
+        client.queue.push_back({ frame, key, now_ns, instrument });
+        client.queued.store(client.queue.size(), std::memory_order_relaxed);
+        client.max_queued = std::max(client.max_queued, client.queue.size());
+    }
+    if (gap != kInvalidInstrument && gap_handler_) {
+        gap_handler_(client.hdl, gap);
+    }
+}
+
+void WebSocketServer::pump(Client& client, int64_t now_ns) {
+    while (!client.queue.empty() && client.connection->get_buffered_amount() < queue_config_.max_buffered_bytes) {
+        const Frame& frame = client.queue.front().frame;
+        // Prepared frames are queued by reference, without re-framing or copying
+        websocketpp::lib::error_code ec = client.rfc6455 ? client.connection->send(frame) :
+            client.connection->send(frame->get_payload(), frame->get_opcode());
+        if (ec) {
+            std::cerr << "Error sending to " << client.remote << ": " << ec.message() << std::endl;
+        }
+        else {
+            ++client.sent;
+        }
+        pop_front(client);
+    }
+    client.queued.store(client.queue.size(), std::memory_order_relaxed);
+
+    if (queue_config_.policy == SlowClientPolicy::Disconnect && !client.queue.empty() &&
+        now_ns - client.queue.front().queued_ns > static_cast<int64_t>(queue_config_.max_lag_ms) * 1000000) {
+        disconnect_slow(client, "lagging");
+    }
+}
+
+void WebSocketServer::pop_front(Client& client) {
+    const Pending& front = client.queue.front();
+    if (front.key != kNoConflation) {
+        auto latest = client.latest.find(front.key);
+        if (latest != client.latest.end() && latest->second == client.popped) {
+            client.latest.erase(latest);
         }
     }
+    client.queue.pop_front();
+    ++client.popped;
+}
+
+InstrumentId WebSocketServer::drop_oldest(Client& client) {
+    InstrumentId instrument = client.queue.front().sequenced;
+    pop_front(client);
+    ++client.dropped;
+    if (instrument == kInvalidInstrument ||
+        std::find(client.gapped.begin(), client.gapped.end(), instrument) != client.gapped.end()) {
+        return kInvalidInstrument;
+    }
+    client.gapped.push_back(instrument);
+    ++client.gaps;
+    return instrument;
+}
+
+void WebSocketServer::disconnect_slow(Client& client, const char* reason) {
+    client.disconnecting = true;
+    client.queue.clear();
+    client.latest.clear();
+    client.gapped.clear();
+    client.queued.store(0, std::memory_order_relaxed);
+    std::cerr << "Disconnecting slow client " << client.remote << ": " << reason << std::endl;
+    websocketpp::lib::error_code ec;
+    client.connection->close(websocketpp::close::status::try_again_later, "slow consumer", ec);
+}
+
+void WebSocketServer::schedule_pump() {
+    // Sockets drain on the server thread; retry backed-up queues from there
+    server_.set_timer(queue_config_.pump_interval_ms, [this](const websocketpp::lib::error_code& ec) {
+        if (ec) {
+            return;
+        }
+        std::shared_ptr<const ClientList> clients = std::atomic_load(&clients_);
+        int64_t now_ns = monotonic_time_ns();
+        for (const std::shared_ptr<Client>& client : *clients) {
+            if (client->queued.load(std::memory_order_relaxed) > 0) {
+                std::lock_guard<std::mutex> lock(client->mutex);
+                pump(*client, now_ns);
+            }
+        }
+        schedule_pump();
+        });
 }
 
 void WebSocketServer::send(websocketpp::connection_hdl hdl, const std::string& message) {
-    try {
-        server_.send(hdl, message, websocketpp::frame::opcode::text);
+    // Replies queue behind the client's broadcasts so ordering is kept
+    if (std::shared_ptr<Client> client = find_client(hdl)) {
+        deliver(*client, make_frame(message), kNoConflation);
     }
-    catch (const std::exception& e) {
-        std::cerr << "Error sending message: " << e.what() << std::endl;
+}
+
+void WebSocketServer::send(websocketpp::connection_hdl hdl, const Frame& frame) {
+    if (std::shared_ptr<Client> client = find_client(hdl)) {
+        deliver(*client, frame, kNoConflation);
+    }
+}
+
+void WebSocketServer::send_snapshot(websocketpp::connection_hdl hdl, InstrumentId instrument, const Frame& frame) {
+    if (std::shared_ptr<Client> client = find_client(hdl)) {
+        deliver(*client, frame, kSnapshot, instrument);
+    }
+}
+
+bool WebSocketServer::is_binary(websocketpp::connection_hdl hdl) const {
+    std::shared_ptr<Client> client = find_client(hdl);
+    return client && client->binary;
+}
+
+void WebSocketServer::add_subscription(websocketpp::connection_hdl hdl, InstrumentId instrument, uint32_t streams) {
+    std::shared_ptr<Client> client = find_client(hdl);
+    if (!client || instrument >= InstrumentRegistry::kMaxInstruments) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    update_subscription(client, instrument, streams, 0);
+}
+
+void WebSocketServer::remove_subscription(websocketpp::connection_hdl hdl, InstrumentId instrument, uint32_t streams) {
+    std::shared_ptr<Client> client = find_client(hdl);
+    if (!client || instrument >= InstrumentRegistry::kMaxInstruments) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    update_subscription(client, instrument, 0, streams);
+}
+
+bool WebSocketServer::has_subscribers(InstrumentId instrument, uint32_t stream) const {
+    if (instrument >= InstrumentRegistry::kMaxInstruments) {
+        return false;
+    }
+    std::shared_ptr<const SubscriberList> subscribers = std::atomic_load(&subscribers_[instrument]);
+    if (!subscribers) {
+        return false;
+    }
+    for (const Subscriber& subscriber : *subscribers) {
+        if (subscriber.streams & stream) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::shared_ptr<WebSocketServer::Client> WebSocketServer::find_client(websocketpp::connection_hdl hdl) const {
+    std::shared_ptr<const ClientList> clients = std::atomic_load(&clients_);
+    std::owner_less<websocketpp::connection_hdl> before;
+    for (const std::shared_ptr<Client>& client : *clients) {
+        if (!before(client->hdl, hdl) && !before(hdl, client->hdl)) {
+            return client;
+        }
+    }
+    return nullptr;
+}
+
+void WebSocketServer::update_subscription(const std::shared_ptr<Client>& client, InstrumentId instrument,
+    uint32_t add, uint32_t remove) {
+    const std::shared_ptr<const SubscriberList>& current = subscribers_[instrument];
+    auto subscribers = std::make_shared<SubscriberList>();
+    uint32_t streams = 0;
+    if (current) {
+        subscribers->reserve(current->size() + 1);
+        for (const Subscriber& subscriber : *current) {
+            if (subscriber.client == client) {
+                streams = subscriber.streams;
+            }
+            else {
+                subscribers->push_back(subscriber);
+            }
+        }
+    }
+    uint32_t updated = (streams | add) & ~remove;
+    if (updated != 0) {
+        subscribers->push_back({ client, updated });
+    }
+    if (updated != 0 && streams == 0) {
+        client->subscribed.push_back(instrument);
+    }
+    else if (updated == 0 && streams != 0) {
+        client->subscribed.erase(std::remove(client->subscribed.begin(), client->subscribed.end(), instrument),
+            client->subscribed.end());
     }
+    std::shared_ptr<const SubscriberList> published;
+    if (!subscribers->empty()) {
+        published = std::move(subscribers);
+    }
+    std::atomic_store(&subscribers_[instrument], published);
 }
 
 void WebSocketServer::register_message_handler(MessageHandler handler) {
     message_handler_ = handler;
 }
 
+void WebSocketServer::register_close_handler(CloseHandler handler) {
+    close_handler_ = handler;
+}
+
+void WebSocketServer::register_gap_handler(GapHandler handler) {
+    gap_handler_ = handler;
+}
+
+bool WebSocketServer::on_validate(websocketpp::connection_hdl hdl) {
+    // Binary is opt-in: picked only when the client offers it
+    websocketpp::lib::error_code ec;
+    WebsocketServer::connection_ptr connection = server_.get_con_from_hdl(hdl, ec);
+    if (ec || !connection) {
+        return false;
+    }
+    for (const std::string& protocol : connection->get_requested_subprotocols()) {
+        if (protocol == kBinarySubprotocol) {
+            connection->select_subprotocol(protocol);
+            break;
+        }
+    }
+    return true;
+}
+
 void WebSocketServer::on_open(websocketpp::connection_hdl hdl) {
-    std::lock_guard<std::mutex> lock(connections_mutex_);
-    connections_.insert(hdl);
+    websocketpp::lib::error_code ec;
+    WebsocketServer::connection_ptr connection = server_.get_con_from_hdl(hdl, ec);
+    if (ec || !connection) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        auto client = std::make_shared<Client>();
+        client->hdl = hdl;
+        client->connection = connection;
+        client->rfc6455 = !connection->get_request_header("Sec-WebSocket-Version").empty();
+        client->remote = connection->get_remote_endpoint();
+        client->binary = connection->get_subprotocol() == kBinarySubprotocol;
+        auto clients = std::make_shared<ClientList>(*clients_);
+        clients->push_back(std::move(client));
+        std::atomic_store(&clients_, std::shared_ptr<const ClientList>(std::move(clients)));
+    }
     std::cout << "New secure connection established" << std::endl;
 }
 
 void WebSocketServer::on_close(websocketpp::connection_hdl hdl) {
-    std::lock_guard<std::mutex> lock(connections_mutex_);
-    connections_.erase(hdl);
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        auto clients = std::make_shared<ClientList>();
+        clients->reserve(clients_->size());
+        std::owner_less<websocketpp::connection_hdl> before;
+        for (const std::shared_ptr<Client>& client : *clients_) {
+            if (before(client->hdl, hdl) || before(hdl, client->hdl)) {
+                clients->push_back(client);
+                continue;
+            }
+            std::vector<InstrumentId> subscribed = client->subscribed;
+            for (InstrumentId instrument : subscribed) {
+                update_subscription(client, instrument, 0, UINT32_MAX);
+            }
+        }
+        std::atomic_store(&clients_, std::shared_ptr<const ClientList>(std::move(clients)));
+    }
+    if (close_handler_) {
+        close_handler_(hdl);
+    }
     std::cout << "Connection closed" << std::endl;
 }
 
@@ -0,0 +1,193 @@
+#include <string>
+#include "binary_encoder.h"
+#include "notification_decoder.h"
+#include "test_check.h"
+
+namespace {
+
+constexpr InstrumentId kInstrument = 7;
+
+void test_book_from_a_deribit_frame() {
+    const std::string frame = R"({"jsonrpc":"2.0","method":"subscription","params":{"channel":"book.BTC-PERPETUAL.raw",)"
+        R"("data":{"type":"change","timestamp":1700000000123,"prev_change_id":68492301,)"
+        R"("instrument_name":"BTC-PERPETUAL","change_id":68492302,)"
+        R"("bids":[["change",37012.5,12340.0],["delete",37011.0,0.0]],"asks":[["new",37013.0,5000.0]]}}})";
+    NotificationEnvelope envelope;
+    BookUpdate update;
+    CHECK(decode_envelope(frame, envelope));
+    CHECK(decode_book_data(envelope.data, update));
+
+    std::string out;
+    encode_binary_book(out, kInstrument, update);
+    BinaryReader reader(out.data(), out.size());
+    BinaryHeader header;
+    CHECK(reader.next(header));
+    CHECK(header.type == BinaryMessageType::BookDelta);
+    CHECK(header.version == kBinaryVersion);
+    CHECK(header.instrument_id == kInstrument);
+    CHECK(header.timestamp == 1700000000123);
+    CHECK(header.length == out.size());
+
+    BinaryBook book;
+    CHECK(reader.read(book));
+    CHECK(book.change_id == 68492302);
+    CHECK(book.prev_change_id == 68492301);
+    CHECK(book.bid_count == 2 && book.ask_count == 1);
+    CHECK_NEAR(book.price(0), 37012.5, 1e-8);
+    CHECK_NEAR(book.amount(0), 12340.0, 1e-8);
+    // Deletes go out as a zero amount
+    CHECK_NEAR(book.price(1), 37011.0, 1e-8);
+    CHECK_NEAR(book.amount(1), 0.0, 1e-8);
+    CHECK_NEAR(book.price(2), 37013.0, 1e-8);
+    CHECK(!reader.next(header));
+}
+
+void test_messages_back_to_back() {
+    TickerUpdate ticker;
+    ticker.timestamp = 11;
+    ticker.best_bid_price = 100.25;
+    ticker.best_bid_amount = 3;
+    ticker.best_ask_price = 100.5;
+    ticker.best_ask_amount = 4;
+    ticker.last_price = 100.5;
+    ticker.mark_price = 100.3;
+    ticker.index_price = 100.2;
+
+    TradesUpdate trades;
+    TradeEvent trade;
+    trade.direction = "sell";
+    trade.price = 100.25;
+    trade.amount = 0.001;
+    trade.trade_seq = 42;
+    trade.timestamp = 12;
+    trades.trades.push_back(trade);
+
+    BookAnalytics analytics{};
+    analytics.mid = 100.375;
+    analytics.spread = 0.25;
+    analytics.microprice = 100.39;
+    analytics.imbalance = -0.125;
+    analytics.bid_vwap = 100.1;
+    analytics.ask_vwap = 100.6;
+    analytics.vwap_size = 10;
+    analytics.imbalance_levels = 5;
+
+    std::string out;
+    encode_binary_top_of_book(out, kInstrument, ticker);
+    encode_binary_trades(out, kInstrument, trades);
+    encode_binary_analytics(out, kInstrument, 13, analytics);
+    CHECK(out.size() == kBinaryTopOfBookSize + kBinaryTradeSize + kBinaryAnalyticsSize);
+
+    BinaryReader reader(out.data(), out.size());
+    BinaryHeader header;
+    CHECK(reader.next(header) && header.type == BinaryMessageType::TopOfBook && header.timestamp == 11);
+    BinaryTopOfBook top;
+    CHECK(reader.read(top));
+    CHECK_NEAR(top.bid_price, 100.25, 1e-8);
+    CHECK_NEAR(top.ask_amount, 4, 1e-8);
+    CHECK_NEAR(top.mark_price, 100.3, 1e-8);
+    CHECK_NEAR(top.index_price, 100.2, 1e-8);
+
+    CHECK(reader.next(header) && header.type == BinaryMessageType::Trade && header.timestamp == 12);
+    BinaryTrade decoded_trade;
+    CHECK(reader.read(decoded_trade));
+    CHECK_NEAR(decoded_trade.amount, 0.001, 1e-8);
+    CHECK(decoded_trade.trade_seq == 42);
+    CHECK(decoded_trade.side == BinarySide::Sell);
+    // A message is only read as the type it has room for
+    BinaryAnalytics wrong;
+    CHECK(!reader.read(wrong));
+
+    CHECK(reader.next(header) && header.type == BinaryMessageType::Analytics && header.timestamp == 13);
+    BinaryAnalytics decoded;
+    CHECK(reader.read(decoded));
+    CHECK_NEAR(decoded.mid, 100.375, 1e-8);
+    CHECK_NEAR(decoded.microprice, 100.39, 1e-8);
+    CHECK_NEAR(decoded.imbalance, -0.125, 1e-8);
+    CHECK_NEAR(decoded.ask_vwap, 100.6, 1e-8);
+    CHECK_NEAR(decoded.vwap_size, 10, 1e-8);
+    CHECK(decoded.imbalance_levels == 5);
+    CHECK(!reader.next(header));
+}
+
+void test_orders_carry_their_instrument() {
+    InstrumentRegistry instruments;
+    InstrumentInfo info;
+    info.name = "ETH-27DEC24-4000-C";
+    info.kind = InstrumentKind::Option;
+    info.tick_size = 0.0005;
+    info.contract_size = 1;
+    info.strike = 4000;
+    info.expiration_timestamp = 1735286400000;
+    info.is_call = true;
+    InstrumentId id = instruments.add(info);
+
+    OrdersUpdate update;
+    OrderEvent order;
+    order.order_id = "ETH-1234567";
+    order.instrument_name = info.name;
+    order.order_state = "open";
+    order.direction = "buy";
+    order.order_type = "limit";
+    order.price = 0.0425;
+    order.amount = 2;
+    order.last_update_timestamp = 21;
+    update.orders.push_back(order);
+    // Unknown instruments are skipped
+    order.instrument_name = "NOT-LISTED";
+    update.orders.push_back(order);
+
+    std::string out;
+    encode_binary_orders(out, instruments, update);
+    BinaryReader reader(out.data(), out.size());
+    BinaryHeader header;
+
+    CHECK(reader.next(header) && header.type == BinaryMessageType::Instrument && header.instrument_id == id);
+    BinaryInstrument instrument;
+    CHECK(reader.read(instrument));
+    CHECK(instrument.name == info.name);
+    CHECK(instrument.kind == BinaryInstrumentKind::Option);
+    CHECK(instrument.is_call && !instrument.inverse);
+    CHECK_NEAR(instrument.strike, 4000, 1e-8);
+    CHECK(instrument.expiration_timestamp == 1735286400000);
+
+    CHECK(reader.next(header) && header.type == BinaryMessageType::Order && header.instrument_id == id);
+    BinaryOrder decoded;
+    CHECK(reader.read(decoded));
+    CHECK(decoded.order_id == "ETH-1234567");
+    CHECK(decoded.side == BinarySide::Buy);
+    CHECK(decoded.state == BinaryOrderState::Open);
+    CHECK(decoded.type == BinaryOrderType::Limit);
+    CHECK_NEAR(decoded.price, 0.0425, 1e-8);
+    CHECK(!reader.next(header));
+}
+
+void test_malformed_frames() {
+    TickerUpdate ticker;
+    std::string out;
+    encode_binary_top_of_book(out, kInstrument, ticker);
+
+    // Cut short: the header claims more bytes than the frame has
+    BinaryReader truncated(out.data(), out.size() - 1);
+    BinaryHeader header;
+    CHECK(!truncated.next(header));
+
+    // A length shorter than the header itself
+    std::string corrupt = out;
+    store_le<uint32_t>(reinterpret_cast<uint8_t*>(&corrupt[0]), 8);
+    BinaryReader short_length(corrupt.data(), corrupt.size());
+    CHECK(!short_length.next(header));
+
+    BinaryReader empty(out.data(), 0);
+    CHECK(!empty.next(header));
+}
+
+}
+
+int main() {
+    test_book_from_a_deribit_frame();
+    test_messages_back_to_back();
+    test_orders_carry_their_instrument();
+    test_malformed_frames();
+    return test_result();
+}
@@ -0,0 +1,149 @@
+#include "market_data.h"
+#include "test_check.h"
+
+namespace {
+
+BookUpdate snapshot(int64_t change_id, double bid, double ask) {
+    BookUpdate update;
+    update.is_snapshot = true;
+    update.change_id = change_id;
+    update.timestamp = change_id;
+    update.bids.push_back({ BookAction::New, bid, 10.0 });
+    update.asks.push_back({ BookAction::New, ask, 20.0 });
+    return update;
+}
+
+BookUpdate delta(int64_t prev_change_id, int64_t change_id, double bid, double amount) {
+    BookUpdate update;
+    update.change_id = change_id;
+    update.prev_change_id = prev_change_id;
+    update.timestamp = change_id;
+    update.bids.push_back({ amount > 0 ? BookAction::New : BookAction::Delete, bid, amount });
+    return update;
+}
+
+struct Fixture {
+    InstrumentRegistry instruments;
+    MarketData market_data{ instruments };
+    InstrumentId instrument;
+
+    Fixture() {
+        InstrumentInfo info;
+        info.name = "BTC-PERPETUAL";
+        info.tick_size = 0.5;
+        instrument = instruments.add(info);
+    }
+};
+
+void test_in_sequence_deltas() {
+    Fixture fixture;
+    MarketData& market_data = fixture.market_data;
+    InstrumentId id = fixture.instrument;
+
+    CHECK(!market_data.get_orderbook(id).valid);
+    CHECK(market_data.apply_book_update(id, snapshot(100, 50.0, 51.0)) == BookUpdateResult::Applied);
+    CHECK(market_data.apply_book_update(id, delta(100, 101, 50.5, 3.0)) == BookUpdateResult::Applied);
+
+    OrderBook book = market_data.get_orderbook(id);
+    CHECK(book.valid);
+    CHECK(book.change_id == 101);
+    CHECK(book.bids.size() == 2 && book.bids[0].price == 50.5 && book.bids[0].amount == 3.0);
+    CHECK(!market_data.is_resyncing(id));
+
+    // Already applied: ignored without a resync
+    CHECK(market_data.apply_book_update(id, delta(99, 100, 49.0, 1.0)) == BookUpdateResult::Stale);
+    CHECK(market_data.get_orderbook(id).bids.size() == 2);
+}
+
+void test_gap_buffers_until_snapshot() {
+    Fixture fixture;
+    MarketData& market_data = fixture.market_data;
+    InstrumentId id = fixture.instrument;
+
+    market_data.apply_book_update(id, snapshot(100, 50.0, 51.0));
+    // 101 went missing
+    CHECK(market_data.apply_book_update(id, delta(101, 102, 49.5, 1.0)) == BookUpdateResult::GapDetected);
+    CHECK(market_data.is_resyncing(id));
+    CHECK(!market_data.get_orderbook(id).valid);
+    CHECK(market_data.apply_book_update(id, delta(102, 103, 49.0, 2.0)) == BookUpdateResult::Buffered);
+
+    // Local snapshots are refused while the book is not synced
+    BookUpdate local;
+    CHECK(!market_data.snapshot_book(id, 10, local));
+
+    // The REST snapshot at 102 bridges the buffered delta 103, which is replayed
+    CHECK(market_data.apply_book_snapshot(id, snapshot(102, 50.0, 51.0)) == BookUpdateResult::Applied);
+    CHECK(!market_data.is_resyncing(id));
+    OrderBook book = market_data.get_orderbook(id);
+    CHECK(book.valid);
+    CHECK(book.change_id == 103);
+    CHECK(book.bids.size() == 2 && book.bids[1].price == 49.0);
+
+    CHECK(market_data.apply_book_update(id, delta(103, 104, 50.0, 0.0)) == BookUpdateResult::Applied);
+    CHECK(market_data.get_orderbook(id).bids.size() == 1);
+}
+
+void test_snapshot_that_does_not_bridge() {
+    Fixture fixture;
+    MarketData& market_data = fixture.market_data;
+    InstrumentId id = fixture.instrument;
+
+    market_data.apply_book_update(id, snapshot(100, 50.0, 51.0));
+    market_data.apply_book_update(id, delta(105, 106, 49.5, 1.0));
+    // Older than the buffered delta's prev_change_id: another snapshot is needed
+    CHECK(market_data.apply_book_snapshot(id, snapshot(103, 50.0, 51.0)) == BookUpdateResult::GapDetected);
+    CHECK(market_data.is_resyncing(id));
+    CHECK(market_data.apply_book_snapshot(id, snapshot(105, 50.0, 51.0)) == BookUpdateResult::Applied);
+    CHECK(market_data.get_orderbook(id).change_id == 106);
+
+    // A snapshot no newer than the synced book is stale
+    CHECK(market_data.apply_book_snapshot(id, snapshot(104, 50.0, 51.0)) == BookUpdateResult::Stale);
+}
+
+void test_local_snapshot_and_reset() {
+    Fixture fixture;
+    MarketData& market_data = fixture.market_data;
+    InstrumentId id = fixture.instrument;
+
+    market_data.apply_book_update(id, snapshot(100, 50.0, 51.0));
+    market_data.apply_book_update(id, delta(100, 101, 49.5, 1.0));
+
+    BookUpdate local;
+    CHECK(market_data.snapshot_book(id, 1, local));
+    CHECK(local.is_snapshot);
+    CHECK(local.change_id == 101);
+    CHECK(local.bids.size() == 1 && local.bids[0].price == 50.0);
+    CHECK(local.asks.size() == 1 && local.asks[0].price == 51.0);
+
+    market_data.reset_book(id);
+    CHECK(!market_data.get_orderbook(id).valid);
+    CHECK(!market_data.snapshot_book(id, 1, local));
+    // The first delta after a reset cannot be placed
+    CHECK(market_data.apply_book_update(id, delta(101, 102, 49.0, 1.0)) == BookUpdateResult::GapDetected);
+}
+
+void test_analytics() {
+    Fixture fixture;
+    MarketData& market_data = fixture.market_data;
+    InstrumentId id = fixture.instrument;
+
+    market_data.apply_book_update(id, snapshot(100, 50.0, 51.0));
+    BookAnalytics analytics;
+    CHECK(market_data.get_analytics(id, analytics));
+    CHECK_NEAR(analytics.mid, 50.5, 1e-9);
+    CHECK_NEAR(analytics.spread, 1.0, 1e-9);
+    // 10 bid against 20 ask: the microprice leans towards the bid
+    CHECK_NEAR(analytics.microprice, (50.0 * 20.0 + 51.0 * 10.0) / 30.0, 1e-9);
+    CHECK_NEAR(analytics.imbalance, (10.0 - 20.0) / 30.0, 1e-9);
+}
+
+}
+
+int main() {
+    test_in_sequence_deltas();
+    test_gap_buffers_until_snapshot();
+    test_snapshot_that_does_not_bridge();
+    test_local_snapshot_and_reset();
+    test_analytics();
+    return test_result();
+}
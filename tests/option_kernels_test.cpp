@@ -0,0 +1,117 @@
+#include <cmath>
+#include "option_kernels.h"
+#include "test_check.h"
+
+namespace {
+
+constexpr size_t kLanes = 8;
+
+double norm_cdf(double x) {
+    return 0.5 * std::erfc(-x / std::sqrt(2.0));
+}
+
+// Black-76 with zero rates, the reference the kernel is solved against
+double black_price(double forward, double strike, double years, double vol, double sign) {
+    double deviation = vol * std::sqrt(years);
+    double d1 = (std::log(forward / strike) + 0.5 * deviation * deviation) / deviation;
+    double d2 = d1 - deviation;
+    return sign * (forward * norm_cdf(sign * d1) - strike * norm_cdf(sign * d2));
+}
+
+struct Batch {
+    double forward[kLanes];
+    double strike[kLanes];
+    double years[kLanes];
+    double price[kLanes];
+    double sign[kLanes];
+    double vol[kLanes];
+    double delta[kLanes];
+    double gamma[kLanes];
+    double vega[kLanes];
+    double theta[kLanes];
+    double valid[kLanes];
+
+    Batch() {
+        for (size_t i = 0; i < kLanes; ++i) {
+            set(i, 100, 100, 0.5, 0, 1);
+        }
+    }
+
+    void set(size_t lane, double lane_forward, double lane_strike, double lane_years, double lane_price,
+        double lane_sign) {
+        forward[lane] = lane_forward;
+        strike[lane] = lane_strike;
+        years[lane] = lane_years;
+        price[lane] = lane_price;
+        sign[lane] = lane_sign;
+        vol[lane] = 0.5;
+    }
+
+    void solve() {
+        solve_option_batch({ forward, strike, years, price, sign, vol, delta, gamma, vega, theta, valid, kLanes });
+    }
+};
+
+void test_implied_vol_round_trip() {
+    Batch batch;
+    const double vols[] = { 0.2, 0.45, 0.8, 1.5 };
+    for (size_t i = 0; i < 4; ++i) {
+        // ATM and 10% either side, calls and puts
+        double strike = 90 + 10 * static_cast<double>(i % 3);
+        double sign = i % 2 == 0 ? 1.0 : -1.0;
+        batch.set(i, 100, strike, 0.25, black_price(100, strike, 0.25, vols[i], sign), sign);
+    }
+    batch.solve();
+    for (size_t i = 0; i < 4; ++i) {
+        CHECK(batch.valid[i] == 1);
+        CHECK_NEAR(batch.vol[i], vols[i], 1e-4);
+        CHECK(batch.gamma[i] > 0 && batch.vega[i] > 0 && batch.theta[i] < 0);
+    }
+    CHECK(batch.delta[0] > 0 && batch.delta[0] < 1);
+    CHECK(batch.delta[1] < 0 && batch.delta[1] > -1);
+}
+
+void test_put_call_delta() {
+    Batch batch;
+    double call = black_price(100, 110, 0.5, 0.6, 1);
+    double put = black_price(100, 110, 0.5, 0.6, -1);
+    batch.set(0, 100, 110, 0.5, call, 1);
+    batch.set(1, 100, 110, 0.5, put, -1);
+    batch.solve();
+    CHECK(batch.valid[0] == 1 && batch.valid[1] == 1);
+    // Zero rates: a call is a put plus the forward
+    CHECK_NEAR(batch.delta[0] - batch.delta[1], 1.0, 1e-6);
+    CHECK_NEAR(batch.gamma[0], batch.gamma[1], 1e-9);
+    CHECK_NEAR(batch.vega[0], batch.vega[1], 1e-9);
+}
+
+void test_unsolvable_lanes_take_the_zero_vol_limit() {
+    Batch batch;
+    // Deep in the money with no time value to speak of
+    batch.set(0, 100, 20, 0.1, 80, 1);
+    batch.set(1, 100, 200, 0.1, 100, -1);
+    // Far out of the money and worthless
+    batch.set(2, 100, 200, 0.1, 0, 1);
+    batch.set(3, 100, 20, 0.1, 0, -1);
+    // Expired in the money
+    batch.set(4, 100, 90, 0, 10, 1);
+    // Above the forward: no volatility prices a call there
+    batch.set(5, 100, 90, 0.5, 120, 1);
+    batch.solve();
+
+    const double expected_delta[] = { 1, -1, 0, 0, 1, 1 };
+    for (size_t i = 0; i < 6; ++i) {
+        CHECK(batch.valid[i] == 0);
+        CHECK(batch.delta[i] == expected_delta[i]);
+        CHECK(batch.gamma[i] == 0 && batch.vega[i] == 0 && batch.theta[i] == 0);
+    }
+}
+
+}
+
+int main() {
+    test_implied_vol_round_trip();
+    test_put_call_delta();
+    test_unsolvable_lanes_take_the_zero_vol_limit();
+    return test_result();
+}
@@ -0,0 +1,185 @@
+#include <string>
+#include "order_manager.h"
+#include "pending_requests.h"
+#include "test_check.h"
+
+namespace {
+
+struct Fixture {
+    InstrumentRegistry instruments;
+    OrderManager orders{ 64 };
+    InstrumentId instrument;
+
+    Fixture() {
+        InstrumentInfo info;
+        info.name = "BTC-PERPETUAL";
+        instrument = instruments.add(info);
+    }
+
+    void track(const char* label) {
+        Order order;
+        order.label.assign(label);
+        order.instrument_id = instrument;
+        order.send_ns = 1000;
+        CHECK(orders.track_new_order(order));
+    }
+
+    void event(const char* id, const char* label, const char* state, double filled = 0, int64_t timestamp = 1) {
+        OrderEvent event;
+        event.order_id = id;
+        event.label = label;
+        event.instrument_name = "BTC-PERPETUAL";
+        event.order_state = state;
+        event.direction = "buy";
+        event.order_type = "limit";
+        event.price = 100;
+        event.amount = 10;
+        event.filled_amount = filled;
+        event.last_update_timestamp = timestamp;
+        orders.on_order_event(event, instruments, 2000 + timestamp);
+    }
+
+    // Status of the order tracked under label, Unknown if there is none
+    OrderStatus status_of(const char* label) const {
+        OrderStatus status = OrderStatus::Unknown;
+        orders.for_each_order_with_label(label, [&status](const Order& order) { status = order.status; });
+        return status;
+    }
+};
+
+json place_result(const char* id, const char* label, const char* state) {
+    return {
+        {"jsonrpc", "2.0"},
+        {"id", 1},
+        {"result", {{"order", {
+            {"order_id", id}, {"label", label}, {"instrument_name", "BTC-PERPETUAL"}, {"order_state", state},
+            {"direction", "buy"}, {"order_type", "limit"}, {"price", 100.0}, {"amount", 10.0},
+            {"filled_amount", 0.0}, {"last_update_timestamp", 1}
+        }}}}
+    };
+}
+
+void test_place_response_then_fill() {
+    Fixture fixture;
+    fixture.track("a");
+    CHECK(fixture.status_of("a") == OrderStatus::Pending);
+    CHECK(fixture.orders.open_orders(fixture.instrument) == 1);
+
+    fixture.orders.on_place_response("a", place_result("ETH-1", "a", "open"), fixture.instruments, 1500);
+    Order order;
+    CHECK(fixture.orders.get_order("ETH-1", order));
+    CHECK(order.status == OrderStatus::Open);
+    CHECK(order.label.view() == "a");
+    CHECK(order.ack_ns == 1500);
+
+    fixture.event("ETH-1", "a", "filled", 10, 2);
+    CHECK(fixture.orders.get_order("ETH-1", order));
+    CHECK(order.status == OrderStatus::Filled);
+    CHECK(order.filled == 10);
+    CHECK(order.first_fill_ns != 0 && order.done_ns != 0);
+    CHECK(fixture.orders.open_orders(fixture.instrument) == 0);
+
+    OrderLatencySummary latency;
+    CHECK(fixture.orders.order_latency(fixture.instrument, latency));
+    CHECK(latency.ack.count == 1 && latency.done.count == 1);
+}
+
+void test_event_before_tracking() {
+    Fixture fixture;
+    // user.orders can beat the caller's track_new_order
+    fixture.event("ETH-2", "b", "open");
+    fixture.track("b");
+    CHECK(fixture.orders.size() == 1);
+    Order order;
+    CHECK(fixture.orders.get_order("ETH-2", order));
+    CHECK(order.status == OrderStatus::Open);
+    CHECK(order.send_ns == 1000);
+}
+
+void test_timeout_leaves_the_order_pending() {
+    Fixture fixture;
+    fixture.track("c");
+    json timeout = PendingRequestTable::error_response(7, PendingRequestTable::kRequestTimeout, "request_timeout");
+    fixture.orders.on_place_response("c", timeout, fixture.instruments, 1500);
+    CHECK(fixture.status_of("c") == OrderStatus::Pending);
+    CHECK(fixture.orders.open_orders(fixture.instrument) == 1);
+
+    // The order reached the book after all: the exchange decides
+    fixture.event("ETH-3", "c", "open");
+    Order order;
+    CHECK(fixture.orders.get_order("ETH-3", order));
+    CHECK(order.status == OrderStatus::Open);
+    CHECK(fixture.orders.open_orders(fixture.instrument) == 1);
+
+    fixture.event("ETH-3", "c", "filled", 10, 2);
+    CHECK(fixture.orders.get_order("ETH-3", order));
+    CHECK(order.status == OrderStatus::Filled);
+    CHECK(fixture.orders.rejected_events() == 0);
+}
+
+void test_local_send_failure_leaves_the_order_pending() {
+    Fixture fixture;
+    fixture.track("d");
+    json not_sent = PendingRequestTable::error_response(8, PendingRequestTable::kRequestNotSent,
+        "shed by local rate limiter");
+    fixture.orders.on_place_response("d", not_sent, fixture.instruments, 1500);
+    CHECK(fixture.status_of("d") == OrderStatus::Pending);
+}
+
+void test_exchange_error_rejects() {
+    Fixture fixture;
+    fixture.track("e");
+    json error = {
+        {"jsonrpc", "2.0"},
+        {"id", 9},
+        {"error", {{"code", 10009}, {"message", "not_enough_funds"}}}
+    };
+    fixture.orders.on_place_response("e", error, fixture.instruments, 1500);
+    CHECK(fixture.status_of("e") == OrderStatus::Rejected);
+    CHECK(fixture.orders.open_orders(fixture.instrument) == 0);
+}
+
+void test_invalid_and_stale_events_are_ignored() {
+    Fixture fixture;
+    fixture.track("f");
+    fixture.event("ETH-4", "f", "open", 0, 5);
+    fixture.event("ETH-4", "f", "cancelled", 0, 6);
+
+    // Terminal states are final
+    fixture.event("ETH-4", "f", "open", 0, 7);
+    Order order;
+    CHECK(fixture.orders.get_order("ETH-4", order));
+    CHECK(order.status == OrderStatus::Cancelled);
+    CHECK(fixture.orders.rejected_events() == 1);
+
+    // Older than what was applied
+    fixture.track("g");
+    fixture.event("ETH-5", "g", "open", 2, 10);
+    fixture.event("ETH-5", "g", "open", 1, 9);
+    CHECK(fixture.orders.get_order("ETH-5", order));
+    CHECK(order.filled == 2);
+    CHECK(fixture.orders.rejected_events() == 2);
+}
+
+void test_orders_placed_elsewhere_are_adopted() {
+    Fixture fixture;
+    fixture.event("ETH-6", "", "open");
+    Order order;
+    CHECK(fixture.orders.get_order("ETH-6", order));
+    CHECK(order.status == OrderStatus::Open);
+    CHECK(order.instrument_id == fixture.instrument);
+    CHECK(fixture.orders.open_orders(fixture.instrument) == 1);
+}
+
+}
+
+int main() {
+    test_place_response_then_fill();
+    test_event_before_tracking();
+    test_timeout_leaves_the_order_pending();
+    test_local_send_failure_leaves_the_order_pending();
+    test_exchange_error_rejects();
+    test_invalid_and_stale_events_are_ignored();
+    test_orders_placed_elsewhere_are_adopted();
+    return test_result();
+}
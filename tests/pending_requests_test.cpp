@@ -0,0 +1,138 @@
+#include <string>
+#include <vector>
+#include "pending_requests.h"
+#include "test_check.h"
+
+namespace {
+
+constexpr int64_t kMillisecond = 1000000;
+
+struct Fixture {
+    PendingRequestTable table;
+    std::vector<std::string> calls;
+
+    explicit Fixture(size_t capacity = 64) : table(capacity) {}
+
+    int64_t add(int64_t timeout_ns, int64_t now_ns) {
+        return table.add(
+            [this](const json& response) {
+                calls.push_back(response.contains("error") ?
+                    "error " + std::to_string(response["error"]["code"].get<int>()) : "result");
+            },
+            [this](int64_t id) { calls.push_back("timeout " + std::to_string(id)); },
+            timeout_ns, now_ns);
+    }
+};
+
+json result(int64_t id) {
+    return { {"jsonrpc", "2.0"}, {"id", id}, {"result", "ok"} };
+}
+
+void test_complete_runs_the_handler_once() {
+    Fixture fixture;
+    int64_t id = fixture.add(0, 1000);
+    CHECK(id > 0);
+    CHECK(fixture.table.is_pending(id));
+    CHECK(fixture.table.stats().in_flight == 1);
+
+    CHECK(fixture.table.complete(id, result(id), 1000 + 5 * kMillisecond));
+    CHECK(!fixture.table.is_pending(id));
+    // A duplicate response is not recognised
+    CHECK(!fixture.table.complete(id, result(id), 2000));
+    CHECK(fixture.calls.size() == 1 && fixture.calls[0] == "result");
+
+    PendingRequestStats stats = fixture.table.stats();
+    CHECK(stats.in_flight == 0 && stats.completed == 1 && stats.timed_out == 0);
+    CHECK(fixture.table.latency().count() == 1);
+}
+
+void test_timeout_fires_then_fails_the_handler() {
+    Fixture fixture;
+    fixture.table.expire(0);
+    int64_t id = fixture.add(50 * kMillisecond, 0);
+
+    CHECK(fixture.table.expire(40 * kMillisecond) == 0);
+    CHECK(fixture.table.is_pending(id));
+    CHECK(fixture.table.expire(60 * kMillisecond) == 1);
+    CHECK(!fixture.table.is_pending(id));
+    CHECK(fixture.calls.size() == 2);
+    CHECK(fixture.calls.size() == 2 && fixture.calls[0] == "timeout " + std::to_string(id));
+    CHECK(fixture.calls.size() == 2 && fixture.calls[1] == "error " + std::to_string(PendingRequestTable::kRequestTimeout));
+
+    // The real response arriving late is dropped: handlers run exactly once
+    CHECK(!fixture.table.complete(id, result(id), 70 * kMillisecond));
+    CHECK(fixture.table.expire(10000 * kMillisecond) == 0);
+    CHECK(fixture.calls.size() == 2);
+    CHECK(fixture.table.stats().timed_out == 1);
+}
+
+void test_timeout_longer_than_the_wheel() {
+    Fixture fixture;
+    fixture.table.expire(0);
+    // The default timeout is almost two revolutions of the wheel
+    int64_t id = fixture.add(0, 0);
+    CHECK(fixture.table.expire(6000 * kMillisecond) == 0);
+    CHECK(fixture.table.is_pending(id));
+    CHECK(fixture.table.expire(PendingRequestTable::kDefaultTimeoutNs + 10 * kMillisecond) == 1);
+    CHECK(!fixture.table.is_pending(id));
+}
+
+void test_completed_requests_do_not_time_out() {
+    Fixture fixture;
+    fixture.table.expire(0);
+    int64_t first = fixture.add(20 * kMillisecond, 0);
+    int64_t second = fixture.add(20 * kMillisecond, 0);
+    // Linked into the wheel before completing
+    fixture.table.expire(10 * kMillisecond);
+    CHECK(fixture.table.complete(first, result(first), 15 * kMillisecond));
+
+    CHECK(fixture.table.expire(30 * kMillisecond) == 1);
+    CHECK(fixture.calls.size() == 3);
+    CHECK(fixture.calls.size() == 3 && fixture.calls[1] == "timeout " + std::to_string(second));
+}
+
+void test_saturated_table_rejects() {
+    Fixture fixture(2);
+    int64_t first = fixture.add(0, 0);
+    int64_t second = fixture.add(0, 0);
+    CHECK(first > 0 && second > 0);
+
+    PendingRequestTable::ResponseHandler handler = [](const json&) {};
+    PendingRequestTable::TimeoutHandler on_timeout = [](int64_t) {};
+    CHECK(fixture.table.add(std::move(handler), std::move(on_timeout), 0, 0) == 0);
+    // Left for the caller to fail on the spot
+    CHECK(handler && on_timeout);
+    CHECK(fixture.table.stats().rejected == 1);
+
+    // A response for a recycled slot's previous occupant is not recognised
+    CHECK(fixture.table.complete(first, result(first), 1));
+    int64_t third = fixture.add(0, 0);
+    CHECK(third > second);
+    CHECK(!fixture.table.complete(first, result(first), 2));
+    CHECK(fixture.table.is_pending(third));
+}
+
+void test_handlers_may_issue_new_requests() {
+    PendingRequestTable table(2);
+    int64_t follow_up = 0;
+    int64_t id = table.add([&](const json&) {
+        follow_up = table.add([](const json&) {}, nullptr, 0, 1);
+        }, nullptr, 0, 0);
+    table.add([](const json&) {}, nullptr, 0, 0);
+    CHECK(table.complete(id, result(id), 1));
+    // The completed request's slot was free again inside its handler
+    CHECK(follow_up > 0);
+    CHECK(table.is_pending(follow_up));
+}
+
+}
+
+int main() {
+    test_complete_runs_the_handler_once();
+    test_timeout_fires_then_fails_the_handler();
+    test_timeout_longer_than_the_wheel();
+    test_completed_requests_do_not_time_out();
+    test_saturated_table_rejects();
+    test_handlers_may_issue_new_requests();
+    return test_result();
+}
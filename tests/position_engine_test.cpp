@@ -0,0 +1,154 @@
+#include "position_engine.h"
+#include "test_check.h"
+
+namespace {
+
+struct Fixture {
+    InstrumentRegistry instruments;
+    MarketData market_data{ instruments };
+    PositionEngine positions{ instruments };
+    InstrumentId linear;
+    InstrumentId inverse;
+
+    Fixture() {
+        InstrumentInfo info;
+        info.name = "ETH_USDC-PERPETUAL";
+        info.settlement_currency = "USDC";
+        info.tick_size = 0.5;
+        linear = instruments.add(info);
+
+        info.name = "BTC-PERPETUAL";
+        info.settlement_currency = "BTC";
+        info.inverse = true;
+        inverse = instruments.add(info);
+    }
+
+    void quote(InstrumentId instrument, int64_t change_id, double bid, double ask) {
+        BookUpdate update;
+        update.is_snapshot = true;
+        update.change_id = change_id;
+        update.timestamp = change_id;
+        update.bids.push_back({ BookAction::New, bid, 1.0 });
+        update.asks.push_back({ BookAction::New, ask, 1.0 });
+        market_data.apply_book_update(instrument, update);
+        positions.on_book_update(instrument, market_data);
+    }
+
+    Position position(InstrumentId instrument) const {
+        Position result{};
+        CHECK(positions.get_position(instrument, result));
+        return result;
+    }
+};
+
+void test_average_price_and_realized_pnl() {
+    Fixture fixture;
+    fixture.positions.seed(json::array(), 0);
+    InstrumentId id = fixture.linear;
+
+    fixture.positions.on_fill(id, OrderSide::Buy, 2, 100, 0.1, 1);
+    fixture.positions.on_fill(id, OrderSide::Buy, 2, 110, 0.1, 2);
+    Position position = fixture.position(id);
+    CHECK_NEAR(position.size, 4, 1e-9);
+    CHECK_NEAR(position.average_price, 105, 1e-9);
+    CHECK_NEAR(position.realized_pnl, -0.2, 1e-9);
+
+    // Closing part realizes against the average; the rest keeps it
+    fixture.positions.on_fill(id, OrderSide::Sell, 1, 120, 0, 3);
+    position = fixture.position(id);
+    CHECK_NEAR(position.size, 3, 1e-9);
+    CHECK_NEAR(position.average_price, 105, 1e-9);
+    CHECK_NEAR(position.realized_pnl, 14.8, 1e-9);
+
+    // Through flat: the remainder opens short at the fill price
+    fixture.positions.on_fill(id, OrderSide::Sell, 5, 100, 0, 4);
+    position = fixture.position(id);
+    CHECK_NEAR(position.size, -2, 1e-9);
+    CHECK_NEAR(position.average_price, 100, 1e-9);
+    CHECK_NEAR(position.realized_pnl, 14.8 - 15, 1e-9);
+    CHECK(position.timestamp == 4);
+}
+
+void test_unrealized_pnl_follows_the_book() {
+    Fixture fixture;
+    fixture.positions.seed(json::array(), 0);
+    InstrumentId id = fixture.linear;
+
+    fixture.positions.on_fill(id, OrderSide::Buy, 2, 100, 0, 1);
+    fixture.quote(id, 10, 104, 106);
+    Position position = fixture.position(id);
+    CHECK_NEAR(position.mark_price, 105, 1e-9);
+    CHECK_NEAR(position.unrealized_pnl, 10, 1e-9);
+    CHECK(position.timestamp == 10);
+
+    CurrencyTotals totals;
+    CHECK(fixture.positions.currency_count() == 1);
+    CHECK(fixture.positions.currency_name(0) == "USDC");
+    CHECK(fixture.positions.get_totals(0, totals));
+    CHECK_NEAR(totals.unrealized_pnl, 10, 1e-9);
+    CHECK(totals.open_positions == 1);
+
+    // Closing moves the PnL from unrealized to realized
+    fixture.positions.on_fill(id, OrderSide::Sell, 2, 105, 0, 11);
+    CHECK(fixture.positions.get_totals(0, totals));
+    CHECK_NEAR(totals.unrealized_pnl, 0, 1e-9);
+    CHECK_NEAR(totals.realized_pnl, 10, 1e-9);
+    CHECK(totals.open_positions == 0);
+    CHECK(fixture.positions.size(id) == 0);
+}
+
+void test_inverse_pnl_is_in_coin() {
+    Fixture fixture;
+    fixture.positions.seed(json::array(), 0);
+    InstrumentId id = fixture.inverse;
+
+    // 10000 USD bought at 40000 and 50000 averages in 1/price
+    fixture.positions.on_fill(id, OrderSide::Buy, 10000, 40000, 0, 1);
+    fixture.positions.on_fill(id, OrderSide::Buy, 10000, 50000, 0, 2);
+    Position position = fixture.position(id);
+    CHECK_NEAR(position.average_price, 20000.0 / (10000.0 / 40000 + 10000.0 / 50000), 1e-6);
+
+    fixture.quote(id, 10, 49999.5, 50000.5);
+    position = fixture.position(id);
+    CHECK_NEAR(position.unrealized_pnl, 20000 * (1.0 / position.average_price - 1.0 / 50000), 1e-12);
+    CHECK(fixture.positions.currency_name(position.currency) == "BTC");
+}
+
+void test_fills_before_the_seed() {
+    Fixture fixture;
+    InstrumentId id = fixture.linear;
+    // Already part of the seeded position, then one that is not
+    fixture.positions.on_fill(id, OrderSide::Buy, 1, 100, 0, 900);
+    fixture.positions.on_fill(id, OrderSide::Buy, 1, 110, 0, 1100);
+    CHECK(!fixture.positions.seeded());
+    CHECK(fixture.positions.size(id) == 0);
+
+    json seed = json::array({ {
+        {"instrument_name", "ETH_USDC-PERPETUAL"},
+        {"size", 3.0},
+        {"average_price", 100.0},
+        {"mark_price", 102.0},
+        {"realized_profit_loss", 1.5}
+    } });
+    fixture.positions.seed(seed, 1000);
+    CHECK(fixture.positions.seeded());
+    Position position = fixture.position(id);
+    CHECK_NEAR(position.size, 4, 1e-9);
+    CHECK_NEAR(position.average_price, 102.5, 1e-9);
+    CHECK_NEAR(position.realized_pnl, 1.5, 1e-9);
+    CHECK_NEAR(position.unrealized_pnl, 4 * (102 - 102.5), 1e-9);
+
+    // Instruments never held have no position
+    Position unknown;
+    CHECK(!fixture.positions.get_position(fixture.inverse, unknown));
+}
+
+}
+
+int main() {
+    test_average_price_and_realized_pnl();
+    test_unrealized_pnl_follows_the_book();
+    test_inverse_pnl_is_in_coin();
+    test_fills_before_the_seed();
+    return test_result();
+}
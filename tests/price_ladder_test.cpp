@@ -0,0 +1,106 @@
+#include <utility>
+#include <vector>
+#include "price_ladder.h"
+#include "test_check.h"
+
+namespace {
+
+std::vector<std::pair<double, double>> levels(const PriceLadder& ladder, size_t max_levels = 1000) {
+    std::vector<std::pair<double, double>> out;
+    ladder.for_each_level(max_levels, [&](double price, double amount) { out.emplace_back(price, amount); });
+    return out;
+}
+
+void test_best_level_tracking() {
+    PriceLadder bids(BookSide::Bid);
+    bids.set_tick_size(0.5);
+    CHECK(bids.empty());
+
+    bids.set(100.0, 1.0);
+    bids.set(101.5, 2.0);
+    bids.set(99.0, 3.0);
+    CHECK(bids.size() == 3);
+    CHECK_NEAR(bids.best_price(), 101.5, 1e-9);
+    CHECK_NEAR(bids.best_amount(), 2.0, 1e-9);
+
+    bids.erase(101.5);
+    CHECK_NEAR(bids.best_price(), 100.0, 1e-9);
+    // A zero amount removes the level, like a delete
+    bids.set(100.0, 0.0);
+    CHECK_NEAR(bids.best_price(), 99.0, 1e-9);
+    CHECK(bids.size() == 1);
+
+    bids.clear();
+    CHECK(bids.empty());
+}
+
+void test_levels_from_the_touch() {
+    PriceLadder bids(BookSide::Bid);
+    PriceLadder asks(BookSide::Ask);
+    for (double price : { 10.0, 12.0, 11.0 }) {
+        bids.set(price, price);
+        asks.set(price, price);
+    }
+
+    auto bid_levels = levels(bids);
+    CHECK(bid_levels.size() == 3);
+    CHECK(bid_levels.size() == 3 && bid_levels[0].first == 12.0 && bid_levels[2].first == 10.0);
+    auto ask_levels = levels(asks);
+    CHECK(ask_levels.size() == 3 && ask_levels[0].first == 10.0 && ask_levels[2].first == 12.0);
+
+    CHECK(levels(bids, 2).size() == 2);
+    CHECK(levels(bids, 0).empty());
+}
+
+void test_overflow_outside_the_window() {
+    // A 64-tick window: levels far from the touch go to the overflow map
+    // and must still be visited in price order
+    PriceLadder asks(BookSide::Ask, 64);
+    asks.set(1000.0, 1.0);
+    asks.set(1010.0, 2.0);
+    asks.set(5000.0, 3.0);
+    asks.set(990.0, 4.0);
+    CHECK(asks.size() == 4);
+    CHECK_NEAR(asks.best_price(), 990.0, 1e-9);
+
+    auto ask_levels = levels(asks);
+    CHECK(ask_levels.size() == 4);
+    CHECK(ask_levels.size() == 4 && ask_levels[0].first == 990.0 && ask_levels[1].first == 1000.0 &&
+        ask_levels[2].first == 1010.0 && ask_levels[3].first == 5000.0);
+
+    // Emptying the near levels leaves the far one as the touch
+    asks.erase(990.0);
+    asks.erase(1000.0);
+    asks.erase(1010.0);
+    CHECK(asks.size() == 1);
+    CHECK_NEAR(asks.best_price(), 5000.0, 1e-9);
+    CHECK_NEAR(asks.best_amount(), 3.0, 1e-9);
+
+    PriceLadder bids(BookSide::Bid, 64);
+    bids.set(1000.0, 1.0);
+    bids.set(10.0, 2.0);
+    bids.set(2000.0, 3.0);
+    auto bid_levels = levels(bids);
+    CHECK(bid_levels.size() == 3 && bid_levels[0].first == 2000.0 && bid_levels[1].first == 1000.0 &&
+        bid_levels[2].first == 10.0);
+}
+
+void test_tick_size_rounding() {
+    PriceLadder bids(BookSide::Bid);
+    bids.set_tick_size(0.01);
+    // Prices that differ only by floating-point noise land on one tick
+    bids.set(0.1 + 0.2, 1.0);
+    bids.set(0.3, 2.0);
+    CHECK(bids.size() == 1);
+    CHECK_NEAR(bids.best_amount(), 2.0, 1e-9);
+}
+
+}
+
+int main() {
+    test_best_level_tracking();
+    test_levels_from_the_touch();
+    test_overflow_outside_the_window();
+    test_tick_size_rounding();
+    return test_result();
+}
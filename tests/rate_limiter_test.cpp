@@ -0,0 +1,154 @@
+#include <string>
+#include <utility>
+#include <vector>
+#include "rate_limiter.h"
+#include "test_check.h"
+
+namespace {
+
+constexpr int64_t kSecond = 1000000000;
+
+struct Fixture {
+    OutboundQueue queue{ 64 };
+    RateLimiter limiter;
+    std::vector<std::pair<int64_t, std::string>> dropped;
+
+    explicit Fixture(OverLimitPolicy policy, double burst = 1) {
+        RateLimitConfig config;
+        config.matching_engine = { burst, 1, 1, policy };
+        config.max_backlog = 4;
+        limiter.configure(config);
+        limiter.set_drop_handler([this](int64_t request_id, const char* reason) {
+            dropped.emplace_back(request_id, reason);
+            });
+    }
+
+    void push(SendPriority priority, int64_t request_id, const char* merge_key = "") {
+        queue.push(priority, "{}", request_id, 0, merge_key);
+    }
+
+    // Request ID of the next admitted frame, 0 if none may go yet
+    int64_t next(int64_t now_ns) {
+        OutboundFrame frame;
+        return limiter.next(queue, now_ns, frame) ? frame.request_id : 0;
+    }
+};
+
+void test_queue_holds_until_refill() {
+    Fixture fixture(OverLimitPolicy::Queue, 2);
+    fixture.push(SendPriority::Order, 1);
+    fixture.push(SendPriority::Order, 2);
+    fixture.push(SendPriority::Order, 3);
+
+    CHECK(fixture.next(kSecond) == 1);
+    CHECK(fixture.next(kSecond) == 2);
+    CHECK(fixture.next(kSecond) == 0);
+    RateLimitStats stats = fixture.limiter.stats();
+    CHECK(stats.admitted == 2);
+    CHECK(stats.held == 1);
+    CHECK(stats.backlog == 1);
+    CHECK(fixture.limiter.next_release_ns(kSecond) == 2 * kSecond);
+
+    CHECK(fixture.next(2 * kSecond) == 3);
+    CHECK(fixture.limiter.stats().backlog == 0);
+    CHECK(fixture.dropped.empty());
+}
+
+void test_non_matching_requests_use_their_own_bucket() {
+    Fixture fixture(OverLimitPolicy::Queue);
+    fixture.push(SendPriority::Order, 1);
+    fixture.push(SendPriority::Order, 2);
+    fixture.push(SendPriority::Other, 3);
+
+    CHECK(fixture.next(kSecond) == 1);
+    CHECK(fixture.next(kSecond) == 3);
+    CHECK(fixture.next(kSecond) == 0);
+}
+
+void test_shed_fails_right_away() {
+    Fixture fixture(OverLimitPolicy::Shed);
+    fixture.push(SendPriority::Order, 1);
+    fixture.push(SendPriority::Order, 2);
+
+    CHECK(fixture.next(kSecond) == 1);
+    CHECK(fixture.next(kSecond) == 0);
+    CHECK(fixture.dropped.size() == 1 && fixture.dropped[0].first == 2);
+    CHECK(fixture.limiter.stats().shed == 1);
+    CHECK(fixture.limiter.stats().backlog == 0);
+}
+
+void test_merge_keeps_the_newest_in_place() {
+    Fixture fixture(OverLimitPolicy::Merge);
+    fixture.push(SendPriority::Order, 1, "order-a");
+    fixture.push(SendPriority::Order, 2, "order-a");
+    fixture.push(SendPriority::Order, 3, "order-b");
+    fixture.push(SendPriority::Order, 4, "order-a");
+
+    CHECK(fixture.next(kSecond) == 1);
+    CHECK(fixture.next(kSecond) == 0);
+    // 4 replaced 2 and kept its place ahead of 3
+    CHECK(fixture.dropped.size() == 1 && fixture.dropped[0].first == 2);
+    CHECK(fixture.limiter.stats().merged == 1);
+
+    CHECK(fixture.next(2 * kSecond) == 4);
+    CHECK(fixture.next(3 * kSecond) == 3);
+}
+
+void test_backlog_full_sheds() {
+    Fixture fixture(OverLimitPolicy::Queue);
+    for (int64_t id = 1; id <= 6; ++id) {
+        fixture.push(SendPriority::Order, id);
+    }
+    CHECK(fixture.next(kSecond) == 1);
+    CHECK(fixture.next(kSecond) == 0);
+    // Four held back, the sixth had no room
+    CHECK(fixture.limiter.stats().backlog == 4);
+    CHECK(fixture.dropped.size() == 1 && fixture.dropped[0].first == 6);
+}
+
+void test_cancel_overtakes_and_drops_held_edits() {
+    Fixture fixture(OverLimitPolicy::Merge);
+    fixture.push(SendPriority::Order, 1);
+    fixture.push(SendPriority::Order, 2, "order-a");
+    fixture.push(SendPriority::Order, 3, "order-b");
+    CHECK(fixture.next(kSecond) == 1);
+    CHECK(fixture.next(kSecond) == 0);
+
+    fixture.push(SendPriority::Cancel, 4, "order-a");
+    CHECK(fixture.next(2 * kSecond) == 4);
+    // The edit of the cancelled order is failed; the other one still goes
+    CHECK(fixture.dropped.size() == 1 && fixture.dropped[0].first == 2);
+    CHECK(fixture.limiter.stats().backlog == 1);
+    CHECK(fixture.next(3 * kSecond) == 3);
+    CHECK(fixture.next(4 * kSecond) == 0);
+}
+
+void test_disabled_passes_everything() {
+    Fixture fixture(OverLimitPolicy::Queue);
+    RateLimitConfig config;
+    config.enabled = false;
+    fixture.limiter.configure(config);
+    for (int64_t id = 1; id <= 3; ++id) {
+        fixture.push(SendPriority::Order, id);
+    }
+    fixture.push(SendPriority::Cancel, 4);
+
+    CHECK(fixture.next(0) == 4);
+    CHECK(fixture.next(0) == 1);
+    CHECK(fixture.next(0) == 2);
+    CHECK(fixture.next(0) == 3);
+    CHECK(fixture.next(0) == 0);
+}
+
+}
+
+int main() {
+    test_queue_holds_until_refill();
+    test_non_matching_requests_use_their_own_bucket();
+    test_shed_fails_right_away();
+    test_merge_keeps_the_newest_in_place();
+    test_backlog_full_sheds();
+    test_cancel_overtakes_and_drops_held_edits();
+    test_disabled_passes_everything();
+    return test_result();
+}
@@ -0,0 +1,174 @@
+#include <cmath>
+#include <limits>
+#include "risk_gate.h"
+#include "test_check.h"
+
+namespace {
+
+struct Fixture {
+    InstrumentRegistry instruments;
+    MarketData market_data{ instruments };
+    PositionEngine positions{ instruments };
+    OrderManager orders{ 64 };
+    RiskGate gate{ market_data, positions, orders };
+    InstrumentId instrument;
+
+    Fixture() {
+        InstrumentInfo info;
+        info.name = "ETH-PERPETUAL";
+        info.tick_size = 0.05;
+        instrument = instruments.add(info);
+        positions.seed(json::array(), 0);
+
+        RiskLimits limits;
+        limits.price_band = 0.05;
+        gate.set_default_limits(limits);
+    }
+
+    // Two-sided book around a mid of 101
+    void quote() {
+        BookUpdate update;
+        update.is_snapshot = true;
+        update.change_id = 1;
+        update.timestamp = 1;
+        update.bids.push_back({ BookAction::New, 100.0, 5.0 });
+        update.asks.push_back({ BookAction::New, 102.0, 5.0 });
+        market_data.apply_book_update(instrument, update);
+    }
+
+    void track(const char* label, OrderSide side, double amount, double price) {
+        Order order;
+        order.label.assign(label);
+        order.instrument_id = instrument;
+        order.side = side;
+        order.amount = amount;
+        order.price = price;
+        CHECK(orders.track_new_order(order));
+    }
+};
+
+void test_invalid_orders() {
+    Fixture fixture;
+    InstrumentId id = fixture.instrument;
+    CHECK(fixture.gate.check_order(id, OrderSide::Unknown, 1, 100) == RiskReject::InvalidOrder);
+    CHECK(fixture.gate.check_order(id, OrderSide::Buy, 0, 100) == RiskReject::InvalidOrder);
+    CHECK(fixture.gate.check_order(id, OrderSide::Buy, -1, 100) == RiskReject::InvalidOrder);
+    CHECK(fixture.gate.check_order(id, OrderSide::Buy, 1, std::nan("")) == RiskReject::InvalidOrder);
+    CHECK(fixture.gate.check_order(id, OrderSide::Buy, std::numeric_limits<double>::infinity(), 100) ==
+        RiskReject::InvalidOrder);
+    CHECK(fixture.gate.check_order(kInvalidInstrument, OrderSide::Buy, 1, 100) == RiskReject::InvalidOrder);
+}
+
+void test_price_band_around_mid() {
+    Fixture fixture;
+    fixture.quote();
+    InstrumentId id = fixture.instrument;
+    // 5% of 101 either side
+    CHECK(fixture.gate.check_order(id, OrderSide::Buy, 1, 106.0) == RiskReject::None);
+    CHECK(fixture.gate.check_order(id, OrderSide::Buy, 1, 106.1) == RiskReject::PriceBand);
+    CHECK(fixture.gate.check_order(id, OrderSide::Sell, 1, 96.0) == RiskReject::None);
+    CHECK(fixture.gate.check_order(id, OrderSide::Sell, 1, 95.9) == RiskReject::PriceBand);
+    // Passive prices only rest, however far from mid
+    CHECK(fixture.gate.check_order(id, OrderSide::Buy, 1, 50.0) == RiskReject::None);
+    CHECK(fixture.gate.check_order(id, OrderSide::Sell, 1, 500.0) == RiskReject::None);
+    // Market orders have no price to check
+    CHECK(fixture.gate.check_order(id, OrderSide::Buy, 1, 0) == RiskReject::None);
+}
+
+void test_no_reference_price() {
+    Fixture fixture;
+    InstrumentId id = fixture.instrument;
+    // Not subscribed: the band is skipped unless a quote is required
+    CHECK(fixture.gate.check_order(id, OrderSide::Buy, 1, 1000.0) == RiskReject::None);
+
+    RiskLimits limits = fixture.gate.limits(id);
+    limits.require_quote = true;
+    fixture.gate.set_limits(id, limits);
+    CHECK(fixture.gate.check_order(id, OrderSide::Buy, 1, 1000.0) == RiskReject::NoReferencePrice);
+    CHECK(fixture.gate.check_order(id, OrderSide::Buy, 1, 0) == RiskReject::None);
+}
+
+void test_size_and_position_limits() {
+    Fixture fixture;
+    InstrumentId id = fixture.instrument;
+    RiskLimits limits;
+    limits.price_band = 0;
+    limits.max_order_amount = 10;
+    limits.max_position = 15;
+    fixture.gate.set_limits(id, limits);
+
+    CHECK(fixture.gate.check_order(id, OrderSide::Buy, 10, 100) == RiskReject::None);
+    CHECK(fixture.gate.check_order(id, OrderSide::Buy, 11, 100) == RiskReject::OrderSize);
+
+    fixture.positions.on_fill(id, OrderSide::Buy, 8, 100, 0, 1);
+    CHECK(fixture.gate.check_order(id, OrderSide::Buy, 7, 100) == RiskReject::None);
+    CHECK(fixture.gate.check_order(id, OrderSide::Buy, 8, 100) == RiskReject::Position);
+    // Reducing the position is always within the limit
+    CHECK(fixture.gate.check_order(id, OrderSide::Sell, 10, 100) == RiskReject::None);
+}
+
+void test_open_orders_and_edits() {
+    Fixture fixture;
+    InstrumentId id = fixture.instrument;
+    RiskLimits limits;
+    limits.price_band = 0;
+    limits.max_open_orders = 1;
+    limits.max_order_amount = 10;
+    fixture.gate.set_limits(id, limits);
+
+    fixture.track("a", OrderSide::Buy, 5, 100);
+    // Unacknowledged orders count against the limit
+    CHECK(fixture.gate.check_order(id, OrderSide::Buy, 1, 100) == RiskReject::OpenOrders);
+
+    OrderEvent event;
+    event.order_id = "ETH-1";
+    event.label = "a";
+    event.instrument_name = "ETH-PERPETUAL";
+    event.order_state = "open";
+    event.direction = "buy";
+    event.order_type = "limit";
+    event.price = 100;
+    event.amount = 5;
+    event.filled_amount = 3;
+    event.last_update_timestamp = 1;
+    fixture.orders.on_order_event(event, fixture.instruments, 1);
+
+    // An edit replaces the order rather than adding one, and only its
+    // unfilled part counts against the size limit
+    CHECK(fixture.gate.check_edit("ETH-1", 12, 100) == RiskReject::None);
+    CHECK(fixture.gate.check_edit("ETH-1", 14, 100) == RiskReject::OrderSize);
+    CHECK(fixture.gate.check_edit("ETH-2", 1, 100) == RiskReject::UnknownOrder);
+
+    event.order_state = "cancelled";
+    event.last_update_timestamp = 2;
+    fixture.orders.on_order_event(event, fixture.instruments, 2);
+    CHECK(fixture.gate.check_edit("ETH-1", 1, 100) == RiskReject::UnknownOrder);
+    CHECK(fixture.gate.check_order(id, OrderSide::Buy, 1, 100) == RiskReject::None);
+}
+
+void test_stats() {
+    Fixture fixture;
+    InstrumentId id = fixture.instrument;
+    fixture.gate.check_order(id, OrderSide::Buy, 1, 100);
+    fixture.gate.check_order(id, OrderSide::Buy, 0, 100);
+    fixture.gate.check_edit("ETH-9", 1, 100);
+
+    RiskStats stats = fixture.gate.stats();
+    CHECK(stats.checked == 3);
+    CHECK(stats.rejected == 2);
+    CHECK(stats.by_reason[static_cast<size_t>(RiskReject::InvalidOrder)] == 1);
+    CHECK(stats.by_reason[static_cast<size_t>(RiskReject::UnknownOrder)] == 1);
+    CHECK(stats.latency.count == 3);
+}
+
+}
+
+int main() {
+    test_invalid_orders();
+    test_price_band_around_mid();
+    test_no_reference_price();
+    test_size_and_position_limits();
+    test_open_orders_and_edits();
+    test_stats();
+    return test_result();
+}
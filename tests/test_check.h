@@ -0,0 +1,37 @@
+#pragma once
+
+// Minimal assertions for the unit tests, so they build with no framework.
+// Each test executable returns test_result() from main; ctest reports it.
+#include <cmath>
+#include <cstdio>
+
+inline int& test_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+inline int test_result() {
+    if (test_failures() > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", test_failures());
+    }
+    return test_failures() == 0 ? 0 : 1;
+}
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++test_failures(); \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+    do { \
+        double actual_value = (actual); \
+        double expected_value = (expected); \
+        if (!(std::fabs(actual_value - expected_value) <= (tolerance))) { \
+            std::fprintf(stderr, "%s:%d: CHECK_NEAR(%s, %s): %.10g != %.10g\n", __FILE__, __LINE__, #actual, \
+                #expected, actual_value, expected_value); \
+            ++test_failures(); \
+        } \
+    } while (0)